@@ -0,0 +1,585 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "async.h"
+#include "bufpool.h"
+#include "trace.h"
+
+#ifdef FC_THREADS
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define FC_URING 1
+#endif
+
+// Where the engine's requests go. submit() queues one read or write of
+// a slot's buffer; wait() blocks until some request finishes and returns
+// its slot and result (bytes moved, or -errno).
+class AsyncQueue {
+public:
+    virtual ~AsyncQueue() {}
+    virtual bool submit(int slot, bool write, int handle, char* buffer,
+                        long length, fsize_t offset) = 0;
+    virtual bool wait(int& slot, long& result) = 0;
+};
+
+#ifdef FC_URING
+
+// io_uring through the raw system calls - liburing isn't everywhere.
+// The slot buffers are registered once, so the kernel doesn't map them
+// again for every request.
+class UringQueue : public AsyncQueue {
+private:
+    int m_fd;
+    unsigned m_pending;         // Queued but not yet passed to the kernel
+
+    void* m_sqRing;
+    size_t m_sqRingSize;
+    void* m_cqRing;
+    size_t m_cqRingSize;
+    struct io_uring_sqe* m_sqes;
+    size_t m_sqesSize;
+
+    unsigned* m_sqTail;
+    unsigned* m_sqMask;
+    unsigned* m_sqArray;
+    unsigned* m_cqHead;
+    unsigned* m_cqTail;
+    unsigned* m_cqMask;
+    struct io_uring_cqe* m_cqes;
+
+public:
+    UringQueue() : m_fd(-1), m_pending(0), m_sqRing(MAP_FAILED), m_cqRing(MAP_FAILED),
+                   m_sqes((struct io_uring_sqe*)MAP_FAILED) {}
+    virtual ~UringQueue();
+
+    // False if the kernel refuses io_uring or the buffers can't be
+    // registered (memory lock limit)
+    bool open(int entries, char** buffers, int bufferCount, long bufferSize);
+
+    virtual bool submit(int slot, bool write, int handle, char* buffer,
+                        long length, fsize_t offset);
+    virtual bool wait(int& slot, long& result);
+};
+
+bool UringQueue::open(int entries, char** buffers, int bufferCount, long bufferSize) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    m_sqRing = mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_fd, IORING_OFF_SQ_RING);
+    m_cqRing = mmap(NULL, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_fd, IORING_OFF_CQ_RING);
+    m_sqes = (struct io_uring_sqe*)mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+    if (m_sqRing == MAP_FAILED || m_cqRing == MAP_FAILED || m_sqes == MAP_FAILED) {
+        return false;
+    }
+
+    char* sq = (char*)m_sqRing;
+    m_sqTail = (unsigned*)(sq + params.sq_off.tail);
+    m_sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+    m_sqArray = (unsigned*)(sq + params.sq_off.array);
+    char* cq = (char*)m_cqRing;
+    m_cqHead = (unsigned*)(cq + params.cq_off.head);
+    m_cqTail = (unsigned*)(cq + params.cq_off.tail);
+    m_cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+    m_cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    struct iovec* vectors = new struct iovec[bufferCount];
+    for (int i = 0; i < bufferCount; i++) {
+        vectors[i].iov_base = buffers[i];
+        vectors[i].iov_len = (size_t)bufferSize;
+    }
+    int registered = (int)syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS,
+                                  vectors, bufferCount);
+    delete[] vectors;
+    return registered >= 0;
+}
+
+UringQueue::~UringQueue() {
+    if (m_sqes != MAP_FAILED) {
+        munmap(m_sqes, m_sqesSize);
+    }
+    if (m_cqRing != MAP_FAILED) {
+        munmap(m_cqRing, m_cqRingSize);
+    }
+    if (m_sqRing != MAP_FAILED) {
+        munmap(m_sqRing, m_sqRingSize);
+    }
+    if (m_fd >= 0) {
+        close(m_fd);    // Also drops the registered buffers
+    }
+}
+
+bool UringQueue::submit(int slot, bool write, int handle, char* buffer,
+                        long length, fsize_t offset) {
+    // Only this thread touches the tail, and the kernel only reads it
+    unsigned tail = *m_sqTail;
+    unsigned index = tail & *m_sqMask;
+    struct io_uring_sqe* sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->fd = handle;
+    sqe->addr = (unsigned long)buffer;
+    sqe->len = (unsigned)length;
+    sqe->off = (unsigned long long)offset;
+    sqe->buf_index = (unsigned short)slot;
+    sqe->user_data = (unsigned long long)slot;
+    m_sqArray[index] = index;
+
+    // The entry must be complete before the kernel can see the new tail
+    __sync_synchronize();
+    *m_sqTail = tail + 1;
+    m_pending++;
+    return true;
+}
+
+bool UringQueue::wait(int& slot, long& result) {
+    for (;;) {
+        unsigned head = *m_cqHead;
+        __sync_synchronize();
+        if (head != *(volatile unsigned*)m_cqTail) {
+            __sync_synchronize();
+            struct io_uring_cqe* cqe = &m_cqes[head & *m_cqMask];
+            slot = (int)cqe->user_data;
+            result = (long)cqe->res;
+            __sync_synchronize();
+            *m_cqHead = head + 1;
+            return true;
+        }
+
+        // Hand over what's queued and sleep until something finishes
+        int taken = (int)syscall(__NR_io_uring_enter, m_fd, m_pending, 1,
+                                 IORING_ENTER_GETEVENTS, NULL, 0);
+        if (taken < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        m_pending -= (unsigned)taken;
+    }
+}
+
+#endif // FC_URING
+
+// The fallback: one thread per slot, each doing a whole pread() or
+// pwrite() at a time
+class ThreadQueue : public AsyncQueue {
+private:
+    struct Request {
+        int slot;
+        bool write;
+        int handle;
+        char* buffer;
+        long length;
+        fsize_t offset;
+        long result;
+    };
+
+    // Two FIFOs of depth entries - a slot has at most one request out
+    Request* m_waiting;
+    int m_waitingHead;
+    int m_waitingCount;
+    Request* m_finished;
+    int m_finishedHead;
+    int m_finishedCount;
+    int m_depth;
+
+    Mutex m_lock;
+    Condition m_work;
+    Condition m_done;
+    Thread* m_threads;
+    bool m_stop;
+
+    static void* workerEntry(void* arg);
+    void workerLoop();
+
+    // Not copyable
+    ThreadQueue(const ThreadQueue&);
+    ThreadQueue& operator=(const ThreadQueue&);
+
+public:
+    ThreadQueue(int depth);
+    virtual ~ThreadQueue();
+
+    bool start();
+    virtual bool submit(int slot, bool write, int handle, char* buffer,
+                        long length, fsize_t offset);
+    virtual bool wait(int& slot, long& result);
+};
+
+ThreadQueue::ThreadQueue(int depth)
+    : m_waitingHead(0), m_waitingCount(0), m_finishedHead(0), m_finishedCount(0),
+      m_depth(depth), m_stop(false) {
+    m_waiting = new Request[depth];
+    m_finished = new Request[depth];
+    m_threads = new Thread[depth];
+}
+
+ThreadQueue::~ThreadQueue() {
+    {
+        ScopedLock lock(m_lock);
+        m_stop = true;
+        m_work.broadcast();
+    }
+    for (int i = 0; i < m_depth; i++) {
+        m_threads[i].join();
+    }
+    delete[] m_threads;
+    delete[] m_finished;
+    delete[] m_waiting;
+}
+
+bool ThreadQueue::start() {
+    for (int i = 0; i < m_depth; i++) {
+        if (!m_threads[i].start(workerEntry, this)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void* ThreadQueue::workerEntry(void* arg) {
+    ((ThreadQueue*)arg)->workerLoop();
+    return NULL;
+}
+
+void ThreadQueue::workerLoop() {
+    for (;;) {
+        Request request;
+        {
+            ScopedLock lock(m_lock);
+            while (m_waitingCount == 0 && !m_stop) {
+                m_work.wait(m_lock);
+            }
+            if (m_stop) {
+                return;
+            }
+            request = m_waiting[m_waitingHead];
+            m_waitingHead = (m_waitingHead + 1) % m_depth;
+            m_waitingCount--;
+        }
+
+        long done = 0;
+        while (done < request.length) {
+            ssize_t moved;
+            TRACE_START(ioStart);
+            if (request.write) {
+                moved = pwrite(request.handle, request.buffer + done,
+                               (size_t)(request.length - done), (off_t)(request.offset + done));
+            } else {
+                moved = pread(request.handle, request.buffer + done,
+                              (size_t)(request.length - done), (off_t)(request.offset + done));
+            }
+            TRACE_END(request.write ? TRACE_WRITE : TRACE_READ, ioStart, moved);
+            if (moved < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                done = -errno;
+                break;
+            }
+            if (moved == 0) {
+                break;      // End of file
+            }
+            done += (long)moved;
+        }
+        request.result = done;
+
+        ScopedLock lock(m_lock);
+        m_finished[(m_finishedHead + m_finishedCount) % m_depth] = request;
+        m_finishedCount++;
+        m_done.signal();
+    }
+}
+
+bool ThreadQueue::submit(int slot, bool write, int handle, char* buffer,
+                         long length, fsize_t offset) {
+    ScopedLock lock(m_lock);
+    Request& request = m_waiting[(m_waitingHead + m_waitingCount) % m_depth];
+    request.slot = slot;
+    request.write = write;
+    request.handle = handle;
+    request.buffer = buffer;
+    request.length = length;
+    request.offset = offset;
+    request.result = 0;
+    m_waitingCount++;
+    m_work.signal();
+    return true;
+}
+
+bool ThreadQueue::wait(int& slot, long& result) {
+    ScopedLock lock(m_lock);
+    while (m_finishedCount == 0) {
+        m_done.wait(m_lock);
+    }
+    slot = m_finished[m_finishedHead].slot;
+    result = m_finished[m_finishedHead].result;
+    m_finishedHead = (m_finishedHead + 1) % m_depth;
+    m_finishedCount--;
+    return true;
+}
+
+AsyncEngine::AsyncEngine(int depth, long chunkSize)
+    : m_slots(NULL), m_depth(depth), m_chunkSize(chunkSize), m_queue(NULL), m_uring(false),
+      m_sourceHandle(-1), m_destHandle(-1), m_readOffset(0), m_endOffset(0),
+      m_writeOffset(0), m_doneOffset(0), m_destShift(0), m_inFlight(0), m_failed(false) {
+    // Every buffer up front, page aligned for registration
+    m_slots = new Slot[m_depth];
+    for (int i = 0; i < m_depth; i++) {
+        m_slots[i].data = BufferPool::acquire(m_chunkSize);
+        m_slots[i].state = SLOT_FREE;
+    }
+}
+
+AsyncEngine::~AsyncEngine() {
+    end();
+    for (int i = 0; i < m_depth; i++) {
+        if (m_slots[i].data != NULL) {
+            BufferPool::release(m_slots[i].data, m_chunkSize);
+        }
+    }
+    delete[] m_slots;
+}
+
+bool AsyncEngine::begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+    end();
+    for (int i = 0; i < m_depth; i++) {
+        if (m_slots[i].data == NULL) {
+            return false;
+        }
+        m_slots[i].state = SLOT_FREE;
+    }
+
+    // Positional I/O from here on - start where the handles are (resume)
+    m_sourceHandle = sourceHandle;
+    m_destHandle = destHandle;
+    m_readOffset = lseek(sourceHandle, 0, SEEK_CUR);
+    m_writeOffset = m_readOffset;
+    m_doneOffset = m_readOffset;
+    m_destShift = lseek(destHandle, 0, SEEK_CUR) - m_readOffset;
+    m_endOffset = fileSize;
+    m_inFlight = 0;
+    m_failed = false;
+
+    m_uring = false;
+#ifdef FC_URING
+    char** buffers = new char*[m_depth];
+    for (int i = 0; i < m_depth; i++) {
+        buffers[i] = m_slots[i].data;
+    }
+    UringQueue* uring = new UringQueue();
+    if (uring->open(m_depth, buffers, m_depth, m_chunkSize)) {
+        m_queue = uring;
+        m_uring = true;
+    } else {
+        delete uring;
+    }
+    delete[] buffers;
+#endif
+    if (m_queue == NULL) {
+        ThreadQueue* threads = new ThreadQueue(m_depth);
+        if (!threads->start()) {
+            delete threads;
+            return false;
+        }
+        m_queue = threads;
+    }
+    return true;
+}
+
+bool AsyncEngine::submit(int slot, bool write) {
+    Slot& s = m_slots[slot];
+    bool ok;
+    if (write) {
+        ok = m_queue->submit(slot, true, m_destHandle, s.data + s.done, s.length - s.done,
+                             s.offset + s.done + m_destShift);
+    } else {
+        ok = m_queue->submit(slot, false, m_sourceHandle, s.data + s.done, s.length - s.done,
+                             s.offset + s.done);
+    }
+    if (ok) {
+        m_inFlight++;
+    } else {
+        m_failed = true;
+    }
+    return ok;
+}
+
+// Put every free slot to work on the next chunk
+void AsyncEngine::startReads() {
+    for (int i = 0; i < m_depth && m_readOffset < m_endOffset && !m_failed; i++) {
+        Slot& slot = m_slots[i];
+        if (slot.state != SLOT_FREE) {
+            continue;
+        }
+        fsize_t left = m_endOffset - m_readOffset;
+        slot.offset = m_readOffset;
+        slot.length = (left < m_chunkSize) ? (long)left : m_chunkSize;
+        slot.done = 0;
+        slot.state = SLOT_READING;
+        m_readOffset += slot.length;
+        submit(i, false);
+    }
+}
+
+// Write whatever chunks are next in file order
+void AsyncEngine::startWrites() {
+    bool found = true;
+    while (found && !m_failed) {
+        found = false;
+        for (int i = 0; i < m_depth; i++) {
+            Slot& slot = m_slots[i];
+            if (slot.state == SLOT_READ && slot.offset == m_writeOffset) {
+                slot.state = SLOT_WRITING;
+                slot.done = 0;
+                m_writeOffset += slot.length;
+                submit(i, true);
+                found = true;
+            }
+        }
+    }
+}
+
+// Hand finished writes to the sink in file order and free their slots.
+// Returns the bytes the written prefix of the file grew by.
+long AsyncEngine::finishWrites() {
+    long finished = 0;
+    bool found = true;
+    while (found) {
+        found = false;
+        for (int i = 0; i < m_depth; i++) {
+            Slot& slot = m_slots[i];
+            if (slot.state == SLOT_WRITTEN && slot.offset == m_doneOffset) {
+                if (m_sink) {
+                    m_sink->onData(slot.data, slot.length);
+                }
+                slot.state = SLOT_FREE;
+                m_doneOffset += slot.length;
+                finished += slot.length;
+                found = true;
+            }
+        }
+    }
+    return finished;
+}
+
+long AsyncEngine::copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+    (void)sourceHandle;
+    (void)destHandle;
+    (void)maxBytes;
+
+    startReads();
+    long written = 0;
+    while (written == 0 && !m_failed) {
+        if (m_inFlight == 0) {
+            return 0;       // Everything read has been written
+        }
+
+        int index;
+        long result;
+        if (!m_queue->wait(index, result)) {
+            m_failed = true;
+            break;
+        }
+        m_inFlight--;
+        Slot& slot = m_slots[index];
+
+        if (slot.state == SLOT_READING) {
+            if (result < 0) {
+                m_failed = true;
+                break;
+            }
+            slot.done += result;
+            if (result == 0 || slot.offset + slot.done >= m_endOffset) {
+                // The source ended early - nothing past here gets written
+                if (slot.offset + slot.done < m_endOffset) {
+                    m_endOffset = slot.offset + slot.done;
+                }
+                slot.length = slot.done;
+            }
+            if (slot.offset >= m_endOffset || slot.length == 0) {
+                slot.state = SLOT_FREE;
+            } else if (slot.done < slot.length) {
+                submit(index, false);       // Short read - get the rest
+            } else {
+                slot.state = SLOT_READ;
+            }
+            startWrites();
+        } else if (slot.state == SLOT_WRITING) {
+            if (result <= 0) {
+                m_failed = true;
+                break;
+            }
+            slot.done += result;
+            if (slot.done < slot.length) {
+                submit(index, true);        // Short write - send the rest
+            } else {
+                slot.state = SLOT_WRITTEN;
+                written += finishWrites();
+            }
+        }
+        startReads();
+    }
+    return m_failed ? -1 : written;
+}
+
+// Wait out requests still in flight before their buffers go away
+void AsyncEngine::drain() {
+    while (m_inFlight > 0) {
+        int index;
+        long result;
+        if (!m_queue->wait(index, result)) {
+            break;
+        }
+        m_inFlight--;
+    }
+}
+
+void AsyncEngine::end() {
+    if (m_queue == NULL) {
+        return;
+    }
+    drain();
+    delete m_queue;
+    m_queue = NULL;
+
+    // Leave the handles where a plain copy would have
+    lseek(m_sourceHandle, m_doneOffset, SEEK_SET);
+    lseek(m_destHandle, m_doneOffset + m_destShift, SEEK_SET);
+}
+
+#endif // FC_THREADS
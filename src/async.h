@@ -0,0 +1,81 @@
+#ifndef ASYNC_H
+#define ASYNC_H
+
+#include "engine.h"
+#include "fcthread.h"
+
+#ifdef FC_THREADS
+
+class AsyncQueue;
+
+// Queue-depth copy: up to depth chunks are being read or written at any
+// moment, each at its own offset, so SSDs and arrays see enough requests
+// to reach their rated speed. Uses io_uring with registered buffers
+// where the kernel allows it, and otherwise one thread per slot doing
+// pread()/pwrite(). Reads and writes complete in any order; the writes
+// are issued in file order, and the sink only sees a chunk once it and
+// every chunk before it have been written, so the resume journal never
+// counts bytes that are still in flight.
+class AsyncEngine : public CopyEngine {
+private:
+    enum SlotState {
+        SLOT_FREE,
+        SLOT_READING,
+        SLOT_READ,          // Waiting for the chunks before it
+        SLOT_WRITING,
+        SLOT_WRITTEN        // Waiting for earlier writes to finish
+    };
+
+    struct Slot {
+        char* data;
+        SlotState state;
+        fsize_t offset;     // Source offset of the chunk
+        long length;
+        long done;          // Bytes of the current read or write finished
+    };
+
+    Slot* m_slots;
+    int m_depth;
+    long m_chunkSize;
+    AsyncQueue* m_queue;
+    bool m_uring;           // m_queue is io_uring rather than threads
+
+    int m_sourceHandle;
+    int m_destHandle;
+    fsize_t m_readOffset;   // Next chunk to read
+    fsize_t m_endOffset;    // End of the source, lowered if it turns out shorter
+    fsize_t m_writeOffset;  // Next chunk to write
+    fsize_t m_doneOffset;   // Everything before this is written and seen by the sink
+    fsize_t m_destShift;    // Destination offset minus source offset
+    int m_inFlight;
+    bool m_failed;
+
+    bool submit(int slot, bool write);
+    void startReads();
+    void startWrites();
+    long finishWrites();
+    void drain();
+
+    // Not copyable
+    AsyncEngine(const AsyncEngine&);
+    AsyncEngine& operator=(const AsyncEngine&);
+
+public:
+    AsyncEngine(int depth, long chunkSize);
+    virtual ~AsyncEngine();
+
+    virtual const char* getName() const { return "async"; }
+    virtual const char* getActiveName() const { return m_uring ? "async" : "async-pool"; }
+    virtual long getChunkSize() const { return m_chunkSize; }
+    virtual bool canResizeChunks() const { return false; }
+    virtual bool passesData() const { return true; }
+    virtual int getQueueDepth() const { return m_depth; }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize);
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes);
+    virtual void end();
+};
+
+#endif // FC_THREADS
+
+#endif // ASYNC_H
@@ -0,0 +1,284 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "batch.h"
+#include "dirscan.h"
+#include "hrtimer.h"
+#include "progress.h"
+#include "dedup.h"
+
+#ifdef FC_POSIX
+#include <glob.h>
+#endif
+
+const int INITIAL_BATCH_CAPACITY = 32;
+
+#ifdef FC_POSIX
+// How much of the next source to ask the kernel to read ahead
+const off_t BATCH_READAHEAD = 1024L * 1024L;
+#endif
+
+bool hasWildcard(const char* path) {
+    return strchr(path, '*') != NULL || strchr(path, '?') != NULL;
+}
+
+BatchCopy::BatchCopy()
+    : m_files(NULL), m_count(0), m_capacity(0),
+      m_overwrite(false), m_debugMode(false) {
+    m_destDir[0] = '\0';
+    m_copier.setQuiet(true);
+}
+
+BatchCopy::~BatchCopy() {
+#ifdef FC_THREADS
+    m_opener.join();
+#endif
+    for (int i = 0; i < m_count; i++) {
+        delete[] m_files[i].path;
+    }
+    delete[] m_files;
+}
+
+void BatchCopy::addFile(const char* path, const FileInfo& info) {
+    if (m_count == m_capacity) {
+        int capacity = (m_capacity == 0) ? INITIAL_BATCH_CAPACITY : m_capacity * 2;
+        BatchFile* files = new BatchFile[capacity];
+        for (int i = 0; i < m_count; i++) {
+            files[i] = m_files[i];
+        }
+        delete[] m_files;
+        m_files = files;
+        m_capacity = capacity;
+    }
+    m_files[m_count].path = new char[strlen(path) + 1];
+    strcpy(m_files[m_count].path, path);
+    m_files[m_count].info = info;
+    m_count++;
+}
+
+bool BatchCopy::addSource(const char* pattern) {
+    int before = m_count;
+#ifdef FC_DOS
+    // findfirst() only returns names - keep the directory part
+    char directory[MAXPATH];
+    strcpy(directory, pattern);
+    char* cut = NULL;
+    for (char* p = directory; *p != '\0'; p++) {
+        if (*p == '\\' || *p == '/' || *p == ':') {
+            cut = p;
+        }
+    }
+    if (cut != NULL) {
+        cut[1] = '\0';
+    } else {
+        directory[0] = '\0';
+    }
+
+    struct ffblk block;
+    int done = findfirst(pattern, &block, FA_RDONLY | FA_ARCH);
+    while (!done) {
+        char path[MAXPATH];
+        strcpy(path, directory);
+        strcat(path, block.ff_name);
+        FileInfo info;
+        infoFromFind(block, info);
+        addFile(path, info);
+        done = findnext(&block);
+    }
+#else
+    glob_t matches;
+    if (glob(pattern, 0, NULL, &matches) == 0) {
+        for (size_t i = 0; i < matches.gl_pathc; i++) {
+            FileInfo info;
+            if (statFile(matches.gl_pathv[i], info) && info.isFile()) {
+                addFile(matches.gl_pathv[i], info);
+            } else if (m_debugMode) {
+                cout << "[DEBUG] Not a file, left out: " << matches.gl_pathv[i] << endl;
+            }
+        }
+    }
+    globfree(&matches);
+#endif
+    return m_count > before;
+}
+
+bool BatchCopy::makeDestPath(int index, char* destPath) const {
+    const char* path = m_files[index].path;
+    const char* name = path;
+    for (const char* p = path; *p != '\0'; p++) {
+        if (*p == '\\' || *p == '/' || *p == ':') {
+            name = p + 1;
+        }
+    }
+    return joinPath(m_destDir, name, destPath);
+}
+
+// Everything about a file that can be done before its turn
+void BatchCopy::prepare(Prepared& prepared) {
+    const char* path = m_files[prepared.index].path;
+    prepared.handle = open(path, O_RDONLY | O_BINARY);
+#ifdef FC_POSIX
+    if (prepared.handle >= 0) {
+        posix_fadvise(prepared.handle, 0, BATCH_READAHEAD, POSIX_FADV_WILLNEED);
+    }
+#endif
+
+    // Only to have it cached by the time it's this file's turn
+    char destPath[MAXPATH];
+    if (makeDestPath(prepared.index, destPath)) {
+        FileInfo destInfo;
+        m_destInfo.lookup(destPath, destInfo);
+    }
+}
+
+#ifdef FC_THREADS
+
+void* BatchCopy::openerEntry(void* arg) {
+    Prepared* prepared = (Prepared*)arg;
+    prepared->owner->prepare(*prepared);
+    return NULL;
+}
+
+#endif // FC_THREADS
+
+bool BatchCopy::run(const char* destDir) {
+    strcpy(m_destDir, destDir);
+
+    long filesCopied = 0;
+    long filesSkipped = 0;
+    long filesFailed = 0;
+    fsize_t bytesCopied = 0;
+    Stopwatch clock;
+
+    for (int i = 0; i < m_count; i++) {
+        Prepared current;
+        current.owner = this;
+        current.index = i;
+#ifdef FC_THREADS
+        if (m_opener.isStarted()) {
+            m_opener.join();
+            current = m_next;
+        } else {
+            prepare(current);
+        }
+
+        // Get the next file ready while this one copies
+        if (i + 1 < m_count) {
+            m_next.owner = this;
+            m_next.index = i + 1;
+            m_opener.start(openerEntry, &m_next);
+        }
+#else
+        prepare(current);
+#endif
+
+        const char* sourcePath = m_files[i].path;
+        char destPath[MAXPATH];
+        if (!makeDestPath(i, destPath)) {
+            if (current.handle >= 0) {
+                close(current.handle);
+            }
+            filesFailed++;
+            cout << "[" << (i + 1) << "/" << m_count << "] " << sourcePath
+                 << " - destination path too long" << endl;
+            continue;
+        }
+
+        // Asked again rather than taken from prepare(), in case an
+        // earlier file of the same name has been copied since
+        FileInfo destInfo;
+        if (!m_overwrite && m_destInfo.lookup(destPath, destInfo)) {
+            if (current.handle >= 0) {
+                close(current.handle);
+            }
+            filesSkipped++;
+            cout << "[" << (i + 1) << "/" << m_count << "] " << sourcePath
+                 << " - exists, skipped" << endl;
+            continue;
+        }
+
+        if (current.handle >= 0) {
+            m_copier.setSourceHandle(current.handle);
+        }
+        double started = clock.lap();
+        const FileInfo& info = m_files[i].info;
+        bool ok = m_copier.copyFile(sourcePath, destPath, &info);
+        double seconds = clock.lap() - started;
+
+        if (!ok) {
+            filesFailed++;
+            cout << "[" << (i + 1) << "/" << m_count << "] " << sourcePath
+                 << " - failed" << endl;
+            continue;
+        }
+        filesCopied++;
+
+        // Another source of the same name later on must see this copy
+        FileInfo copied;
+        copied.kind = KIND_FILE;
+        copied.size = info.size;
+        m_destInfo.store(destPath, copied);
+
+        // A /dedup duplicate moved no data, so it has no speed
+        if (m_copier.wasDuplicate()) {
+            cout << "[" << (i + 1) << "/" << m_count << "] " << sourcePath
+                 << " - " << info.size << " bytes, duplicate" << endl;
+            continue;
+        }
+        bytesCopied += info.size;
+
+        char speedStr[20];
+        if (seconds > 0.0) {
+            formatSpeed((long)((double)info.size / seconds), speedStr);
+        } else {
+            strcpy(speedStr, "-");
+        }
+        cout << "[" << (i + 1) << "/" << m_count << "] " << sourcePath
+             << " - " << info.size << " bytes, " << speedStr << endl;
+    }
+
+    double totalSeconds = clock.lap();
+    long totalDuration = clock.getMillis();
+    long avgBytesPerSec = 0;
+    if (totalSeconds > 0.0) {
+        avgBytesPerSec = (long)((double)bytesCopied / totalSeconds);
+    }
+
+    char durationStr[32];
+    formatDuration(totalDuration, durationStr);
+    char speedStr[20];
+    formatSpeed(avgBytesPerSec, speedStr);
+
+    cout << "\nBatch complete: " << filesCopied << " files, "
+         << bytesCopied << " bytes in " << durationStr << " seconds" << endl;
+    cout << "Skipped: " << filesSkipped << "  Failed: " << filesFailed << endl;
+    cout << "Average speed: " << speedStr << endl;
+    DedupIndex* dedup = m_copier.getDedup();
+    if (dedup != NULL) {
+        cout << "Duplicates: " << dedup->getDuplicates() << " (" << dedup->getLinked()
+             << " hardlinked), " << dedup->getBytesSaved() << " bytes saved" << endl;
+    }
+    if (m_debugMode) {
+        cout << "[DEBUG] Destination lookups: " << m_destInfo.getLookups()
+             << ", " << m_destInfo.getCalls() << " reached the disk" << endl;
+    }
+
+    return filesFailed == 0;
+}
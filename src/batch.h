@@ -0,0 +1,79 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "platform.h"
+#include "filecopy.h"
+#include "fcthread.h"
+#include "fileinfo.h"
+
+// Several files copied into one directory by a single process: sources
+// given one after another, or as wildcards (*.DAT) expanded with
+// findfirst/findnext on DOS and glob() on Linux. Each file gets a line
+// with its own throughput and the batch ends with the totals.
+//
+// On Linux a helper thread opens the next source, starts its readahead
+// and looks up its destination while the current file copies, so a
+// batch of small files doesn't wait on one directory lookup after
+// another. Existing destinations are skipped unless overwrite is on,
+// as with /s.
+class BatchCopy {
+private:
+    struct BatchFile {
+        char* path;
+        FileInfo info;      // From the wildcard expansion, passed to FileCopy
+    };
+
+    // A source opened ahead of its turn
+    struct Prepared {
+        BatchCopy* owner;
+        int index;
+        int handle;         // -1 if it could not be opened
+    };
+
+    BatchFile* m_files;
+    int m_count;
+    int m_capacity;
+    char m_destDir[MAXPATH];
+    bool m_overwrite;
+    bool m_debugMode;
+    FileCopy m_copier;
+    FileInfoCache m_destInfo;   // Shared with m_opener
+#ifdef FC_THREADS
+    Prepared m_next;        // Filled in by m_opener
+    Thread m_opener;
+
+    static void* openerEntry(void* arg);
+#endif
+
+    void addFile(const char* path, const FileInfo& info);
+    bool makeDestPath(int index, char* destPath) const;
+    void prepare(Prepared& prepared);
+
+    // Not copyable
+    BatchCopy(const BatchCopy&);
+    BatchCopy& operator=(const BatchCopy&);
+
+public:
+    BatchCopy();
+    ~BatchCopy();
+
+    // Add a file, or every file a wildcard matches. Directories are
+    // left out. False if nothing was added.
+    bool addSource(const char* pattern);
+    int getCount() const { return m_count; }
+
+    void setOverwrite(bool overwrite) { m_overwrite = overwrite; }
+    void setDebugMode(bool mode) { m_debugMode = mode; }
+
+    // Copier used for every file - set the engine, /v and so on here
+    FileCopy& getCopier() { return m_copier; }
+
+    // Copy every file into destDir, which must exist. Returns true if
+    // no file failed.
+    bool run(const char* destDir);
+};
+
+// True if a path holds * or ? and needs expanding
+bool hasWildcard(const char* path);
+
+#endif // BATCH_H
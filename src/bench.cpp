@@ -0,0 +1,412 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include <stdlib.h>
+#include <time.h>
+#include "bench.h"
+#include "hrtimer.h"
+#include "progress.h"
+
+// Default sweep. DOS disks are small and slow, and a read() can't
+// exceed 32K; Linux targets are SSDs that need big files to get past
+// their caches.
+#ifdef FC_DOS
+static const long DEFAULT_BLOCK_SIZES[] = { 512L, 2048L, 8192L, 32256L };
+static const long DEFAULT_FILE_SIZES[] = { 1024L * 1024L, 4096L * 1024L };
+#else
+static const long DEFAULT_BLOCK_SIZES[] = { 4096L, 65536L, 1048576L, 8388608L };
+static const long DEFAULT_FILE_SIZES[] = { 16L * 1048576L, 128L * 1048576L };
+#endif
+const int DEFAULT_TRIALS = 3;
+const int MAX_TRIALS = 32;
+
+BenchOptions::BenchOptions()
+    : blockCount(sizeof(DEFAULT_BLOCK_SIZES) / sizeof(DEFAULT_BLOCK_SIZES[0])),
+      fileCount(sizeof(DEFAULT_FILE_SIZES) / sizeof(DEFAULT_FILE_SIZES[0])),
+      trials(DEFAULT_TRIALS), engineCount(1) {
+    engineNames[0] = "rw";
+    for (int i = 0; i < blockCount; i++) {
+        blockSizes[i] = DEFAULT_BLOCK_SIZES[i];
+    }
+    for (int i = 0; i < fileCount; i++) {
+        fileSizes[i] = DEFAULT_FILE_SIZES[i];
+    }
+}
+
+int parseSizeList(const char* text, long scale, fsize_t* sizes, int maxSizes) {
+    int count = 0;
+    while (*text != '\0') {
+        if (count == maxSizes) {
+            return 0;
+        }
+        // By hand rather than atol(), which stops at 2GB where long is 32 bits
+        fsize_t value = 0;
+        while (*text >= '0' && *text <= '9') {
+            value = value * 10 + (*text - '0');
+            text++;
+        }
+        if (value <= 0) {
+            return 0;
+        }
+        // An explicit K or M suffix overrides the default unit
+        long unit = scale;
+        if (*text == 'k' || *text == 'K') {
+            unit = 1024L;
+            text++;
+        } else if (*text == 'm' || *text == 'M') {
+            unit = 1048576L;
+            text++;
+        }
+        if (*text != '\0' && *text != ',') {
+            return 0;
+        }
+        sizes[count++] = value * unit;
+        if (*text == ',') {
+            text++;
+        }
+    }
+    return count;
+}
+
+int parseNameList(char* text, const char** names, int maxNames) {
+    int count = 0;
+    for (;;) {
+        char* comma = strchr(text, ',');
+        if (comma != NULL) {
+            *comma = '\0';
+        }
+        if (*text == '\0' || count == maxNames) {
+            return 0;
+        }
+        names[count++] = text;
+        if (comma == NULL) {
+            return count;
+        }
+        text = comma + 1;
+    }
+}
+
+// Sort a handful of samples in place
+static void sortRates(long* rates, int count) {
+    for (int i = 1; i < count; i++) {
+        long value = rates[i];
+        int j = i - 1;
+        while (j >= 0 && rates[j] > value) {
+            rates[j + 1] = rates[j];
+            j--;
+        }
+        rates[j + 1] = value;
+    }
+}
+
+void formatSize(fsize_t bytes, char* buffer) {
+    if (bytes >= 1048576L && bytes % 1048576L == 0) {
+        sprintf(buffer, FSIZE_FORMAT "M", bytes / 1048576L);
+    } else if (bytes >= 1024L && bytes % 1024L == 0) {
+        sprintf(buffer, FSIZE_FORMAT "K", bytes / 1024L);
+    } else {
+        sprintf(buffer, FSIZE_FORMAT, bytes);
+    }
+}
+
+Benchmark::Benchmark(const char* directory, const BenchOptions& options)
+    : m_options(options), m_buffer(NULL), m_debugMode(false) {
+    strcpy(m_directory, directory);
+    int length = strlen(m_directory);
+    if (length > 0 && m_directory[length - 1] != '\\' && m_directory[length - 1] != '/') {
+        strcat(m_directory, PATH_SEP_STR);
+    }
+    strcpy(m_scratchPath, m_directory);
+    strcat(m_scratchPath, "BENCH.TMP");
+    strcpy(m_copyPath, m_directory);
+    strcat(m_copyPath, "BENCH2.TMP");
+    strcpy(m_csvPath, m_directory);
+    strcat(m_csvPath, "BENCH.CSV");
+}
+
+Benchmark::~Benchmark() {
+    delete[] m_buffer;
+}
+
+void Benchmark::cleanup() {
+    unlink(m_scratchPath);
+    unlink(m_copyPath);
+}
+
+// Write fileSize bytes of the scratch file and flush it to the device.
+// Returns seconds, or -1 on error.
+double Benchmark::timeWrite(fsize_t fileSize, long blockSize) {
+    int handle = open(m_scratchPath, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (handle < 0) {
+        return -1.0;
+    }
+
+    Stopwatch clock;
+    fsize_t remaining = fileSize;
+    while (remaining > 0) {
+        unsigned length = (unsigned)((remaining < blockSize) ? remaining : blockSize);
+        if (write(handle, m_buffer, length) != (int)length) {
+            close(handle);
+            return -1.0;
+        }
+        remaining -= length;
+        clock.lap();
+    }
+    commitFile(handle);
+    double seconds = clock.lap();
+    close(handle);
+    return seconds;
+}
+
+// Read the scratch file back from the device. Returns seconds, or -1.
+double Benchmark::timeRead(fsize_t fileSize, long blockSize) {
+    int handle = open(m_scratchPath, O_RDONLY | O_BINARY);
+    if (handle < 0) {
+        return -1.0;
+    }
+    dropFileCache(handle);
+
+    Stopwatch clock;
+    fsize_t total = 0;
+    for (;;) {
+        int got = read(handle, m_buffer, (unsigned)blockSize);
+        if (got < 0) {
+            close(handle);
+            return -1.0;
+        }
+        if (got == 0) {
+            break;
+        }
+        total += got;
+        clock.lap();
+    }
+    double seconds = clock.lap();
+    close(handle);
+    return (total == fileSize) ? seconds : -1.0;
+}
+
+// Copy the scratch file with the given engine, blockSize per chunk.
+// Returns seconds, or -1.
+double Benchmark::timeCopy(const char* engineName, fsize_t fileSize, long blockSize) {
+    int source = open(m_scratchPath, O_RDONLY | O_BINARY);
+    if (source < 0) {
+        return -1.0;
+    }
+    int dest = open(m_copyPath, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (dest < 0) {
+        close(source);
+        return -1.0;
+    }
+    dropFileCache(source);
+
+    EngineOptions options = m_options.engineOptions;
+    options.chunkSize = blockSize;
+    options.adaptiveChunk = false;
+    CopyEngine* engine = createEngine(engineName, options);
+
+    double seconds = -1.0;
+    if (engine != NULL && engine->begin(source, dest, fileSize)) {
+        Stopwatch clock;
+        fsize_t total = 0;
+        long copied;
+        while ((copied = engine->copyChunk(source, dest, blockSize)) > 0) {
+            total += copied;
+            clock.lap();
+        }
+        engine->end();
+        commitFile(dest);
+        if (copied == 0 && total == fileSize) {
+            seconds = clock.lap();
+        }
+    }
+
+    delete engine;
+    close(source);
+    close(dest);
+    return seconds;
+}
+
+bool Benchmark::runTest(const char* test, const char* engineName, fsize_t fileSize,
+                        long blockSize, BenchResult& result) {
+    long rates[MAX_TRIALS] = { 0 };
+    int trials = m_options.trials;
+
+    result.test = test;
+    result.engine = engineName;
+    result.fileSize = fileSize;
+    result.blockSize = blockSize;
+    result.trials = trials;
+
+    // Trial 0 is the warm-up and is not counted
+    for (int trial = 0; trial <= trials; trial++) {
+        double seconds;
+        if (strcmp(test, "write") == 0) {
+            seconds = timeWrite(fileSize, blockSize);
+        } else if (strcmp(test, "read") == 0) {
+            seconds = timeRead(fileSize, blockSize);
+        } else {
+            seconds = timeCopy(engineName, fileSize, blockSize);
+        }
+        if (seconds < 0.0) {
+            cerr << "Error: " << test << " test failed in " << m_directory << endl;
+            return false;
+        }
+
+        long rate = (seconds > 0.0) ? (long)((double)fileSize / seconds) : 0;
+        if (m_debugMode) {
+            char rateStr[20];
+            formatSpeed(rate, rateStr);
+            cout << "[DEBUG] " << test << (trial == 0 ? " warm-up: " : " trial: ") << rateStr << endl;
+        }
+        if (trial > 0) {
+            rates[trial - 1] = rate;
+        }
+    }
+
+    sortRates(rates, trials);
+    result.minimum = rates[0];
+    result.maximum = rates[trials - 1];
+    if (trials % 2 == 1) {
+        result.median = rates[trials / 2];
+    } else {
+        result.median = rates[trials / 2 - 1] / 2 + rates[trials / 2] / 2;
+    }
+    return true;
+}
+
+// Room for "copy:<engine>" labels when comparing engines
+int Benchmark::getTestWidth() const {
+    return (m_options.engineCount > 1) ? 14 : 6;
+}
+
+void Benchmark::report(const BenchResult& result) {
+    char fileStr[16];
+    char blockStr[16];
+    char medianStr[20];
+    char minStr[20];
+    char maxStr[20];
+    formatSize(result.fileSize, fileStr);
+    formatSize(result.blockSize, blockStr);
+    formatSpeed(result.median, medianStr);
+    formatSpeed(result.minimum, minStr);
+    formatSpeed(result.maximum, maxStr);
+
+    // Spread as max-min relative to the median
+    char spreadStr[16];
+    double spread = 0.0;
+    if (result.median > 0) {
+        spread = (double)(result.maximum - result.minimum) * 100.0 / (double)result.median;
+    }
+    sprintf(spreadStr, "%.1f%%", spread);
+
+    // With several engines each copy row is labelled with its engine
+    char testStr[32];
+    if (result.engine != NULL && m_options.engineCount > 1) {
+        sprintf(testStr, "%s:%.20s", result.test, result.engine);
+    } else {
+        strcpy(testStr, result.test);
+    }
+
+    cout << setw(getTestWidth()) << testStr << setw(7) << fileStr << setw(7) << blockStr
+         << setw(14) << medianStr << setw(14) << minStr << setw(14) << maxStr
+         << setw(9) << spreadStr << endl;
+
+    bool newFile = (access(m_csvPath, 0) != 0);
+    ofstream csv(m_csvPath, ios::app);
+    if (!csv) {
+        cerr << "Error opening benchmark log: " << m_csvPath << endl;
+        return;
+    }
+    if (newFile) {
+        csv << "date,test,file_bytes,block_bytes,engine,trials,median_Bps,min_Bps,max_Bps,spread_pct" << endl;
+    }
+
+    time_t now = time(NULL);
+    char timeBuffer[32];
+    strftime(timeBuffer, sizeof(timeBuffer), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    char spreadCsv[16];
+    sprintf(spreadCsv, "%.1f", spread);
+
+    csv << timeBuffer << "," << result.test << "," << result.fileSize << ","
+        << result.blockSize << ","
+        << (result.engine ? result.engine : "-") << ","
+        << result.trials << "," << result.median << "," << result.minimum << ","
+        << result.maximum << "," << spreadCsv << endl;
+}
+
+bool Benchmark::run() {
+    long largestBlock = 0;
+    for (int i = 0; i < m_options.blockCount; i++) {
+        if (m_options.blockSizes[i] > largestBlock) {
+            largestBlock = m_options.blockSizes[i];
+        }
+    }
+
+    m_buffer = new char[(unsigned)largestBlock];
+    if (m_buffer == NULL) {
+        cerr << "Error: Not enough memory for " << largestBlock << " byte blocks" << endl;
+        return false;
+    }
+
+    // Incompressible data, so controllers that compress don't flatter
+    // the result
+    unsigned long seed = 12345UL;
+    for (long i = 0; i < largestBlock; i++) {
+        seed = seed * 1103515245UL + 12345UL;
+        m_buffer[i] = (char)(seed >> 16);
+    }
+
+    cout << "Benchmarking " << m_directory << " - " << m_options.trials
+         << " trials per test after one warm-up" << endl;
+    cout << endl;
+    cout << setw(getTestWidth()) << "Test" << setw(7) << "File" << setw(7) << "Block"
+         << setw(14) << "Median" << setw(14) << "Min" << setw(14) << "Max"
+         << setw(9) << "Spread" << endl;
+
+    bool ok = true;
+    for (int f = 0; f < m_options.fileCount && ok; f++) {
+        for (int b = 0; b < m_options.blockCount && ok; b++) {
+            fsize_t fileSize = m_options.fileSizes[f];
+            long blockSize = m_options.blockSizes[b];
+            BenchResult result;
+
+            // Write first - the read and copy tests use its file
+            ok = runTest("write", NULL, fileSize, blockSize, result);
+            if (ok) {
+                report(result);
+                ok = runTest("read", NULL, fileSize, blockSize, result);
+            }
+            if (ok) {
+                report(result);
+            }
+            for (int e = 0; e < m_options.engineCount && ok; e++) {
+                ok = runTest("copy", m_options.engineNames[e], fileSize, blockSize, result);
+                if (ok) {
+                    report(result);
+                }
+            }
+        }
+    }
+
+    cleanup();
+    cout << endl;
+    cout << "Results appended to " << m_csvPath << endl;
+    return ok;
+}
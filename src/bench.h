@@ -0,0 +1,90 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "platform.h"
+#include "engine.h"
+
+// Most entries in a /bench sweep list
+const int MAX_BENCH_SIZES = 16;
+
+// Most engines compared in one /bench run
+const int MAX_BENCH_ENGINES = 8;
+
+// Settings for /bench
+struct BenchOptions {
+    long blockSizes[MAX_BENCH_SIZES];   // Bytes per read/write call
+    int blockCount;
+    fsize_t fileSizes[MAX_BENCH_SIZES]; // Bytes per test file
+    int fileCount;
+    int trials;                         // Timed runs per test, after one warm-up
+    const char* engineNames[MAX_BENCH_ENGINES]; // Engines for the copy test
+    int engineCount;
+    EngineOptions engineOptions;
+
+    BenchOptions();
+};
+
+// Result of one test at one block and file size. Rates are in bytes
+// per second.
+struct BenchResult {
+    const char* test;       // "write", "read" or "copy"
+    const char* engine;     // Engine of a copy test, NULL otherwise
+    fsize_t fileSize;
+    long blockSize;
+    int trials;
+    long median;
+    long minimum;
+    long maximum;
+};
+
+// Sequential throughput benchmark (/bench). For every file size and
+// block size it times a pure write, a pure read and a copy of a scratch
+// file in the target directory, each once to warm up and then
+// options.trials times. Results go to the console and are appended to
+// BENCH.CSV in the target directory, next to TRANSFER.LOG.
+class Benchmark {
+private:
+    BenchOptions m_options;
+    char m_directory[MAXPATH];
+    char m_scratchPath[MAXPATH];
+    char m_copyPath[MAXPATH];
+    char m_csvPath[MAXPATH];
+    char* m_buffer;
+    bool m_debugMode;
+
+    double timeWrite(fsize_t fileSize, long blockSize);
+    double timeRead(fsize_t fileSize, long blockSize);
+    double timeCopy(const char* engineName, fsize_t fileSize, long blockSize);
+    bool runTest(const char* test, const char* engineName, fsize_t fileSize,
+                 long blockSize, BenchResult& result);
+    int getTestWidth() const;
+    void report(const BenchResult& result);
+    void cleanup();
+
+    // Not copyable
+    Benchmark(const Benchmark&);
+    Benchmark& operator=(const Benchmark&);
+
+public:
+    Benchmark(const char* directory, const BenchOptions& options);
+    ~Benchmark();
+
+    void setDebugMode(bool mode) { m_debugMode = mode; }
+
+    // Run the whole sweep. Returns false if a test could not run.
+    bool run();
+};
+
+// Parse a comma-separated list of sizes in units of scale bytes, e.g.
+// "4,64,1024" with scale 1024. A K or M suffix gives the unit explicitly
+// ("64K,1M"). Returns the number of entries, 0 on error.
+int parseSizeList(const char* text, long scale, fsize_t* sizes, int maxSizes);
+
+// Split a comma-separated list of names in place, e.g. "rw,mmap".
+// Returns the number of names, 0 on error.
+int parseNameList(char* text, const char** names, int maxNames);
+
+// Format a byte count compactly: 512, 8K, 64M
+void formatSize(fsize_t bytes, char* buffer);
+
+#endif // BENCH_H
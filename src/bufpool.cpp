@@ -0,0 +1,93 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "bufpool.h"
+#include "fcthread.h"
+#include <stdlib.h>
+
+// Idle buffers kept for reuse - one per tree-copy worker is plenty
+const int MAX_POOLED_BUFFERS = 16;
+
+struct PooledBuffer {
+    char* buffer;
+    long size;
+};
+
+static PooledBuffer gPool[MAX_POOLED_BUFFERS];
+static int gPooled = 0;
+
+#ifdef FC_THREADS
+static Mutex gPoolLock;
+#endif
+
+static char* allocateAligned(long size) {
+#ifdef FC_POSIX
+    void* buffer = NULL;
+    if (posix_memalign(&buffer, (size_t)DIRECT_ALIGNMENT, (size_t)size) != 0) {
+        return NULL;
+    }
+    return (char*)buffer;
+#else
+    // No direct I/O on DOS, so alignment buys nothing
+    return new char[(unsigned)size];
+#endif
+}
+
+static void freeAligned(char* buffer) {
+#ifdef FC_POSIX
+    free(buffer);
+#else
+    delete[] buffer;
+#endif
+}
+
+char* BufferPool::acquire(long size) {
+    {
+#ifdef FC_THREADS
+        ScopedLock lock(gPoolLock);
+#endif
+        for (int i = 0; i < gPooled; i++) {
+            if (gPool[i].size == size) {
+                char* buffer = gPool[i].buffer;
+                gPool[i] = gPool[--gPooled];
+                return buffer;
+            }
+        }
+    }
+    return allocateAligned(size);
+}
+
+void BufferPool::release(char* buffer, long size) {
+    if (buffer == NULL) {
+        return;
+    }
+    {
+#ifdef FC_THREADS
+        ScopedLock lock(gPoolLock);
+#endif
+        if (gPooled < MAX_POOLED_BUFFERS) {
+            gPool[gPooled].buffer = buffer;
+            gPool[gPooled].size = size;
+            gPooled++;
+            return;
+        }
+    }
+    freeAligned(buffer);
+}
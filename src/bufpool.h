@@ -0,0 +1,23 @@
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+#include "platform.h"
+
+// Alignment for direct I/O buffers, offsets and lengths. O_DIRECT wants
+// the device's logical block size; a page covers every disk we meet.
+const long DIRECT_ALIGNMENT = 4096L;
+
+// Process-wide pool of aligned buffers. A released buffer is kept for
+// the next acquire() of the same size, so a tree copy allocates once per
+// worker instead of once per file. Safe to use from several threads.
+class BufferPool {
+public:
+    // Buffer of size bytes aligned to DIRECT_ALIGNMENT, NULL if out of
+    // memory
+    static char* acquire(long size);
+
+    // Hand a buffer back; freed if the pool is full
+    static void release(char* buffer, long size);
+};
+
+#endif // BUFPOOL_H
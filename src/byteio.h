@@ -0,0 +1,41 @@
+#ifndef BYTEIO_H
+#define BYTEIO_H
+
+#include "platform.h"
+
+// Little-endian fields for the files DOS and Linux read back from each
+// other: the resume journal, the block index and the /pack container.
+
+inline void putValue(unsigned char* buffer, unsigned long value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buffer[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+inline unsigned long getValue(const unsigned char* buffer, int bytes) {
+    unsigned long value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | buffer[i];
+    }
+    return value;
+}
+
+// 8-byte size and time fields. On DOS only the low four bytes carry
+// anything.
+inline void putSize(unsigned char* buffer, fsize_t value) {
+    for (int i = 0; i < 8; i++) {
+        buffer[i] = (unsigned char)(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+inline fsize_t getSize(const unsigned char* buffer) {
+    fsize_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | buffer[i];
+    }
+    return value;
+}
+
+#endif // BYTEIO_H
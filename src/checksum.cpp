@@ -0,0 +1,299 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "checksum.h"
+
+#if defined(FC_POSIX) && defined(__GNUC__) && defined(__x86_64__)
+#define FC_HW_CRC32C 1
+#include <nmmintrin.h>
+#endif
+
+// Reflected polynomials for CRC-32 and CRC-32C
+const unsigned long CRC32_POLY = 0xEDB88320UL;
+const unsigned long CRC32C_POLY = 0x82F63B78UL;
+
+// Table entries are 32 bits; a 64-bit unsigned long would double the
+// tables' cache footprint on Linux
+#ifdef FC_POSIX
+typedef uint32_t CrcWord;
+#else
+typedef unsigned long CrcWord;
+#endif
+
+// Slicing-by-8: table[k][b] is the CRC of byte b followed by k zero
+// bytes, so eight bytes are folded in with eight independent lookups
+static CrcWord crcTable[8][256];
+static CrcWord crc32cTable[8][256];
+
+// Adler-32 modulus, and the most bytes that can be summed before the
+// 32-bit sums must be reduced
+const unsigned long ADLER32_BASE = 65521UL;
+const long ADLER32_NMAX = 5552L;
+
+static void buildSlicingTable(CrcWord table[8][256], unsigned long poly) {
+    for (unsigned int i = 0; i < 256; i++) {
+        unsigned long crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : (crc >> 1);
+        }
+        table[0][i] = (CrcWord)crc;
+    }
+    for (unsigned int i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+        }
+    }
+}
+
+// Build the lookup tables once at startup, before any worker thread runs
+static bool buildCrcTable() {
+    buildSlicingTable(crcTable, CRC32_POLY);
+    buildSlicingTable(crc32cTable, CRC32C_POLY);
+    return true;
+}
+
+static bool crcTableReady = buildCrcTable();
+
+static unsigned long sliceBy8(CrcWord table[8][256], unsigned long crc, const void* data, long length) {
+    if (!crcTableReady) {
+        crcTableReady = buildCrcTable();
+    }
+
+    CrcWord c = (CrcWord)crc;
+    const unsigned char* bytes = (const unsigned char*)data;
+    while (length >= 8) {
+        // Assembled byte by byte so it works on any byte order
+        c ^= (CrcWord)bytes[0] | ((CrcWord)bytes[1] << 8) |
+             ((CrcWord)bytes[2] << 16) | ((CrcWord)bytes[3] << 24);
+        c = table[7][c & 0xFF] ^ table[6][(c >> 8) & 0xFF] ^
+            table[5][(c >> 16) & 0xFF] ^ table[4][(c >> 24) & 0xFF] ^
+            table[3][bytes[4]] ^ table[2][bytes[5]] ^
+            table[1][bytes[6]] ^ table[0][bytes[7]];
+        bytes += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        c = table[0][(c ^ *bytes++) & 0xFF] ^ (c >> 8);
+    }
+    return (unsigned long)c;
+}
+
+unsigned long crc32Update(unsigned long crc, const void* data, long length) {
+    return sliceBy8(crcTable, crc, data, length);
+}
+
+#ifdef FC_HW_CRC32C
+
+static bool hasSse42 = __builtin_cpu_supports("sse4.2");
+
+__attribute__((target("sse4.2")))
+static unsigned long crc32cSse42(unsigned long crc, const void* data, long length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    uint64_t c = (uint32_t)crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        c = _mm_crc32_u64(c, word);
+        bytes += 8;
+        length -= 8;
+    }
+    uint32_t c32 = (uint32_t)c;
+    while (length-- > 0) {
+        c32 = _mm_crc32_u8(c32, *bytes++);
+    }
+    return c32;
+}
+
+bool crc32cHardware() {
+    return hasSse42;
+}
+
+unsigned long crc32cUpdate(unsigned long crc, const void* data, long length) {
+    if (hasSse42) {
+        return crc32cSse42(crc, data, length);
+    }
+    return sliceBy8(crc32cTable, crc, data, length);
+}
+
+#else
+
+bool crc32cHardware() {
+    return false;
+}
+
+unsigned long crc32cUpdate(unsigned long crc, const void* data, long length) {
+    return sliceBy8(crc32cTable, crc, data, length);
+}
+
+#endif // FC_HW_CRC32C
+
+unsigned long adler32Update(unsigned long adler, const void* data, long length) {
+    unsigned long a = adler & 0xFFFFUL;
+    unsigned long b = (adler >> 16) & 0xFFFFUL;
+
+    const unsigned char* bytes = (const unsigned char*)data;
+    while (length > 0) {
+        long run = (length < ADLER32_NMAX) ? length : ADLER32_NMAX;
+        length -= run;
+        while (run-- > 0) {
+            a += *bytes++;
+            b += a;
+        }
+        a %= ADLER32_BASE;
+        b %= ADLER32_BASE;
+    }
+    return ((b << 16) | a) & 0xFFFFFFFFUL;
+}
+
+#ifdef FC_POSIX
+
+// XXH64 primes
+const uint64_t XXH_PRIME1 = 0x9E3779B185EBCA87ULL;
+const uint64_t XXH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t XXH_PRIME3 = 0x165667B19E3779F9ULL;
+const uint64_t XXH_PRIME4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t XXH_PRIME5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Little-endian loads. On little-endian machines a plain unaligned load
+// is several times faster than assembling the bytes.
+static inline uint64_t readLE64(const unsigned char* bytes) {
+    uint64_t value;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&value, bytes, 8);
+#else
+    value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | bytes[i];
+    }
+#endif
+    return value;
+}
+
+static inline uint32_t readLE32(const unsigned char* bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static inline uint64_t xxhRound(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME1;
+}
+
+static inline uint64_t xxhMerge(uint64_t hash, uint64_t acc) {
+    hash ^= xxhRound(0, acc);
+    return hash * XXH_PRIME1 + XXH_PRIME4;
+}
+
+void xxh64Reset(Xxh64State& state) {
+    state.acc[0] = XXH_PRIME1 + XXH_PRIME2;
+    state.acc[1] = XXH_PRIME2;
+    state.acc[2] = 0;
+    state.acc[3] = 0 - XXH_PRIME1;
+    state.total = 0;
+    state.pendingSize = 0;
+}
+
+// Fold in 32-byte stripes
+static const unsigned char* xxhStripes(Xxh64State& state, const unsigned char* bytes, const unsigned char* end) {
+    uint64_t a0 = state.acc[0], a1 = state.acc[1], a2 = state.acc[2], a3 = state.acc[3];
+    while (bytes + 32 <= end) {
+        a0 = xxhRound(a0, readLE64(bytes));
+        a1 = xxhRound(a1, readLE64(bytes + 8));
+        a2 = xxhRound(a2, readLE64(bytes + 16));
+        a3 = xxhRound(a3, readLE64(bytes + 24));
+        bytes += 32;
+    }
+    state.acc[0] = a0; state.acc[1] = a1; state.acc[2] = a2; state.acc[3] = a3;
+    return bytes;
+}
+
+void xxh64Update(Xxh64State& state, const void* data, long length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    const unsigned char* end = bytes + length;
+    state.total += (uint64_t)length;
+
+    // Top up a partial stripe left by the previous call
+    if (state.pendingSize > 0) {
+        unsigned take = 32 - state.pendingSize;
+        if ((long)take > length) {
+            take = (unsigned)length;
+        }
+        memcpy(state.pending + state.pendingSize, bytes, take);
+        state.pendingSize += take;
+        bytes += take;
+        if (state.pendingSize < 32) {
+            return;
+        }
+        xxhStripes(state, state.pending, state.pending + 32);
+        state.pendingSize = 0;
+    }
+
+    bytes = xxhStripes(state, bytes, end);
+    if (bytes < end) {
+        state.pendingSize = (unsigned)(end - bytes);
+        memcpy(state.pending, bytes, state.pendingSize);
+    }
+}
+
+uint64_t xxh64Final(const Xxh64State& state) {
+    uint64_t hash;
+    if (state.total >= 32) {
+        hash = rotl64(state.acc[0], 1) + rotl64(state.acc[1], 7) +
+               rotl64(state.acc[2], 12) + rotl64(state.acc[3], 18);
+        for (int i = 0; i < 4; i++) {
+            hash = xxhMerge(hash, state.acc[i]);
+        }
+    } else {
+        hash = state.acc[2] + XXH_PRIME5;
+    }
+    hash += state.total;
+
+    // Tail: whatever didn't fill a stripe
+    const unsigned char* bytes = state.pending;
+    const unsigned char* end = bytes + state.pendingSize;
+    while (bytes + 8 <= end) {
+        hash ^= xxhRound(0, readLE64(bytes));
+        hash = rotl64(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+        bytes += 8;
+    }
+    if (bytes + 4 <= end) {
+        hash ^= (uint64_t)readLE32(bytes) * XXH_PRIME1;
+        hash = rotl64(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+        bytes += 4;
+    }
+    while (bytes < end) {
+        hash ^= (*bytes) * XXH_PRIME5;
+        hash = rotl64(hash, 11) * XXH_PRIME1;
+        bytes++;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+#endif // FC_POSIX
@@ -0,0 +1,46 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "platform.h"
+
+// CRC-32 (IEEE 802.3, the one used by ZIP and PKZIP). Start with
+// CRC32_INIT, feed blocks in order, and finish with crc32Final().
+const unsigned long CRC32_INIT = 0xFFFFFFFFUL;
+
+unsigned long crc32Update(unsigned long crc, const void* data, long length);
+
+inline unsigned long crc32Final(unsigned long crc) {
+    return (crc ^ 0xFFFFFFFFUL) & 0xFFFFFFFFUL;
+}
+
+// CRC-32C (Castagnoli, as used by iSCSI and ext4). Same start and finish
+// as CRC-32. Uses the SSE 4.2 CRC32 instruction when the CPU has it.
+unsigned long crc32cUpdate(unsigned long crc, const void* data, long length);
+
+// True if crc32cUpdate() runs in hardware on this machine
+bool crc32cHardware();
+
+// Adler-32 (RFC 1950). Cheap, and independent enough of CRC-32 that the
+// pair makes a 64-bit block fingerprint without 64-bit arithmetic.
+const unsigned long ADLER32_INIT = 1UL;
+
+unsigned long adler32Update(unsigned long adler, const void* data, long length);
+
+#ifdef FC_POSIX
+
+// XXH64 - fast 64-bit non-cryptographic hash (xxHash, seed 0).
+// Needs 64-bit arithmetic, so it is not in the DOS build.
+struct Xxh64State {
+    uint64_t acc[4];
+    uint64_t total;
+    unsigned char pending[32];
+    unsigned pendingSize;
+};
+
+void xxh64Reset(Xxh64State& state);
+void xxh64Update(Xxh64State& state, const void* data, long length);
+uint64_t xxh64Final(const Xxh64State& state);
+
+#endif // FC_POSIX
+
+#endif // CHECKSUM_H
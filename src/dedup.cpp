@@ -0,0 +1,391 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "dedup.h"
+#include "checksum.h"
+#include "fileinfo.h"
+#include "dirscan.h"
+#include <stdlib.h>
+#ifdef FC_POSIX
+#include <errno.h>
+#endif
+
+// Size hash buckets; the entries themselves grow as needed
+#ifdef FC_DOS
+const long DEDUP_BUCKETS = 256L;
+const long DEDUP_READ_SIZE = 8192L;
+#else
+const long DEDUP_BUCKETS = 4096L;
+const long DEDUP_READ_SIZE = 1024L * 1024L;
+#endif
+
+static const char DEDUP_INDEX_NAME[] = "DEDUP.IDX";
+static const char DEDUP_LIST_NAME[] = "DEDUP.LST";
+static const char DEDUP_INDEX_MAGIC[] = "FCDEDUP 1";
+
+void ContentHash::reset() {
+    m_crc = CRC32_INIT;
+    m_adler = ADLER32_INIT;
+    m_size = 0;
+}
+
+void ContentHash::onData(const char* data, long length) {
+    m_crc = crc32Update(m_crc, data, length);
+    m_adler = adler32Update(m_adler, data, length);
+    m_size += length;
+}
+
+void ContentHash::getKey(ContentKey& key) const {
+    key.size = m_size;
+    key.crc = crc32Final(m_crc);
+    key.adler = m_adler;
+}
+
+bool hashFile(int handle, ContentHash& hash) {
+    if (lseek(handle, 0L, SEEK_SET) != 0) {
+        return false;
+    }
+    char* buffer = new char[(unsigned)DEDUP_READ_SIZE];
+    if (buffer == NULL) {
+        return false;
+    }
+    bool ok = true;
+    for (;;) {
+        int got = read(handle, buffer, (unsigned)DEDUP_READ_SIZE);
+        if (got < 0) {
+            ok = false;
+            break;
+        }
+        if (got == 0) {
+            break;
+        }
+        hash.onData(buffer, got);
+    }
+    delete[] buffer;
+    return lseek(handle, 0L, SEEK_SET) == 0 && ok;
+}
+
+bool sameContent(int handle, const char* path) {
+    int other = open(path, O_RDONLY | O_BINARY);
+    if (other < 0) {
+        return false;
+    }
+    char* buffer = new char[(unsigned)DEDUP_READ_SIZE];
+    char* otherBuffer = new char[(unsigned)DEDUP_READ_SIZE];
+    bool same = buffer != NULL && otherBuffer != NULL && lseek(handle, 0L, SEEK_SET) == 0;
+    // Regular files only come up short at the end; anything else counts
+    // as a difference, which just means the file gets copied
+    while (same) {
+        int got = read(handle, buffer, (unsigned)DEDUP_READ_SIZE);
+        int otherGot = read(other, otherBuffer, (unsigned)DEDUP_READ_SIZE);
+        if (got < 0 || got != otherGot || memcmp(buffer, otherBuffer, got) != 0) {
+            same = false;
+        } else if (got == 0) {
+            break;
+        }
+    }
+    delete[] otherBuffer;
+    delete[] buffer;
+    close(other);
+    return lseek(handle, 0L, SEEK_SET) == 0 && same;
+}
+
+DedupIndex::DedupIndex(const char* root)
+    : m_entries(NULL), m_count(0), m_capacity(0), m_duplicates(0), m_linked(0),
+      m_bytesSaved(0) {
+    // Same separators as the paths FileCopy hands in
+    strcpy(m_root, root);
+    for (int i = 0; m_root[i] != '\0'; i++) {
+        if (m_root[i] == '/' || m_root[i] == '\\') {
+            m_root[i] = PATH_SEP;
+        }
+    }
+    int length = strlen(m_root);
+    if (length > 1 && m_root[length - 1] == PATH_SEP) {
+        m_root[length - 1] = '\0';
+    }
+    m_buckets = new long[DEDUP_BUCKETS];
+    for (long i = 0; i < DEDUP_BUCKETS; i++) {
+        m_buckets[i] = -1;
+    }
+}
+
+DedupIndex::~DedupIndex() {
+    for (long i = 0; i < m_count; i++) {
+        delete[] m_entries[i].path;
+    }
+    delete[] m_entries;
+    delete[] m_buckets;
+}
+
+long DedupIndex::bucketOf(fsize_t size) const {
+    unsigned long folded = (unsigned long)size ^ (unsigned long)(size >> 16);
+    return (long)(folded % (unsigned long)DEDUP_BUCKETS);
+}
+
+DedupIndex::Entry& DedupIndex::insert(const ContentKey& key, long mtime, const char* path) {
+    if (m_count == m_capacity) {
+        long capacity = (m_capacity == 0) ? 64 : m_capacity * 2;
+        Entry* entries = new Entry[capacity];
+        for (long i = 0; i < m_count; i++) {
+            entries[i] = m_entries[i];
+        }
+        delete[] m_entries;
+        m_entries = entries;
+        m_capacity = capacity;
+    }
+
+    Entry& entry = m_entries[m_count];
+    entry.key = key;
+    entry.mtime = mtime;
+    entry.path = new char[strlen(path) + 1];
+    strcpy(entry.path, path);
+    entry.state = ENTRY_READY;
+
+    long bucket = bucketOf(key.size);
+    entry.next = m_buckets[bucket];
+    m_buckets[bucket] = m_count;
+    m_count++;
+    return entry;
+}
+
+DedupIndex::Entry* DedupIndex::entryFor(const ContentKey& key, const char* path) {
+    for (long i = m_buckets[bucketOf(key.size)]; i >= 0; i = m_entries[i].next) {
+        if (strcmp(m_entries[i].path, path) == 0) {
+            return &m_entries[i];
+        }
+    }
+    return NULL;
+}
+
+void DedupIndex::reserveEntry(const ContentKey& key, const char* path) {
+    Entry* entry = entryFor(key, path);
+    if (entry == NULL) {
+        entry = &insert(key, 0, path);
+    }
+    entry->key = key;
+    entry->mtime = 0;
+    entry->state = ENTRY_PENDING;
+}
+
+// End a reservation and wake the workers waiting on it
+void DedupIndex::settle(const ContentKey& key, const char* path, bool ready, long mtime) {
+    Entry* entry = entryFor(key, path);
+    if (entry != NULL) {
+        entry->key = key;
+        entry->mtime = mtime;
+        entry->state = ready ? ENTRY_READY : ENTRY_DROPPED;
+    } else if (ready) {
+        insert(key, mtime, path);
+    }
+#ifdef FC_THREADS
+    m_settled.broadcast();
+#endif
+}
+
+// Path below the root, or the path itself if it is somewhere else
+const char* DedupIndex::relativePath(const char* path) const {
+    int length = strlen(m_root);
+    if (strnicmp(path, m_root, length) == 0 && (path[length] == '/' || path[length] == '\\')) {
+        return path + length + 1;
+    }
+    return path;
+}
+
+bool DedupIndex::makeIndexPath(const char* name, char* result) const {
+    return joinPath(m_root, name, result);
+}
+
+bool DedupIndex::claim(const ContentKey& key, const char* destPath, char* originalPath) {
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    for (;;) {
+        bool pending = false;
+        for (long i = m_buckets[bucketOf(key.size)]; i >= 0; i = m_entries[i].next) {
+            const Entry& entry = m_entries[i];
+            if (entry.key.size != key.size || entry.key.crc != key.crc ||
+                entry.key.adler != key.adler || entry.state == ENTRY_DROPPED ||
+                strcmp(entry.path, destPath) == 0) {
+                continue;
+            }
+            if (entry.state == ENTRY_PENDING) {
+                pending = true;
+                continue;
+            }
+            // Only a copy nobody has touched since it was recorded
+            FileInfo info;
+            if (statFile(entry.path, info) && info.isFile() &&
+                info.size == entry.key.size && info.mtime == entry.mtime) {
+                strcpy(originalPath, entry.path);
+                return true;
+            }
+        }
+#ifdef FC_THREADS
+        // Another worker is writing this content right now
+        if (pending) {
+            m_settled.wait(m_lock);
+            continue;
+        }
+#else
+        (void)pending;
+#endif
+        break;
+    }
+    reserveEntry(key, destPath);
+    return false;
+}
+
+void DedupIndex::reserve(const ContentKey& key, const char* destPath) {
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    reserveEntry(key, destPath);
+}
+
+void DedupIndex::add(const ContentKey& key, const char* destPath) {
+    FileInfo info;
+    bool copied = statFile(destPath, info) && info.isFile();
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    settle(key, destPath, copied, copied ? info.mtime : 0);
+}
+
+void DedupIndex::abandon(const ContentKey& key, const char* destPath) {
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    settle(key, destPath, false, 0);
+}
+
+bool DedupIndex::listDuplicate(const char* destPath, const char* originalPath, fsize_t size) {
+    char listPath[MAXPATH];
+    if (!makeIndexPath(DEDUP_LIST_NAME, listPath)) {
+        cerr << "Error: Path too long for the duplicate list: " << m_root << endl;
+        return false;
+    }
+    ofstream list(listPath, ios::app);
+    if (!list) {
+        cerr << "Error writing duplicate list: " << listPath << endl;
+        return false;
+    }
+    char sizeStr[24];
+    sprintf(sizeStr, FSIZE_FORMAT, size);
+    list << sizeStr << "\t" << relativePath(destPath) << "\t" << relativePath(originalPath) << endl;
+    return !list.fail();
+}
+
+bool DedupIndex::placeDuplicate(const char* originalPath, const char* destPath, fsize_t size,
+                                bool& linked) {
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    // Whatever was there before is being replaced (the caller checked
+    // overwrite) - an old file left behind would not match the list
+    unlink(destPath);
+
+    linked = false;
+#ifdef FC_POSIX
+    // FAT, SMB mounts and the like refuse links; those get listed instead
+    if (link(originalPath, destPath) == 0) {
+        linked = true;
+    }
+#endif
+    if (!linked && !listDuplicate(destPath, originalPath, size)) {
+        return false;
+    }
+
+    m_duplicates++;
+    if (linked) {
+        m_linked++;
+    }
+    m_bytesSaved += size;
+    return true;
+}
+
+bool DedupIndex::load() {
+    char indexPath[MAXPATH];
+    if (!makeIndexPath(DEDUP_INDEX_NAME, indexPath)) {
+        cerr << "Warning: Path too long for the dedup index: " << m_root << endl;
+        return false;
+    }
+    ifstream file(indexPath);
+    if (!file) {
+        return true;
+    }
+
+    char line[MAXPATH + 64];
+    file.getline(line, sizeof(line));
+    if (strcmp(line, DEDUP_INDEX_MAGIC) != 0) {
+        cerr << "Warning: Not a dedup index, ignored: " << indexPath << endl;
+        return false;
+    }
+
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    while (file.getline(line, sizeof(line))) {
+        ContentKey key;
+        long mtime;
+        int nameStart = 0;
+        if (sscanf(line, FSIZE_FORMAT " %lx %lx %ld %n", &key.size, &key.crc, &key.adler,
+                   &mtime, &nameStart) < 4 || nameStart == 0 || line[nameStart] == '\0') {
+            continue;
+        }
+        char path[MAXPATH];
+        if (joinPath(m_root, line + nameStart, path)) {
+            insert(key, mtime, path);
+        }
+    }
+    return true;
+}
+
+bool DedupIndex::save() {
+    char indexPath[MAXPATH];
+    if (!makeIndexPath(DEDUP_INDEX_NAME, indexPath)) {
+        cerr << "Error: Path too long for the dedup index: " << m_root << endl;
+        return false;
+    }
+    ofstream file(indexPath);
+    if (!file) {
+        cerr << "Error writing dedup index: " << indexPath << endl;
+        return false;
+    }
+
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    file << DEDUP_INDEX_MAGIC << endl;
+    for (long i = 0; i < m_count; i++) {
+        const Entry& entry = m_entries[i];
+        FileInfo info;
+        if (entry.state != ENTRY_READY ||
+            !statFile(entry.path, info) || info.size != entry.key.size ||
+            info.mtime != entry.mtime) {
+            continue;
+        }
+        char fields[80];
+        sprintf(fields, FSIZE_FORMAT " %08lx %08lx %ld ", entry.key.size, entry.key.crc,
+                entry.key.adler, entry.mtime);
+        file << fields << relativePath(entry.path) << endl;
+    }
+    return !file.fail();
+}
@@ -0,0 +1,142 @@
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include "platform.h"
+#include "engine.h"
+#include "fcthread.h"
+
+// Fingerprint of a whole file. CRC-32 and Adler-32 together make 64
+// bits without 64-bit arithmetic (as in delta.h). Adler-32 is weak on
+// short files, so a match only picks the candidate - sameContent()
+// decides.
+struct ContentKey {
+    fsize_t size;
+    unsigned long crc;
+    unsigned long adler;
+};
+
+// Builds a ContentKey from the data as a copy engine writes it, or
+// from hashFile()
+class ContentHash : public DataSink {
+private:
+    unsigned long m_crc;
+    unsigned long m_adler;
+    fsize_t m_size;
+
+public:
+    ContentHash() { reset(); }
+
+    void reset();
+    virtual void onData(const char* data, long length);
+    void getKey(ContentKey& key) const;
+};
+
+// Hash an open file from the start to the end, then seek back to the
+// start. Returns false on a read error.
+bool hashFile(int handle, ContentHash& hash);
+
+// True if the open file and the file at path hold the same bytes. The
+// handle is left at the start.
+bool sameContent(int handle, const char* path);
+
+// Content index for /dedup. Every file a tree or batch copy writes is
+// recorded with its ContentKey; a later source with the same content
+// becomes a hardlink to the first copy (Linux), or - where there are no
+// links, as on DOS and FAT - is left out and listed in DEDUP.LST in the
+// destination root:
+//
+//   size <TAB> skipped file <TAB> file with the same content
+//
+// With /dedup:keep the index is loaded from and saved to DEDUP.IDX in
+// the destination root, so the next run links against earlier copies.
+// Paths in both files are relative to the root. A recorded file that
+// has since changed size or time is not linked to.
+//
+// A copy claims its content before it starts, so a tree-copy worker
+// that meets the same content meanwhile waits for that copy to finish
+// and then links to it, rather than writing it a second time.
+//
+// Shared by the tree-copy workers; every call takes the lock.
+class DedupIndex {
+private:
+    enum EntryState {
+        ENTRY_PENDING,      // Claimed, still being copied
+        ENTRY_READY,
+        ENTRY_DROPPED       // The copy failed
+    };
+
+    struct Entry {
+        ContentKey key;
+        long mtime;         // Of the copy, as statFile() gives it
+        char* path;
+        EntryState state;
+        long next;          // Next entry in the same bucket, -1 at the end
+    };
+
+    char m_root[MAXPATH];
+    Entry* m_entries;
+    long m_count;
+    long m_capacity;
+    long* m_buckets;        // First entry for each size hash, -1 if none
+    long m_duplicates;
+    long m_linked;
+    fsize_t m_bytesSaved;
+#ifdef FC_THREADS
+    Mutex m_lock;
+    Condition m_settled;    // A pending entry became ready or was dropped
+#endif
+
+    long bucketOf(fsize_t size) const;
+    Entry& insert(const ContentKey& key, long mtime, const char* path);
+    Entry* entryFor(const ContentKey& key, const char* path);
+    void reserveEntry(const ContentKey& key, const char* path);
+    void settle(const ContentKey& key, const char* path, bool ready, long mtime);
+    const char* relativePath(const char* path) const;
+    bool makeIndexPath(const char* name, char* result) const;
+    bool listDuplicate(const char* destPath, const char* originalPath, fsize_t size);
+
+    // Not copyable
+    DedupIndex(const DedupIndex&);
+    DedupIndex& operator=(const DedupIndex&);
+
+public:
+    // root is the destination directory of the tree or batch
+    DedupIndex(const char* root);
+    ~DedupIndex();
+
+    // Look for a copy with the same key, other than destPath itself, that
+    // is still as it was recorded, first waiting out any other worker
+    // still writing one. Fills in originalPath and returns true if there
+    // is one. Otherwise destPath is reserved for this content and the
+    // caller must end the reservation with add() or abandon().
+    bool claim(const ContentKey& key, const char* destPath, char* originalPath);
+
+    // Reserve destPath for this content even though claim() found a
+    // candidate (it turned out to hold different bytes)
+    void reserve(const ContentKey& key, const char* destPath);
+
+    // Record a file that has just been copied to destPath, replacing
+    // what was recorded for it before
+    void add(const ContentKey& key, const char* destPath);
+
+    // The copy to destPath failed - nothing may link to it
+    void abandon(const ContentKey& key, const char* destPath);
+
+    // Stand in for copying a duplicate to destPath: a hardlink to
+    // originalPath where the filesystem allows, otherwise a DEDUP.LST
+    // line. linked says which. Returns false if neither worked.
+    bool placeDuplicate(const char* originalPath, const char* destPath, fsize_t size,
+                        bool& linked);
+
+    // DEDUP.IDX in the destination root (/dedup:keep). A missing file
+    // is not an error. Files changed since they were recorded are left
+    // out when saving.
+    bool load();
+    bool save();
+
+    long getDuplicates() const { return m_duplicates; }
+    long getLinked() const { return m_linked; }
+    fsize_t getBytesSaved() const { return m_bytesSaved; }
+};
+
+#endif // DEDUP_H
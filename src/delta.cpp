@@ -0,0 +1,258 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "delta.h"
+#include "checksum.h"
+#include "byteio.h"
+#include "dirscan.h"
+#include <sys/stat.h>
+
+// Index layout, little-endian:
+//   0  "FCI1"
+//   4  block size              (4 bytes)
+//   8  destination size        (8 bytes)
+//  16  destination time        (8 bytes)
+//  24  CRC-32 of bytes 0-23
+//  28  one 8-byte entry per block: CRC-32, Adler-32
+const int HEADER_SIZE = 28;
+const int ENTRY_SIZE = 8;
+const char INDEX_MAGIC[] = "FCI1";
+
+// Sidecar name: ACCOUNTS.DBF.IDX, or ACCOUNTS.20# on DOS
+const char INDEX_EXTENSION[] = ".IDX";
+const char INDEX_MARKER = '#';
+
+// Read until length bytes or end of file. Returns bytes read, -1 on error.
+static long readFull(int handle, char* data, long length) {
+    long total = 0;
+    while (total < length) {
+        int got = read(handle, data + total, (unsigned)(length - total));
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            break;
+        }
+        total += got;
+    }
+    return total;
+}
+
+static bool writeFull(int handle, const char* data, long length) {
+    while (length > 0) {
+        int put = write(handle, data, (unsigned)length);
+        if (put <= 0) {
+            return false;
+        }
+        data += put;
+        length -= put;
+    }
+    return true;
+}
+
+// Modification time as precisely as the platform keeps it. DOS has
+// two-second resolution; Linux has nanoseconds, which catches a change
+// made in the same second as the last sync.
+static fsize_t fileStamp(const struct stat& st) {
+#ifdef FC_POSIX
+    return (fsize_t)st.st_mtim.tv_sec * 1000000000LL + (fsize_t)st.st_mtim.tv_nsec;
+#else
+    return (fsize_t)st.st_mtime;
+#endif
+}
+
+void hashBlock(const char* data, long length, BlockHash& hash) {
+    hash.crc = crc32Final(crc32Update(CRC32_INIT, data, length));
+    hash.adler = adler32Update(ADLER32_INIT, data, length);
+}
+
+BlockIndex::BlockIndex(const char* destPath, long blockSize)
+    : m_handle(-1), m_blockSize(blockSize), m_cachedBlocks(0) {
+    makeSidecarPath(destPath, INDEX_EXTENSION, INDEX_MARKER, m_path);
+}
+
+BlockIndex::~BlockIndex() {
+    if (m_handle >= 0) {
+        close(m_handle);
+    }
+}
+
+bool BlockIndex::writeHeader(fsize_t destSize, fsize_t destTime) {
+    unsigned char header[HEADER_SIZE];
+    memcpy(header, INDEX_MAGIC, 4);
+    putValue(header + 4, (unsigned long)m_blockSize, 4);
+    putSize(header + 8, destSize);
+    putSize(header + 16, destTime);
+    putValue(header + 24, crc32Final(crc32Update(CRC32_INIT, header, 24)), 4);
+
+    if (lseek(m_handle, 0L, SEEK_SET) != 0) {
+        return false;
+    }
+    return write(m_handle, header, HEADER_SIZE) == HEADER_SIZE;
+}
+
+bool BlockIndex::open(const char* destPath) {
+    m_handle = ::open(m_path, O_RDWR | O_CREAT | O_BINARY, 0666);
+    if (m_handle < 0) {
+        return false;
+    }
+
+    struct stat st;
+    unsigned char header[HEADER_SIZE];
+    m_cachedBlocks = 0;
+    if (stat(destPath, &st) == 0 &&
+        read(m_handle, header, HEADER_SIZE) == HEADER_SIZE &&
+        memcmp(header, INDEX_MAGIC, 4) == 0 &&
+        crc32Final(crc32Update(CRC32_INIT, header, 24)) == getValue(header + 24, 4) &&
+        (long)getValue(header + 4, 4) == m_blockSize &&
+        getSize(header + 8) == (fsize_t)st.st_size &&
+        getSize(header + 16) == fileStamp(st)) {
+        long blocks = (long)(((fsize_t)st.st_size + m_blockSize - 1) / m_blockSize);
+        if (filelength(m_handle) >= HEADER_SIZE + (fsize_t)blocks * ENTRY_SIZE) {
+            m_cachedBlocks = blocks;
+        }
+    }
+
+    // Not valid again until finish()
+    return writeHeader(0, 0);
+}
+
+bool BlockIndex::lookup(long block, BlockHash& hash) {
+    if (block >= m_cachedBlocks) {
+        return false;
+    }
+    unsigned char entry[ENTRY_SIZE];
+    fsize_t position = HEADER_SIZE + (fsize_t)block * ENTRY_SIZE;
+    if (lseek(m_handle, position, SEEK_SET) != position ||
+        read(m_handle, entry, ENTRY_SIZE) != ENTRY_SIZE) {
+        m_cachedBlocks = 0;
+        return false;
+    }
+    hash.crc = getValue(entry, 4);
+    hash.adler = getValue(entry + 4, 4);
+    return true;
+}
+
+bool BlockIndex::store(long block, const BlockHash& hash) {
+    unsigned char entry[ENTRY_SIZE];
+    putValue(entry, hash.crc, 4);
+    putValue(entry + 4, hash.adler, 4);
+    fsize_t position = HEADER_SIZE + (fsize_t)block * ENTRY_SIZE;
+    if (lseek(m_handle, position, SEEK_SET) != position) {
+        return false;
+    }
+    return write(m_handle, entry, ENTRY_SIZE) == ENTRY_SIZE;
+}
+
+bool BlockIndex::finish(const char* destPath, long blockCount) {
+    struct stat st;
+    if (m_handle < 0 || stat(destPath, &st) != 0) {
+        return false;
+    }
+    bool ok = truncateFile(m_handle, HEADER_SIZE + (fsize_t)blockCount * ENTRY_SIZE) == 0 &&
+              writeHeader((fsize_t)st.st_size, fileStamp(st));
+    close(m_handle);
+    m_handle = -1;
+    return ok;
+}
+
+DeltaEngine::DeltaEngine(BlockIndex* index)
+    : m_index(index), m_sourceBuffer(NULL), m_destBuffer(NULL),
+      m_destSize(0), m_offset(0), m_block(0),
+      m_blocksWritten(0), m_bytesWritten(0) {}
+
+DeltaEngine::~DeltaEngine() {
+    delete[] m_sourceBuffer;
+    delete[] m_destBuffer;
+}
+
+bool DeltaEngine::begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+    (void)sourceHandle;
+    (void)fileSize;
+    m_destSize = filelength(destHandle);
+    m_offset = m_block = m_blocksWritten = m_bytesWritten = 0;
+
+    if (m_sourceBuffer == NULL) {
+        m_sourceBuffer = new char[(unsigned)DELTA_BLOCK_SIZE];
+        m_destBuffer = new char[(unsigned)DELTA_BLOCK_SIZE];
+    }
+    return m_sourceBuffer != NULL && m_destBuffer != NULL && m_destSize >= 0;
+}
+
+long DeltaEngine::copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+    (void)maxBytes;
+
+    long length = readFull(sourceHandle, m_sourceBuffer, DELTA_BLOCK_SIZE);
+    if (length < 0) {
+        return -1;
+    }
+    if (length == 0) {
+        // Drop whatever the old destination had past the new end
+        if (m_destSize > m_offset && truncateFile(destHandle, m_offset) != 0) {
+            return -1;
+        }
+        return 0;
+    }
+
+    BlockHash hash;
+    hashBlock(m_sourceBuffer, length, hash);
+
+    // Only a block of the same length can match
+    fsize_t remaining = m_destSize - m_offset;
+    long destLength = (remaining > DELTA_BLOCK_SIZE) ? DELTA_BLOCK_SIZE : (long)remaining;
+
+    bool same = false;
+    if (destLength == length) {
+        BlockHash cached;
+        if (m_index->lookup(m_block, cached)) {
+            same = (cached.crc == hash.crc && cached.adler == hash.adler);
+        } else {
+            // No index to trust - compare against the destination itself
+            if (lseek(destHandle, m_offset, SEEK_SET) != m_offset) {
+                return -1;
+            }
+            long got = readFull(destHandle, m_destBuffer, length);
+            if (got < 0) {
+                return -1;
+            }
+            same = (got == length && memcmp(m_sourceBuffer, m_destBuffer, (unsigned)length) == 0);
+        }
+    }
+
+    if (!same) {
+        if (lseek(destHandle, m_offset, SEEK_SET) != m_offset ||
+            !writeFull(destHandle, m_sourceBuffer, length)) {
+            return -1;
+        }
+        m_blocksWritten++;
+        m_bytesWritten += length;
+    }
+
+    if (m_sink) {
+        m_sink->onData(m_sourceBuffer, length);
+    }
+
+    // A failed index write only costs the cache next time
+    m_index->store(m_block, hash);
+
+    m_offset += length;
+    m_block++;
+    return length;
+}
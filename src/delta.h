@@ -0,0 +1,102 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include "platform.h"
+#include "engine.h"
+
+// Block size for delta copies. Small enough that a local change rewrites
+// little, big enough that the index stays small.
+#ifdef FC_DOS
+const long DELTA_BLOCK_SIZE = 8192L;
+#else
+const long DELTA_BLOCK_SIZE = 65536L;
+#endif
+
+// Fingerprint of one block: CRC-32 and Adler-32 side by side
+struct BlockHash {
+    unsigned long crc;
+    unsigned long adler;
+};
+
+void hashBlock(const char* data, long length, BlockHash& hash);
+
+// Per-block hashes of a destination file, kept in a sidecar (FILE.xx# on
+// DOS, file.IDX elsewhere). The header records the destination's size and
+// time when the index was written; if either has changed since, the
+// cached hashes are ignored and the destination is read instead. The
+// header is cleared while a sync runs so an interrupted one is not
+// trusted.
+class BlockIndex {
+private:
+    char m_path[MAXPATH];
+    int m_handle;
+    long m_blockSize;
+    long m_cachedBlocks;    // Entries that describe the destination as it is
+
+    bool writeHeader(fsize_t destSize, fsize_t destTime);
+
+    // Not copyable
+    BlockIndex(const BlockIndex&);
+    BlockIndex& operator=(const BlockIndex&);
+
+public:
+    BlockIndex(const char* destPath, long blockSize);
+    ~BlockIndex();
+
+    // Open or create the index. Call before the destination is modified.
+    bool open(const char* destPath);
+
+    // Cached hash of a destination block. False if there is none.
+    bool lookup(long block, BlockHash& hash);
+
+    // Hash of the block as it is now
+    bool store(long block, const BlockHash& hash);
+
+    // Stamp the index with the destination's new size and time. Call
+    // after the destination has been closed - DOS sets the time then.
+    bool finish(const char* destPath, long blockCount);
+
+    bool isCached() const { return m_cachedBlocks > 0; }
+    const char* getPath() const { return m_path; }
+};
+
+// Rewrites only the blocks of an existing destination that differ from
+// the source, then truncates it to the source size. Each copyChunk()
+// handles one block and returns the source bytes it covered, so progress
+// and speed show how far the sync has got, not how much was written.
+class DeltaEngine : public CopyEngine {
+private:
+    BlockIndex* m_index;
+    char* m_sourceBuffer;
+    char* m_destBuffer;
+    fsize_t m_destSize;     // Destination size before the sync
+    fsize_t m_offset;
+    long m_block;
+    long m_blocksWritten;
+    fsize_t m_bytesWritten;
+
+    // Not copyable
+    DeltaEngine(const DeltaEngine&);
+    DeltaEngine& operator=(const DeltaEngine&);
+
+public:
+    DeltaEngine(BlockIndex* index);
+    virtual ~DeltaEngine();
+
+    virtual const char* getName() const { return "delta"; }
+    virtual long getChunkSize() const { return DELTA_BLOCK_SIZE; }
+    virtual bool canResizeChunks() const { return false; }
+
+    // The sink sees every source block - written or already in place -
+    // which is exactly what the destination holds afterwards
+    virtual bool passesData() const { return true; }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize);
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes);
+
+    long getBlockCount() const { return m_block; }
+    long getBlocksWritten() const { return m_blocksWritten; }
+    fsize_t getBytesWritten() const { return m_bytesWritten; }
+};
+
+#endif // DELTA_H
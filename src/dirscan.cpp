@@ -0,0 +1,261 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "dirscan.h"
+#include <ctype.h>
+
+#ifdef FC_POSIX
+#include <errno.h>
+#include <stdlib.h>
+#endif
+
+bool joinPath(const char* dirPath, const char* name, char* result) {
+    int length = strlen(dirPath);
+    bool needSep = (length > 0 && dirPath[length - 1] != '\\' && dirPath[length - 1] != '/');
+    if (length + (needSep ? 1 : 0) + strlen(name) >= (unsigned)MAXPATH) {
+        result[0] = '\0';
+        return false;
+    }
+    strcpy(result, dirPath);
+    if (needSep) {
+        strcat(result, PATH_SEP_STR);
+    }
+    strcat(result, name);
+    return true;
+}
+
+#ifdef FC_POSIX
+// Resolve links and dot entries in path, which need not exist yet: the
+// longest part that does goes through realpath() and the rest is kept
+static bool canonicalPath(const char* path, char* result) {
+    char prefix[MAXPATH];
+    if (strlen(path) >= (unsigned)MAXPATH) {
+        return false;
+    }
+    strcpy(prefix, path);
+    const char* tail = "";
+    while (realpath(prefix, result) == NULL) {
+        char* sep = strrchr(prefix, '/');
+        if (sep == NULL) {
+            return false;
+        }
+        tail = path + (sep - prefix);
+        if (sep == prefix) {
+            strcpy(prefix, "/");
+        } else {
+            *sep = '\0';
+        }
+    }
+    // realpath() leaves no trailing slash except on the root itself
+    if (strcmp(result, "/") == 0 && *tail == '/') {
+        tail++;
+    }
+    if (strlen(result) + strlen(tail) >= (unsigned)MAXPATH) {
+        return false;
+    }
+    strcat(result, tail);
+    return true;
+}
+#endif
+
+bool isWithin(const char* path, const char* dir) {
+    char fullPath[MAXPATH];
+    char fullDir[MAXPATH];
+#ifdef FC_POSIX
+    if (!canonicalPath(path, fullPath) || !canonicalPath(dir, fullDir)) {
+        return false;
+    }
+#else
+    strcpy(fullPath, path);
+    strcpy(fullDir, dir);
+#endif
+    int length = strlen(fullDir);
+    while (length > 0 && (fullDir[length - 1] == '\\' || fullDir[length - 1] == '/')) {
+        length--;
+    }
+#ifdef FC_DOS
+    bool samePrefix = strnicmp(fullPath, fullDir, length) == 0;
+#else
+    bool samePrefix = strncmp(fullPath, fullDir, length) == 0;
+#endif
+    char next = fullPath[length];
+    return samePrefix && (next == '\0' || next == '\\' || next == '/');
+}
+
+#ifdef FC_DOS
+// Two base-36 digits for a DOS extension. Changing one character moves
+// the hash by less than 256 times a power of 31, and no power of 31
+// shares a factor with 1296, so such extensions always differ.
+static void hashExtension(const char* extension, char* digits) {
+    static const char DIGITS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    unsigned long hash = 0;
+    for (const char* p = extension; *p; p++) {
+        hash = hash * 31 + (unsigned char)toupper((unsigned char)*p);
+    }
+    hash %= 36UL * 36UL;
+    digits[0] = DIGITS[(int)(hash / 36)];
+    digits[1] = DIGITS[(int)(hash % 36)];
+}
+#endif
+
+void makeSidecarPath(const char* path, const char* extension, char marker, char* result) {
+    strcpy(result, path);
+#ifdef FC_DOS
+    (void)extension;
+    // Replace the extension of the last path component
+    char* lastSlash = strrchr(result, '\\');
+    char* lastFwdSlash = strrchr(result, '/');
+    char* lastSep = (lastFwdSlash > lastSlash) ? lastFwdSlash : lastSlash;
+    char* dot = strrchr(result, '.');
+    if (dot == NULL || dot < lastSep) {
+        dot = result + strlen(result);
+        *dot = '\0';
+    }
+    char digits[2];
+    hashExtension(*dot ? dot + 1 : dot, digits);
+    dot[0] = '.';
+    dot[1] = digits[0];
+    dot[2] = digits[1];
+    dot[3] = marker;
+    dot[4] = '\0';
+#else
+    (void)marker;
+    strcat(result, extension);
+#endif
+}
+
+bool samePath(const char* a, const char* b) {
+#ifdef FC_DOS
+    return stricmp(a, b) == 0;
+#else
+    return strcmp(a, b) == 0;
+#endif
+}
+
+bool makeDirectory(const char* path) {
+#ifdef FC_POSIX
+    if (mkdir(path, 0777) == 0 || errno == EEXIST) {
+        struct stat st;
+        return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+    }
+    return false;
+#else
+    if (mkdir(path) == 0) {
+        return true;
+    }
+    // Already there?
+    struct ffblk fileInfo;
+    return findfirst(path, &fileInfo, FA_DIREC) == 0 && (fileInfo.ff_attrib & FA_DIREC) != 0;
+#endif
+}
+
+DirScanner::DirScanner() : m_open(false) {
+#ifdef FC_DOS
+    m_havePending = false;
+#else
+    m_dir = NULL;
+#endif
+}
+
+bool DirScanner::open(const char* dirPath) {
+    close();
+
+#ifdef FC_DOS
+    char pattern[MAXPATH];
+    if (!joinPath(dirPath, "*.*", pattern)) {
+        return false;
+    }
+    int attrib = FA_DIREC | FA_RDONLY | FA_HIDDEN | FA_SYSTEM | FA_ARCH;
+    m_havePending = (findfirst(pattern, &m_block, attrib) == 0);
+    m_open = true;
+#else
+    m_dir = opendir(dirPath);
+    m_open = (m_dir != NULL);
+#endif
+    return m_open;
+}
+
+bool DirScanner::next(DirEntry& entry) {
+    if (!m_open) {
+        return false;
+    }
+
+#ifdef FC_DOS
+    while (m_havePending) {
+        bool skip = (strcmp(m_block.ff_name, ".") == 0 || strcmp(m_block.ff_name, "..") == 0);
+        if (!skip) {
+            strcpy(entry.name, m_block.ff_name);
+            entry.isDirectory = (m_block.ff_attrib & FA_DIREC) != 0;
+            entry.size = entry.isDirectory ? 0L : m_block.ff_fsize;
+        }
+        m_havePending = (findnext(&m_block) == 0);
+        if (!skip) {
+            return true;
+        }
+    }
+    return false;
+#else
+    struct dirent* item;
+    while ((item = readdir(m_dir)) != NULL) {
+        if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0) {
+            continue;
+        }
+        if (strlen(item->d_name) >= MAXNAME) {
+            continue;
+        }
+
+        // Relative to the open directory, so a name too long to join to
+        // its path still reaches the caller, which reports it
+        int dirHandle = dirfd(m_dir);
+
+        // Follow links to files but not to directories
+        struct stat st;
+        if (fstatat(dirHandle, item->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+        if (S_ISLNK(st.st_mode)) {
+            if (fstatat(dirHandle, item->d_name, &st, 0) != 0 || S_ISDIR(st.st_mode)) {
+                continue;
+            }
+        }
+        if (!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) {
+            continue;   // Devices, sockets, pipes
+        }
+
+        strcpy(entry.name, item->d_name);
+        entry.isDirectory = S_ISDIR(st.st_mode);
+        entry.size = entry.isDirectory ? 0 : (fsize_t)st.st_size;
+        return true;
+    }
+    return false;
+#endif
+}
+
+void DirScanner::close() {
+#ifdef FC_POSIX
+    if (m_dir != NULL) {
+        closedir(m_dir);
+        m_dir = NULL;
+    }
+#else
+    m_havePending = false;
+#endif
+    m_open = false;
+}
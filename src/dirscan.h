@@ -0,0 +1,70 @@
+#ifndef DIRSCAN_H
+#define DIRSCAN_H
+
+#include "platform.h"
+
+#ifdef FC_POSIX
+#include <dirent.h>
+#endif
+
+// Longest single path component
+#ifdef FC_DOS
+#define MAXNAME 13
+#else
+#define MAXNAME 256
+#endif
+
+struct DirEntry {
+    char name[MAXNAME];
+    bool isDirectory;
+    fsize_t size;
+};
+
+// Lists one directory - findfirst/findnext on DOS, opendir/readdir on
+// Linux. "." and ".." are skipped, and so are symbolic links to
+// directories so a tree walk can't loop.
+class DirScanner {
+private:
+    bool m_open;
+#ifdef FC_DOS
+    struct ffblk m_block;
+    bool m_havePending;   // findfirst already filled m_block
+#else
+    DIR* m_dir;
+#endif
+
+    // Not copyable
+    DirScanner(const DirScanner&);
+    DirScanner& operator=(const DirScanner&);
+
+public:
+    DirScanner();
+    ~DirScanner() { close(); }
+
+    bool open(const char* dirPath);
+    bool next(DirEntry& entry);
+    void close();
+};
+
+// Join a directory and a name with the native separator. False, with
+// result left empty, if the whole path would not fit in MAXPATH.
+bool joinPath(const char* dirPath, const char* name, char* result);
+
+// True if path is dir itself or lies anywhere under it. On Linux links
+// and ".." are resolved first; path need not exist yet.
+bool isWithin(const char* path, const char* dir);
+
+// Path of a sidecar file that belongs to path. Elsewhere extension
+// (e.g. ".JRN") is appended. DOS names only have room for one extension,
+// so there it is replaced by two characters hashed from the whole old
+// extension followed by marker (DATA.TXT -> DATA.xx$). Extensions that
+// differ in one character, like DATA.TX1 and DATA.TX2, never clash.
+void makeSidecarPath(const char* path, const char* extension, char marker, char* result);
+
+// True if both name the same file - case-insensitive on DOS
+bool samePath(const char* a, const char* b);
+
+// Create a directory. Returns true if it exists afterwards.
+bool makeDirectory(const char* path);
+
+#endif // DIRSCAN_H
@@ -0,0 +1,622 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "engine.h"
+#include "pipeline.h"
+#include "async.h"
+#include "stripe.h"
+#include "packer.h"
+#include "bufpool.h"
+#include "trace.h"
+
+#ifdef FC_POSIX
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#endif
+
+// Buffer size - 8KB is a good balance for DOS
+const long BUFFER_SIZE = 8192L;
+
+// Chunk size for the kernel-side engines. Nothing passes through user
+// space, so this only sets how often the copy loop gets control back.
+const long KERNEL_CHUNK_SIZE = 1024L * 1024L;
+
+// Source window the mmap engine keeps mapped. Large enough that mapping
+// costs little per byte, small enough for a 32-bit address space.
+const long MMAP_WINDOW_SIZE = 64L * 1024L * 1024L;
+
+// Chunk size for direct I/O. Without the page cache there is no
+// readahead, so each request has to be big enough to keep the device busy.
+const long DIRECT_CHUNK_SIZE = 4L * 1024L * 1024L;
+
+// Small files are cheaper to move with a single read/write pair
+const long AUTO_MIN_KERNEL_SIZE = 65536L;
+
+// Default slot size for the pipelined engine
+const long PIPE_CHUNK_SIZE = 65536L;
+
+// Slot size when the pipeline stands in for a kernel engine so a
+// DataSink can see the data. Big slots keep the per-block syscall and
+// hashing overhead low at SSD speeds.
+const long SINK_CHUNK_SIZE = 1024L * 1024L;
+
+// Each async request moves this much; queue depth times this is memory
+const long ASYNC_CHUNK_SIZE = 1024L * 1024L;
+
+// Bytes per pread()/pwrite() in each stripe; ranges start on multiples
+const long STRIPE_CHUNK_SIZE = 1024L * 1024L;
+
+// Chunk size for an engine: the tuner's whole budget when adaptive,
+// otherwise /chunk:<KB> or the engine's own default
+static long engineChunkSize(const EngineOptions& options, long defaultSize) {
+    if (options.adaptiveChunk) {
+        return options.memoryBudget;
+    }
+    return (options.chunkSize > 0) ? options.chunkSize : defaultSize;
+}
+
+bool CopyEngine::begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+    // Nothing to prepare by default
+    (void)sourceHandle;
+    (void)destHandle;
+    (void)fileSize;
+    return true;
+}
+
+// Write the whole block, retrying short writes. Returns false on error.
+static bool writeAll(int handle, const char* data, long length) {
+    while (length > 0) {
+        int written = write(handle, data, (unsigned)length);
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Classic read()/write() loop through a user-space buffer
+class ReadWriteEngine : public CopyEngine {
+protected:
+    bool m_fallback;   // Set by derived engines once the kernel path is refused
+    long m_chunkSize;
+    char* m_buffer;    // Allocated on first use - kernel engines may never need it
+
+public:
+    ReadWriteEngine(long chunkSize)
+        : m_fallback(false), m_chunkSize(chunkSize), m_buffer(NULL) {}
+    virtual ~ReadWriteEngine() { delete[] m_buffer; }
+
+    virtual const char* getName() const { return "rw"; }
+    virtual const char* getActiveName() const { return m_fallback ? "rw" : getName(); }
+    virtual long getChunkSize() const { return m_chunkSize; }
+    virtual bool passesData() const { return true; }
+
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+        if (m_buffer == NULL) {
+            m_buffer = new char[(unsigned)m_chunkSize];
+            if (m_buffer == NULL) {
+                return -1;
+            }
+        }
+
+        if (maxBytes > m_chunkSize) {
+            maxBytes = m_chunkSize;
+        }
+
+        TRACE_START(readStart);
+        long bytesRead = read(sourceHandle, m_buffer, (unsigned)maxBytes);
+        TRACE_END(TRACE_READ, readStart, bytesRead);
+        if (bytesRead <= 0) {
+            return bytesRead;
+        }
+
+        TRACE_START(writeStart);
+        bool written = writeAll(destHandle, m_buffer, bytesRead);
+        TRACE_END(TRACE_WRITE, writeStart, bytesRead);
+        if (!written) {
+            return -1;
+        }
+        if (m_sink) {
+            m_sink->onData(m_buffer, bytesRead);
+        }
+        return bytesRead;
+    }
+};
+
+#ifdef FC_POSIX
+
+// True if errno means "this kind of copy is not supported here" rather
+// than a real I/O error, so the read/write path should take over
+static bool isUnsupported(int err) {
+    return err == EINVAL || err == ENOSYS || err == EXDEV ||
+           err == EOPNOTSUPP || err == EBADF || err == ESPIPE;
+}
+
+// sendfile() - kernel copies from the page cache straight to the destination
+class SendfileEngine : public ReadWriteEngine {
+public:
+    SendfileEngine(long chunkSize) : ReadWriteEngine(chunkSize) {}
+
+    virtual const char* getName() const { return "sendfile"; }
+    virtual bool passesData() const { return false; }
+
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+        if (!m_fallback) {
+            ssize_t copied = sendfile(destHandle, sourceHandle, NULL, (size_t)maxBytes);
+            if (copied >= 0) {
+                return (long)copied;
+            }
+            if (!isUnsupported(errno)) {
+                return -1;
+            }
+            m_fallback = true;
+        }
+        return ReadWriteEngine::copyChunk(sourceHandle, destHandle, maxBytes);
+    }
+};
+
+// copy_file_range() - may share extents or offload the copy entirely.
+// Falls back to sendfile() across filesystems, then to read/write.
+class CopyRangeEngine : public SendfileEngine {
+private:
+    bool m_rangeFailed;
+
+public:
+    CopyRangeEngine(long chunkSize) : SendfileEngine(chunkSize), m_rangeFailed(false) {}
+
+    virtual const char* getName() const { return "cfr"; }
+    virtual const char* getActiveName() const {
+        if (m_fallback) return "rw";
+        return m_rangeFailed ? "sendfile" : getName();
+    }
+
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+        if (!m_rangeFailed) {
+            ssize_t copied = copy_file_range(sourceHandle, NULL, destHandle, NULL,
+                                             (size_t)maxBytes, 0);
+            if (copied >= 0) {
+                return (long)copied;
+            }
+            if (!isUnsupported(errno)) {
+                return -1;
+            }
+            m_rangeFailed = true;
+        }
+        return SendfileEngine::copyChunk(sourceHandle, destHandle, maxBytes);
+    }
+};
+
+// splice() through a pipe - works for sources sendfile() can't handle
+class SpliceEngine : public ReadWriteEngine {
+private:
+    int m_pipe[2];
+
+    // Push whatever is left in the pipe through a user-space buffer.
+    // Local, so engines on different tree-copy workers don't share it.
+    bool drainPipe(int destHandle, long pending) {
+        char buffer[8192];
+        while (pending > 0) {
+            int got = read(m_pipe[0], buffer, sizeof(buffer));
+            if (got <= 0 || !writeAll(destHandle, buffer, got)) {
+                return false;
+            }
+            pending -= got;
+        }
+        return true;
+    }
+
+public:
+    SpliceEngine(long chunkSize) : ReadWriteEngine(chunkSize) { m_pipe[0] = m_pipe[1] = -1; }
+    virtual ~SpliceEngine() { end(); }
+
+    virtual const char* getName() const { return "splice"; }
+    virtual bool passesData() const { return false; }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+        (void)sourceHandle;
+        (void)destHandle;
+        (void)fileSize;
+        if (pipe(m_pipe) != 0) {
+            m_fallback = true;
+        }
+        return true;
+    }
+
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+        if (!m_fallback) {
+            ssize_t inPipe = splice(sourceHandle, NULL, m_pipe[1], NULL,
+                                    (size_t)maxBytes, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (inPipe < 0) {
+                if (!isUnsupported(errno)) {
+                    return -1;
+                }
+                m_fallback = true;
+                return ReadWriteEngine::copyChunk(sourceHandle, destHandle, maxBytes);
+            }
+
+            long pending = (long)inPipe;
+            while (pending > 0) {
+                ssize_t out = splice(m_pipe[0], NULL, destHandle, NULL,
+                                     (size_t)pending, SPLICE_F_MOVE | SPLICE_F_MORE);
+                if (out < 0) {
+                    if (!isUnsupported(errno)) {
+                        return -1;
+                    }
+                    m_fallback = true;
+                    return drainPipe(destHandle, pending) ? (long)inPipe : -1;
+                }
+                pending -= (long)out;
+            }
+            return (long)inPipe;
+        }
+        return ReadWriteEngine::copyChunk(sourceHandle, destHandle, maxBytes);
+    }
+
+    virtual void end() {
+        if (m_pipe[0] >= 0) close(m_pipe[0]);
+        if (m_pipe[1] >= 0) close(m_pipe[1]);
+        m_pipe[0] = m_pipe[1] = -1;
+    }
+};
+
+// Map the source in large windows and write() straight out of the
+// mapping, so the data is never copied into a user-space buffer. Each
+// window is mapped once with MADV_SEQUENTIAL, so the kernel reads ahead
+// aggressively and drops pages behind; it is unmapped as soon as the
+// copy moves past it. Setting up a mapping costs more than a read(), so
+// this pays off on big files and loses on small ones.
+class MmapEngine : public ReadWriteEngine {
+private:
+    off_t m_offset;
+    off_t m_size;
+    long m_pageSize;
+    int m_sourceHandle;
+    char* m_window;         // Current mapping, NULL if none
+    off_t m_windowStart;    // File offset of m_window, page aligned
+    size_t m_windowLength;
+
+    void unmapWindow() {
+        if (m_window != NULL) {
+            munmap(m_window, m_windowLength);
+            m_window = NULL;
+        }
+    }
+
+    // Map the window holding m_offset. False if the kernel refuses.
+    bool mapWindow() {
+        unmapWindow();
+        m_windowStart = m_offset - (m_offset % m_pageSize);
+        off_t length = m_size - m_windowStart;
+        if (length > (off_t)MMAP_WINDOW_SIZE) {
+            length = (off_t)MMAP_WINDOW_SIZE;
+        }
+        void* map = mmap(NULL, (size_t)length, PROT_READ, MAP_SHARED, m_sourceHandle, m_windowStart);
+        if (map == MAP_FAILED) {
+            return false;
+        }
+        madvise(map, (size_t)length, MADV_SEQUENTIAL);
+        m_window = (char*)map;
+        m_windowLength = (size_t)length;
+        return true;
+    }
+
+public:
+    MmapEngine(long chunkSize)
+        : ReadWriteEngine(chunkSize), m_offset(0), m_size(0), m_pageSize(4096),
+          m_sourceHandle(-1), m_window(NULL), m_windowStart(0), m_windowLength(0) {}
+    virtual ~MmapEngine() { unmapWindow(); }
+
+    virtual const char* getName() const { return "mmap"; }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+        (void)destHandle;
+        unmapWindow();
+        m_sourceHandle = sourceHandle;
+        m_offset = lseek(sourceHandle, 0, SEEK_CUR);
+        m_size = (off_t)fileSize;
+        m_pageSize = sysconf(_SC_PAGESIZE);
+        if (m_offset < 0 || m_pageSize <= 0) {
+            m_fallback = true;
+        }
+        return true;
+    }
+
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+        if (m_fallback) {
+            return ReadWriteEngine::copyChunk(sourceHandle, destHandle, maxBytes);
+        }
+        if (m_offset >= m_size) {
+            return 0;
+        }
+
+        if (m_window == NULL || m_offset >= m_windowStart + (off_t)m_windowLength) {
+            if (!mapWindow()) {
+                m_fallback = true;
+                return ReadWriteEngine::copyChunk(sourceHandle, destHandle, maxBytes);
+            }
+        }
+
+        // Stay inside the window; the next call maps the one after it
+        long length = maxBytes;
+        off_t windowLeft = m_windowStart + (off_t)m_windowLength - m_offset;
+        if ((off_t)length > windowLeft) {
+            length = (long)windowLeft;
+        }
+
+        const char* data = m_window + (m_offset - m_windowStart);
+        if (!writeAll(destHandle, data, length)) {
+            return -1;
+        }
+        if (m_sink) {
+            m_sink->onData(data, length);
+        }
+
+        // Keep the handle's offset in step in case we fall back later
+        m_offset += length;
+        lseek(sourceHandle, m_offset, SEEK_SET);
+        return length;
+    }
+
+    virtual void end() { unmapWindow(); }
+};
+
+// Turn O_DIRECT on or off for an open handle
+static bool setDirect(int handle, bool direct) {
+    int flags = fcntl(handle, F_GETFL);
+    if (flags < 0) {
+        return false;
+    }
+    flags = direct ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+    return fcntl(handle, F_SETFL, flags) == 0;
+}
+
+// O_DIRECT on both ends, through an aligned buffer from the BufferPool,
+// so a large copy does not push everything else out of the page cache.
+// Chunks are whole multiples of DIRECT_ALIGNMENT; the short tail of the
+// file is written with O_DIRECT turned off. Where the filesystem
+// refuses direct I/O, or a resume starts mid-block, the copy goes
+// through the cache instead ("stream"), dropping source pages as soon
+// as they are read and destination pages once written back.
+class DirectEngine : public ReadWriteEngine {
+private:
+    char* m_aligned;
+    int m_sourceHandle;
+    int m_destHandle;
+    fsize_t m_offset;       // Of the next chunk, same in both files
+    fsize_t m_flushed;      // Destination bytes already dropped from the cache
+
+    // Give up on O_DIRECT for the rest of the transfer
+    void useCache() {
+        setDirect(m_sourceHandle, false);
+        setDirect(m_destHandle, false);
+        m_fallback = true;
+    }
+
+    // Streaming hints for the cached path: the source range just copied
+    // is clean and can go at once; destination pages have to be written
+    // back first, so drop the previous chunk's while this one is queued.
+    void dropCopied(fsize_t start, long length) {
+        posix_fadvise(m_sourceHandle, (off_t)start, (off_t)length, POSIX_FADV_DONTNEED);
+#ifdef __linux__
+        sync_file_range(m_destHandle, (off_t)start, (off_t)length, SYNC_FILE_RANGE_WRITE);
+        if (start > m_flushed) {
+            sync_file_range(m_destHandle, (off_t)m_flushed, (off_t)(start - m_flushed),
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                            SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(m_destHandle, (off_t)m_flushed, (off_t)(start - m_flushed),
+                          POSIX_FADV_DONTNEED);
+            m_flushed = start;
+        }
+#endif
+    }
+
+public:
+    DirectEngine(long chunkSize)
+        : ReadWriteEngine((chunkSize + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT),
+          m_aligned(NULL), m_sourceHandle(-1), m_destHandle(-1), m_offset(0), m_flushed(0) {}
+    virtual ~DirectEngine() { BufferPool::release(m_aligned, m_chunkSize); }
+
+    virtual const char* getName() const { return "direct"; }
+    virtual const char* getActiveName() const { return m_fallback ? "stream" : getName(); }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+        (void)fileSize;
+        m_sourceHandle = sourceHandle;
+        m_destHandle = destHandle;
+        m_offset = m_flushed = lseek(sourceHandle, 0, SEEK_CUR);
+        m_fallback = false;
+        if (m_aligned == NULL) {
+            m_aligned = BufferPool::acquire(m_chunkSize);
+        }
+        if (m_offset < 0 || m_offset % DIRECT_ALIGNMENT != 0 ||
+            !setDirect(sourceHandle, true) || !setDirect(destHandle, true)) {
+            useCache();
+        }
+        return m_aligned != NULL;
+    }
+
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+        long length = (maxBytes < m_chunkSize) ? maxBytes : m_chunkSize;
+        length -= length % DIRECT_ALIGNMENT;
+        if (length < DIRECT_ALIGNMENT) {
+            length = DIRECT_ALIGNMENT;
+        }
+
+        long got = read(sourceHandle, m_aligned, (size_t)length);
+        if (got < 0 && !m_fallback && errno == EINVAL) {
+            // The filesystem took the flag but refuses the I/O
+            useCache();
+            got = read(sourceHandle, m_aligned, (size_t)length);
+        }
+        if (got <= 0) {
+            return got;
+        }
+
+        // A partial block can only be the end of the file
+        if (!m_fallback && got % DIRECT_ALIGNMENT != 0) {
+            setDirect(destHandle, false);
+        }
+        if (!writeAll(destHandle, m_aligned, got)) {
+            if (m_fallback || errno != EINVAL) {
+                return -1;
+            }
+            useCache();
+            if (lseek(destHandle, m_offset, SEEK_SET) != m_offset ||
+                !writeAll(destHandle, m_aligned, got)) {
+                return -1;
+            }
+        }
+        if (m_fallback) {
+            dropCopied(m_offset, got);
+        }
+        if (m_sink) {
+            m_sink->onData(m_aligned, got);
+        }
+        m_offset += got;
+        return got;
+    }
+
+    virtual void end() {
+        // Later reads of these handles (journal, read-back) expect the cache
+        if (m_sourceHandle >= 0) {
+            setDirect(m_sourceHandle, false);
+            setDirect(m_destHandle, false);
+        }
+        m_sourceHandle = m_destHandle = -1;
+    }
+};
+
+#endif // FC_POSIX
+
+// Picks the cheapest path for each transfer once the file size is known
+class AutoEngine : public CopyEngine {
+private:
+    CopyEngine* m_small;
+    CopyEngine* m_large;
+    CopyEngine* m_current;
+
+public:
+    AutoEngine(const EngineOptions& options) {
+        m_small = new ReadWriteEngine(engineChunkSize(options, BUFFER_SIZE));
+#ifdef FC_POSIX
+        m_large = new CopyRangeEngine(engineChunkSize(options, KERNEL_CHUNK_SIZE));
+#else
+        m_large = m_small;
+#endif
+        m_current = m_small;
+    }
+
+    virtual ~AutoEngine() {
+        if (m_large != m_small) delete m_large;
+        delete m_small;
+    }
+
+    virtual const char* getName() const { return "auto"; }
+    virtual const char* getActiveName() const { return m_current->getActiveName(); }
+    virtual long getChunkSize() const { return m_current->getChunkSize(); }
+    // Asked before begin() picks one, so both candidates must qualify
+    virtual bool passesData() const { return m_small->passesData() && m_large->passesData(); }
+
+    virtual void setDataSink(DataSink* sink) {
+        m_sink = sink;
+        m_small->setDataSink(sink);
+        m_large->setDataSink(sink);
+    }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+        m_current = (fileSize < AUTO_MIN_KERNEL_SIZE) ? m_small : m_large;
+        return m_current->begin(sourceHandle, destHandle, fileSize);
+    }
+
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+        return m_current->copyChunk(sourceHandle, destHandle, maxBytes);
+    }
+
+    virtual void end() { m_current->end(); }
+};
+
+CopyEngine* createEngine(const char* name, const EngineOptions& options) {
+    if (name == NULL || stricmp(name, "auto") == 0) {
+        return new AutoEngine(options);
+    }
+    if (stricmp(name, "rw") == 0) {
+        return new ReadWriteEngine(engineChunkSize(options, BUFFER_SIZE));
+    }
+    // Fixed block size, so a container reads back on any build
+    if (stricmp(name, "pack") == 0 || stricmp(name, "unpack") == 0) {
+        return new PackEngine(stricmp(name, "unpack") == 0);
+    }
+#ifdef FC_POSIX
+    long kernelChunk = engineChunkSize(options, KERNEL_CHUNK_SIZE);
+    if (stricmp(name, "cfr") == 0) {
+        return new CopyRangeEngine(kernelChunk);
+    }
+    if (stricmp(name, "sendfile") == 0) {
+        return new SendfileEngine(kernelChunk);
+    }
+    if (stricmp(name, "splice") == 0) {
+        return new SpliceEngine(kernelChunk);
+    }
+    if (stricmp(name, "mmap") == 0) {
+        return new MmapEngine(kernelChunk);
+    }
+    if (stricmp(name, "direct") == 0) {
+        return new DirectEngine(engineChunkSize(options, DIRECT_CHUNK_SIZE));
+    }
+#endif
+#ifdef FC_THREADS
+    if (stricmp(name, "pipe") == 0) {
+        // The ring is allocated up front, so it never takes the tuner's budget
+        long slotSize = (options.chunkSize > 0) ? options.chunkSize : PIPE_CHUNK_SIZE;
+        return new PipelineEngine(options.ringDepth, slotSize);
+    }
+    if (stricmp(name, "async") == 0) {
+        long requestSize = (options.chunkSize > 0) ? options.chunkSize : ASYNC_CHUNK_SIZE;
+        return new AsyncEngine(options.queueDepth, requestSize);
+    }
+    if (stricmp(name, "stripe") == 0) {
+        long requestSize = (options.chunkSize > 0) ? options.chunkSize : STRIPE_CHUNK_SIZE;
+        return new StripeEngine(options.stripes, requestSize);
+    }
+#endif
+    return NULL;
+}
+
+CopyEngine* createSinkEngine(const EngineOptions& options) {
+#ifdef FC_THREADS
+    // Reading overlaps with writing and hashing on the caller's thread
+    long slotSize = (options.chunkSize > 0) ? options.chunkSize : SINK_CHUNK_SIZE;
+    return new PipelineEngine(options.ringDepth, slotSize);
+#else
+    return new ReadWriteEngine(engineChunkSize(options, BUFFER_SIZE));
+#endif
+}
+
+void listEngines() {
+#ifdef FC_POSIX
+    cout << "auto, rw, cfr, sendfile, splice, mmap, direct, pipe, async, stripe, pack, unpack";
+#else
+    cout << "auto, rw, pack, unpack";
+#endif
+}
@@ -0,0 +1,125 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "platform.h"
+
+class RateLimiter;
+struct PackInfo;
+
+// Sees every block an engine writes to the destination, in file order.
+// Used for checksums and the resume journal.
+class DataSink {
+public:
+    virtual ~DataSink() {}
+    virtual void onData(const char* data, long length) = 0;
+};
+
+// Hands every block to two sinks, e.g. the resume journal and /v
+class TeeSink : public DataSink {
+private:
+    DataSink* m_first;
+    DataSink* m_second;
+
+public:
+    TeeSink(DataSink* first, DataSink* second) : m_first(first), m_second(second) {}
+    virtual void onData(const char* data, long length) {
+        m_first->onData(data, length);
+        m_second->onData(data, length);
+    }
+};
+
+// A copy engine moves data from the source handle to the destination
+// handle, one chunk per call, starting at the current file offsets.
+// FileCopy::copyFile drives the engine and does progress and logging.
+class CopyEngine {
+protected:
+    DataSink* m_sink;
+
+public:
+    CopyEngine() : m_sink(NULL) {}
+    virtual ~CopyEngine() {}
+
+    // Name as given on the command line (/e:<name>)
+    virtual const char* getName() const = 0;
+
+    // Name of the path actually in use - differs from getName() when the
+    // kernel refused the fast path and the engine fell back to read/write
+    virtual const char* getActiveName() const { return getName(); }
+
+    // Largest number of bytes one copyChunk() call will move
+    virtual long getChunkSize() const = 0;
+
+    // False if copyChunk() ignores maxBytes (fixed-size chunks), which
+    // rules out adaptive chunk sizing
+    virtual bool canResizeChunks() const { return true; }
+
+    // Reads and writes the engine keeps outstanding at once
+    virtual int getQueueDepth() const { return 1; }
+
+    // True if the data passes through user space, so a DataSink will see
+    // it. Kernel-side engines (cfr, sendfile, splice) never see the bytes.
+    virtual bool passesData() const { return false; }
+    virtual void setDataSink(DataSink* sink) { m_sink = sink; }
+
+    // Engines that copy from several threads pace each thread against
+    // the limiter themselves and return true; for the rest FileCopy
+    // sleeps between chunks
+    virtual bool setLimiter(RateLimiter* limiter) { (void)limiter; return false; }
+
+    // Called once per transfer before the first chunk
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize);
+
+    // Copy up to maxBytes. Returns bytes copied, 0 at end of file, -1 on error
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes) = 0;
+
+    // Called once per transfer after the last chunk (also after errors)
+    virtual void end() {}
+
+    // Tell the user what a failed transfer got done before it stopped,
+    // for engines that know more than "it failed" (stripe ranges)
+    virtual void reportFailure() const {}
+
+    // Sizes on both sides of a /pack or /unpack container. False for
+    // engines that write the data as it is. Call after end().
+    virtual bool getPackInfo(PackInfo& info) const { (void)info; return false; }
+};
+
+// Largest chunk on DOS: read() returns a 16-bit int, so stay below 32K
+// on a 512 byte boundary. Linux can afford far bigger buffers.
+#if defined(__MSDOS__) || defined(__BORLANDC__)
+const long MAX_CHUNK_SIZE = 32256L;
+const long DEFAULT_MEMORY_BUDGET = 32256L;
+#else
+const long MAX_CHUNK_SIZE = 64L * 1024L * 1024L;
+const long DEFAULT_MEMORY_BUDGET = 8L * 1024L * 1024L;
+#endif
+
+// Tuning knobs passed from the command line to the engines
+struct EngineOptions {
+    long chunkSize;      // Bytes per chunk, 0 for the engine's default
+    bool adaptiveChunk;  // Let ChunkTuner pick the size (tuner.h)
+    long memoryBudget;   // Largest chunk the tuner may try
+    int ringDepth;       // Slots in the pipeline ring
+    int queueDepth;      // Requests the async engine keeps in flight (/qd)
+    int stripes;         // Ranges the stripe engine copies at once (/stripe)
+
+    EngineOptions()
+        : chunkSize(0), adaptiveChunk(false),
+          memoryBudget(DEFAULT_MEMORY_BUDGET), ringDepth(4), queueDepth(8),
+          stripes(4) {}
+};
+
+// Create an engine by name ("rw", "cfr", "sendfile", "splice", "mmap",
+// "direct", "pipe", "async", "stripe", "pack", "unpack" or "auto").
+// Returns NULL if the name is unknown or not available in this build.
+CopyEngine* createEngine(const char* name, const EngineOptions& options);
+
+// Fastest engine that passes every block through user space, for copies
+// that need a DataSink when the chosen engine bypasses it: "pipe" with
+// large slots where there are threads, "rw" otherwise
+CopyEngine* createSinkEngine(const EngineOptions& options);
+
+// Print the engine names accepted by createEngine() for this build
+void listEngines();
+
+#endif // ENGINE_H
@@ -0,0 +1,138 @@
+#ifndef FCTHREAD_H
+#define FCTHREAD_H
+
+// Thin wrappers over POSIX threads. DOS has no threads, so anything that
+// needs them is compiled only when FC_THREADS is defined.
+
+#include "platform.h"
+
+#ifdef FC_POSIX
+
+#define FC_THREADS 1
+
+#include <pthread.h>
+#include <time.h>
+
+class Mutex {
+private:
+    pthread_mutex_t m_mutex;
+
+    // Not copyable
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+
+public:
+    Mutex() { pthread_mutex_init(&m_mutex, NULL); }
+    ~Mutex() { pthread_mutex_destroy(&m_mutex); }
+
+    void lock() { pthread_mutex_lock(&m_mutex); }
+    void unlock() { pthread_mutex_unlock(&m_mutex); }
+    bool tryLock() { return pthread_mutex_trylock(&m_mutex) == 0; }
+    pthread_mutex_t* getHandle() { return &m_mutex; }
+};
+
+// Locks a mutex for the lifetime of the object
+class ScopedLock {
+private:
+    Mutex& m_mutex;
+
+public:
+    ScopedLock(Mutex& mutex) : m_mutex(mutex) { m_mutex.lock(); }
+    ~ScopedLock() { m_mutex.unlock(); }
+};
+
+class Condition {
+private:
+    pthread_cond_t m_cond;
+
+    // Not copyable
+    Condition(const Condition&);
+    Condition& operator=(const Condition&);
+
+public:
+    Condition() { pthread_cond_init(&m_cond, NULL); }
+    ~Condition() { pthread_cond_destroy(&m_cond); }
+
+    // Caller must hold the mutex
+    void wait(Mutex& mutex) { pthread_cond_wait(&m_cond, mutex.getHandle()); }
+
+    // Wait at most the given time; spurious wakeups are the caller's problem
+    void waitFor(Mutex& mutex, long milliseconds) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_sec += milliseconds / 1000L;
+        until.tv_nsec += (milliseconds % 1000L) * 1000000L;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&m_cond, mutex.getHandle(), &until);
+    }
+    void signal() { pthread_cond_signal(&m_cond); }
+    void broadcast() { pthread_cond_broadcast(&m_cond); }
+};
+
+// A long that one thread can update while another reads it, without a
+// lock. Full barriers - these sit on counters, not in inner loops.
+class AtomicLong {
+private:
+    volatile long m_value;
+
+    // Not copyable
+    AtomicLong(const AtomicLong&);
+    AtomicLong& operator=(const AtomicLong&);
+
+public:
+    AtomicLong() : m_value(0) {}
+
+    long get() const { return __sync_fetch_and_add(const_cast<volatile long*>(&m_value), 0L); }
+    void set(long value) { __sync_lock_test_and_set(&m_value, value); __sync_synchronize(); }
+    long add(long delta) { return __sync_add_and_fetch(&m_value, delta); }
+};
+
+// The same for file sizes, which are wider than a long on 32-bit hosts
+class AtomicSize {
+private:
+    volatile fsize_t m_value;
+
+    // Not copyable
+    AtomicSize(const AtomicSize&);
+    AtomicSize& operator=(const AtomicSize&);
+
+public:
+    AtomicSize() : m_value(0) {}
+
+    fsize_t get() const { return __sync_fetch_and_add(const_cast<volatile fsize_t*>(&m_value), (fsize_t)0); }
+    void set(fsize_t value) { __sync_lock_test_and_set(&m_value, value); __sync_synchronize(); }
+    fsize_t add(fsize_t delta) { return __sync_add_and_fetch(&m_value, delta); }
+};
+
+class Thread {
+private:
+    pthread_t m_thread;
+    bool m_started;
+
+public:
+    typedef void* (*EntryPoint)(void*);
+
+    Thread() : m_started(false) {}
+    ~Thread() { join(); }
+
+    bool start(EntryPoint entry, void* arg) {
+        m_started = (pthread_create(&m_thread, NULL, entry, arg) == 0);
+        return m_started;
+    }
+
+    void join() {
+        if (m_started) {
+            pthread_join(m_thread, NULL);
+            m_started = false;
+        }
+    }
+
+    bool isStarted() const { return m_started; }
+};
+
+#endif // FC_POSIX
+
+#endif // FCTHREAD_H
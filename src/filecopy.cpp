@@ -20,30 +20,56 @@
  * Source: https://github.com/FDOS/xcopy/tree/master/source
  */
 
-#include <iostream.h>
-#include <fstream.h>
-#include <string.h>
+#include "platform.h"
 #include <time.h>
-#include <dos.h>
-#include <dir.h>
-#include <stdio.h>
-#include <io.h>
-#include <fcntl.h>
 #include <signal.h>  // For signal handling
-#include <process.h> // For _exit()
 #include "filecopy.h"
+#include "engine.h"
+#include "tuner.h"
+#include "hrtimer.h"
+#include "rate.h"
+#include "thruput.h"
+#include "limiter.h"
 #include "progress.h"
 #include "logger.h"
+#include "journal.h"
+#include "delta.h"
+#include "verify.h"
+#include "dedup.h"
+#include "dirscan.h"
+#include "trace.h"
+
+// Adaptive chunk sizing range - a sector on DOS, a page on Linux
+#ifdef FC_DOS
+const long MIN_ADAPTIVE_CHUNK = 512L;
+const long START_ADAPTIVE_CHUNK = 8192L;
+#else
+const long MIN_ADAPTIVE_CHUNK = 4096L;
+const long START_ADAPTIVE_CHUNK = 65536L;
+#endif
+
+// State of one transfer. The signal handler reports on the foreground
+// transfer; quiet transfers (tree-copy workers) never register theirs.
+struct TransferState {
+    int sourceHandle;
+    int destHandle;
+    const char* sourcePath;
+    const char* destPath;
+    fsize_t fileSize;
+    fsize_t totalBytesCopied;
+    fsize_t resumedFrom;        // Bytes already in place from an earlier run
+    bool preallocated;          // Destination reserved to full size (/prealloc)
+    CopyJournal* journal;       // Set when running with /resume
+    Stopwatch clock;
+
+    TransferState()
+        : sourceHandle(-1), destHandle(-1), sourcePath(NULL), destPath(NULL),
+          fileSize(0), totalBytesCopied(0), resumedFrom(0), preallocated(false),
+          journal(NULL) {}
+};
 
 // Global variables for signal handling
-static int gSourceHandle = -1;
-static int gDestHandle = -1;
-static const char* gSourcePath = NULL;
-static const char* gDestPath = NULL;
-static long gFileSize = 0;
-static long gTotalBytesCopied = 0;
-static time_t gStartTime = 0;
-static bool gDebugMode = false;
+static TransferState* gActive = NULL;
 
 // Signal handler for CTRL+C
 void interruptHandler(int sig) {
@@ -54,16 +80,28 @@ void interruptHandler(int sig) {
         cout << "\n\nInterrupt signal " << sig << " received. Interrupting copy operation..." << endl;
     }
     
+    // Nothing in the foreground to report on
+    if (gActive == NULL) {
+        Logger::flushFromSignal();
+        _exit(1);
+    }
+    
     // Record current time for timeout calculations
     time_t interruptTime = time(NULL);
     const int MAX_CLOSE_WAIT_SECONDS = 2; // Maximum time to wait for file close
     bool sourceClosedOk = false;
     bool destClosedOk = false;
     
+    // Record what is safely on disk while the destination is still open
+    bool checkpointed = false;
+    if (gActive->journal != NULL && gActive->destHandle >= 0) {
+        checkpointed = gActive->journal->checkpoint();
+    }
+    
     // Attempt to close open file handles with timeout
-    if (gSourceHandle >= 0) {
+    if (gActive->sourceHandle >= 0) {
         cout << "Closing source file..." << endl;
-        int closeResult = close(gSourceHandle);
+        int closeResult = close(gActive->sourceHandle);
         sourceClosedOk = (closeResult == 0);
         if (!sourceClosedOk) {
             cerr << "Warning: Could not close source file cleanly." << endl;
@@ -71,9 +109,13 @@ void interruptHandler(int sig) {
     }
     
     // Try to close destination even if source failed
-    if (gDestHandle >= 0) {
+    if (gActive->destHandle >= 0) {
+        // Don't leave the unwritten part of a reserved file looking copied
+        if (gActive->preallocated) {
+            truncateFile(gActive->destHandle, gActive->totalBytesCopied);
+        }
         cout << "Closing destination file..." << endl;
-        int closeResult = close(gDestHandle);
+        int closeResult = close(gActive->destHandle);
         destClosedOk = (closeResult == 0);
         if (!destClosedOk) {
             cerr << "Warning: Could not close destination file cleanly." << endl;
@@ -88,49 +130,51 @@ void interruptHandler(int sig) {
     
     // If we couldn't close files, mark handles as invalid anyway
     // to prevent double-close attempts later
-    gSourceHandle = -1;
-    gDestHandle = -1;
+    gActive->sourceHandle = -1;
+    gActive->destHandle = -1;
     
     // Calculate elapsed time and speed
-    time_t endTime = time(NULL);
-    long totalDuration = (long)difftime(endTime, gStartTime);
+    double elapsedSeconds = gActive->clock.lap();
     
     // Display stats about the interrupted transfer
-    cout << "Transfer interrupted after copying " << gTotalBytesCopied 
-         << " of " << gFileSize << " bytes (" 
-         << (gTotalBytesCopied * 100 / (gFileSize ? gFileSize : 1)) << "%)" << endl;
+    cout << "Transfer interrupted after copying " << gActive->totalBytesCopied 
+         << " of " << gActive->fileSize << " bytes (" 
+         << percentOf(gActive->totalBytesCopied, gActive->fileSize) << "%)" << endl;
     
     // Calculate speed
     long avgBytesPerSec = 0;
-    if (totalDuration > 0) {
-        avgBytesPerSec = gTotalBytesCopied / totalDuration;
+    if (elapsedSeconds > 0.0) {
+        avgBytesPerSec = (long)((double)(gActive->totalBytesCopied - gActive->resumedFrom) / elapsedSeconds);
     }
     
-    cout << "Time elapsed: " << totalDuration << " seconds" << endl;
+    char durationStr[20];
+    formatDuration((long)(elapsedSeconds * 1000.0), durationStr);
+    cout << "Time elapsed: " << durationStr << " seconds" << endl;
     
     // Format speed with proper units
     char speedStr[20];
-    if (avgBytesPerSec <= 0) {
-        strcpy(speedStr, "0.00 KB/s");
-    } else if (avgBytesPerSec >= 2048 * 1024) {
-        double mbPerSec = (double)avgBytesPerSec / (1024.0 * 1024.0);
-        sprintf(speedStr, "%.2f MB/s", mbPerSec);
-    } else {
-        double kbPerSec = (double)avgBytesPerSec / 1024.0;
-        sprintf(speedStr, "%.2f KB/s", kbPerSec);
-    }
+    formatSpeed(avgBytesPerSec, speedStr);
     
     cout << "Average speed: " << speedStr << endl;
     
+    // Structured logs get a record with the rest of the batch instead
+    if (Logger::getFormat() != LOG_TEXT && gActive->sourcePath && gActive->destPath) {
+        Logger logger;
+        logger.logInterrupted(gActive->sourcePath, gActive->destPath, gActive->fileSize,
+                              gActive->totalBytesCopied, avgBytesPerSec,
+                              (long)(elapsedSeconds * 1000.0),
+                              checkpointed ? gActive->journal->getOffset() : (fsize_t)-1);
+    }
+    
     // Write a quick log file to record the interrupted transfer
     try {
-        if (gSourcePath && gDestPath) {
+        if (Logger::getFormat() == LOG_TEXT && gActive->sourcePath && gActive->destPath) {
             // Extract the destination directory
-            char destDir[256];
-            char interruptedLogPath[256];
+            char destDir[MAXPATH];
+            char interruptedLogPath[MAXPATH];
             
             // Get the directory from the destination path
-            strcpy(destDir, gDestPath);
+            strcpy(destDir, gActive->destPath);
             char* lastSlash = strrchr(destDir, '\\');
             char* lastFwdSlash = strrchr(destDir, '/');
             char* lastSep = (lastFwdSlash > lastSlash) ? lastFwdSlash : lastSlash;
@@ -156,30 +200,25 @@ void interruptHandler(int sig) {
                 
                 logFile << "INTERRUPTED TRANSFER LOG" << endl;
                 logFile << "Date and Time: " << timeBuffer << endl;
-                logFile << "Source: " << gSourcePath << endl;
-                logFile << "Destination: " << gDestPath << endl;
-                logFile << "Total file size: " << gFileSize << " bytes" << endl;
-                logFile << "Bytes copied: " << gTotalBytesCopied << " bytes" << endl;
-                logFile << "Completion: " << (gTotalBytesCopied * 100 / (gFileSize ? gFileSize : 1)) << "%" << endl;
+                logFile << "Source: " << gActive->sourcePath << endl;
+                logFile << "Destination: " << gActive->destPath << endl;
+                logFile << "Total file size: " << gActive->fileSize << " bytes" << endl;
+                logFile << "Bytes copied: " << gActive->totalBytesCopied << " bytes" << endl;
+                logFile << "Completion: " << percentOf(gActive->totalBytesCopied, gActive->fileSize) << "%" << endl;
                 
                 // Format speed with proper units
                 char speedStr[20];
-                if (avgBytesPerSec <= 0) {
-                    strcpy(speedStr, "0.00 KB/s");
-                } else if (avgBytesPerSec >= 2048 * 1024) {
-                    double mbPerSec = (double)avgBytesPerSec / (1024.0 * 1024.0);
-                    sprintf(speedStr, "%.2f MB/s", mbPerSec);
-                } else {
-                    double kbPerSec = (double)avgBytesPerSec / 1024.0;
-                    sprintf(speedStr, "%.2f KB/s", kbPerSec);
-                }
+                formatSpeed(avgBytesPerSec, speedStr);
                 
                 logFile << "Avg: " << speedStr << endl;
-                logFile << "Time: " << totalDuration << " seconds" << endl;
+                logFile << "Time: " << durationStr << " seconds" << endl;
                 logFile << "Status: INTERRUPTED BY USER (CTRL+C)" << endl;
                 if (!sourceClosedOk || !destClosedOk) {
                     logFile << "Note: One or more files could not be closed cleanly" << endl;
                 }
+                if (checkpointed) {
+                    logFile << "Resumable: " << gActive->journal->getOffset() << " bytes journalled" << endl;
+                }
                 logFile << "----------------------------------------" << endl;
                 
                 logFile.close();
@@ -191,159 +230,395 @@ void interruptHandler(int sig) {
         cerr << "Error writing interrupt log file." << endl;
     }
     
+    if (checkpointed) {
+        cout << "Run again with /resume to continue from byte "
+             << gActive->journal->getOffset() << "." << endl;
+    }
+    
     cout << "Copy operation terminated by user." << endl;
+    Logger::flushFromSignal();
     
     // Use _exit(int) from process.h instead of exit(int) from stdlib.h
     // or terminate the program by returning from main
     _exit(1);  // Exit the program immediately
 }
 
-// Simple stack tracking for debugging
-int stackDepth = 0;
-char stackTrace[10][80]; // Store up to 10 function calls
-
-void enterFunction(const char* funcName, bool debugMode) {
-    if (stackDepth < 10) {
-        sprintf(stackTrace[stackDepth], "-> %s", funcName);
-        stackDepth++;
-    }
-    
+// Debug print function
+void debugPrint(const char* message, bool debugMode) {
     if (debugMode) {
-        cout << "[DEBUG] Entering: " << funcName << endl;
-        cout << "[DEBUG] Stack depth: " << stackDepth << endl;
+        cout << "[DEBUG] " << message << endl;
     }
 }
 
-void exitFunction(const char* funcName, bool debugMode) {
-    if (stackDepth > 0) {
-        stackDepth--;
-    }
-    
-    if (debugMode) {
-        cout << "[DEBUG] Exiting: " << funcName << endl;
+// Normalize a file path to ensure it's valid for DOS
+void normalizePath(char* path) {
+    // Convert either kind of slash to the native separator
+    for (int i = 0; path[i] != '\0'; i++) {
+        if (path[i] == '/' || path[i] == '\\') {
+            path[i] = PATH_SEP;
+        }
     }
 }
 
-void printStack() {
-    cout << "Stack trace:" << endl;
-    for (int i = 0; i < stackDepth; i++) {
-        cout << stackTrace[i] << endl;
+// Stop reporting on a transfer that is about to go out of scope
+static void releaseForeground(TransferState* state) {
+    if (gActive == state) {
+        signal(SIGINT, SIG_DFL);
+        gActive = NULL;
     }
 }
 
-// Debug print function
-void debugPrint(const char* message, bool debugMode) {
-    if (debugMode) {
-        cout << "[DEBUG] " << message << endl;
+bool FileCopy::copyDuplicate(const char* sourcePath, const char* destPath,
+                             const char* originalPath, const char* normalizedDest, fsize_t size) {
+    bool linked = false;
+    if (!m_dedup->placeDuplicate(originalPath, normalizedDest, size, linked)) {
+        cerr << "Error placing duplicate: " << normalizedDest << endl;
+        return false;
     }
-}
-
-// Normalize a file path to ensure it's valid for DOS
-void normalizePath(char* path, bool debugMode) {
-    enterFunction("normalizePath", debugMode);
+    m_duplicate = true;
     
-    // Convert forward slashes to backslashes
-    for (int i = 0; path[i] != '\0'; i++) {
-        if (path[i] == '/') {
-            path[i] = '\\';
-        }
+    if (!m_quiet) {
+        cout << "Duplicate of " << originalPath
+             << (linked ? " - hardlinked, " : " - listed in DEDUP.LST, ")
+             << size << " bytes not copied" << endl;
     }
-    
-    exitFunction("normalizePath", debugMode);
+    Logger logger;
+    logger.logDuplicate(sourcePath, destPath, originalPath, size, linked);
+    return true;
 }
 
 // This implementation is based on FreeDOS xcopy's direct file copy mechanism
-void FileCopy::copyFile(const char* sourcePath, const char* destPath) {
+bool FileCopy::copyFile(const char* sourcePath, const char* destPath,
+                        const FileInfo* sourceInfo) {
+    TransferState state;
+    state.sourcePath = sourcePath;
+    state.destPath = destPath;
+    m_duplicate = false;
+    
     // Set up signal handler for CTRL+C
-    gSourcePath = sourcePath;
-    gDestPath = destPath;
-    gDebugMode = m_debugMode;
-    signal(SIGINT, interruptHandler);
+    if (!m_quiet) {
+        gActive = &state;
+        signal(SIGINT, interruptHandler);
+    }
     
-    // Use static buffers to reduce stack usage
-    static char normalizedSource[256];
-    static char normalizedDest[256];
+    // Per call rather than static so worker threads don't share them
+    char normalizedSource[MAXPATH];
+    char normalizedDest[MAXPATH];
     
     // Make copies so we can safely modify them
     strcpy(normalizedSource, sourcePath);
     strcpy(normalizedDest, destPath);
     
     // Convert slashes for DOS compatibility
-    normalizePath(normalizedSource, m_debugMode);
-    normalizePath(normalizedDest, m_debugMode);
-    
-    // Open source file using low-level file I/O
-    gSourceHandle = open(normalizedSource, O_RDONLY | O_BINARY);
-    if (gSourceHandle < 0) {
+    normalizePath(normalizedSource);
+    normalizePath(normalizedDest);
+    
+    // Open source file using low-level file I/O, unless the caller has
+    // already opened it (setSourceHandle)
+    state.sourceHandle = m_openSource;
+    m_openSource = -1;
+    if (state.sourceHandle < 0) {
+        TRACE_START(openStart);
+        state.sourceHandle = open(normalizedSource, O_RDONLY | O_BINARY);
+        TRACE_END(TRACE_OPEN, openStart, state.sourceHandle);
+    }
+    if (state.sourceHandle < 0) {
         cerr << "Error opening source file: " << normalizedSource << endl;
-        return;
+        releaseForeground(&state);
+        return false;
+    }
+    
+    // Get file size using filelength() which is more reliable in DOS -
+    // unless the caller has it already
+    if (sourceInfo != NULL && sourceInfo->isFile()) {
+        state.fileSize = sourceInfo->size;
+    } else {
+        state.fileSize = filelength(state.sourceHandle);
+    }
+    
+    // /dedup hashes every source up front and claims its content in the
+    // index before copying, so workers that meet the same file at once
+    // wait for the first copy instead of all writing it. A match is
+    // compared byte for byte before anything is linked to it.
+    ContentKey contentKey;
+    bool dedupClaimed = false;
+    if (m_dedup != NULL && !m_delta && state.fileSize > 0) {
+        ContentHash contentHash;
+        if (!hashFile(state.sourceHandle, contentHash)) {
+            cerr << "Error reading source file: " << normalizedSource << endl;
+            close(state.sourceHandle);
+            state.sourceHandle = -1;
+            releaseForeground(&state);
+            return false;
+        }
+        contentHash.getKey(contentKey);
+        
+        char original[MAXPATH];
+        if (m_dedup->claim(contentKey, normalizedDest, original)) {
+            if (sameContent(state.sourceHandle, original)) {
+                close(state.sourceHandle);
+                state.sourceHandle = -1;
+                releaseForeground(&state);
+                return copyDuplicate(sourcePath, destPath, original, normalizedDest, state.fileSize);
+            }
+            // Same hashes, different bytes - copy it after all
+            m_dedup->reserve(contentKey, normalizedDest);
+        }
+        dedupClaimed = true;
     }
     
-    // Get file size using filelength() which is more reliable in DOS
-    gFileSize = filelength(gSourceHandle);
+    // A delta copy needs an existing destination to compare against
+    BlockIndex* index = NULL;
+    if (m_delta && access(normalizedDest, 0) == 0) {
+        index = new BlockIndex(normalizedDest, DELTA_BLOCK_SIZE);
+        if (samePath(index->getPath(), normalizedDest)) {
+            // Only on DOS, where the index takes the place of the extension
+            cerr << "Error: Destination is its own block index: " << normalizedDest << endl;
+            delete index;
+            close(state.sourceHandle);
+            state.sourceHandle = -1;
+            releaseForeground(&state);
+            return false;
+        }
+        if (!index->open(normalizedDest)) {
+            cerr << "Warning: Could not write block index " << index->getPath() << endl;
+        } else if (m_debugMode) {
+            cout << "[DEBUG] Block index: " << index->getPath()
+                 << (index->isCached() ? " (cached)" : " (rebuilding)") << endl;
+        }
+    }
+    
+    // Pick up where an interrupted copy left off, if its journal checks
+    // out. A delta copy simply compares again, so it needs no journal.
+    CopyJournal* journal = NULL;
+    fsize_t resumeOffset = 0;
+    if (m_resume && index == NULL) {
+        journal = new CopyJournal(normalizedDest);
+        if (samePath(journal->getPath(), normalizedDest)) {
+            cerr << "Error: Destination is its own resume journal: " << normalizedDest << endl;
+            if (dedupClaimed) m_dedup->abandon(contentKey, normalizedDest);
+            delete journal;
+            close(state.sourceHandle);
+            state.sourceHandle = -1;
+            releaseForeground(&state);
+            return false;
+        }
+        if (CopyJournal::exists(normalizedDest)) {
+            resumeOffset = journal->validate(state.sourceHandle, state.fileSize,
+                                             normalizedDest, m_debugMode);
+        }
+    }
+    
+    // A destination hardlinked by an earlier /dedup run shares its data
+    // with other files - replace it rather than write through it
+    if (m_dedup != NULL && index == NULL && resumeOffset == 0) {
+        unlink(normalizedDest);
+    }
     
     // Open destination file - use 0666 for permission (rw-rw-rw-)
-    gDestHandle = open(normalizedDest, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
-    if (gDestHandle < 0) {
+    int destFlags = O_WRONLY | O_CREAT | O_BINARY;
+    if (index != NULL) {
+        destFlags = O_RDWR | O_BINARY;
+    } else if (resumeOffset == 0) {
+        destFlags |= O_TRUNC;
+    }
+    TRACE_START(openStart);
+    state.destHandle = open(normalizedDest, destFlags, 0666);
+    TRACE_END(TRACE_OPEN, openStart, state.destHandle);
+    if (state.destHandle < 0) {
         cerr << "Error opening destination file: " << normalizedDest << endl;
-        close(gSourceHandle);
-        gSourceHandle = -1;
-        return;
+        if (dedupClaimed) m_dedup->abandon(contentKey, normalizedDest);
+        delete journal;
+        delete index;
+        close(state.sourceHandle);
+        state.sourceHandle = -1;
+        releaseForeground(&state);
+        return false;
     }
     
-    // Buffer size - 8KB is a good balance for DOS
-    const int BUFFER_SIZE = 8192;
-    static char buffer[BUFFER_SIZE]; // Static to avoid stack issues
+    if (resumeOffset > 0) {
+        // Drop anything written after the last checkpoint
+        if (lseek(state.sourceHandle, resumeOffset, SEEK_SET) != resumeOffset ||
+            lseek(state.destHandle, resumeOffset, SEEK_SET) != resumeOffset ||
+            truncateFile(state.destHandle, resumeOffset) != 0) {
+            cerr << "Error seeking to resume offset " << resumeOffset << endl;
+            if (dedupClaimed) m_dedup->abandon(contentKey, normalizedDest);
+            delete journal;
+            close(state.sourceHandle);
+            close(state.destHandle);
+            state.sourceHandle = state.destHandle = -1;
+            releaseForeground(&state);
+            return false;
+        }
+        if (!m_quiet) {
+            cout << "Resuming at byte " << resumeOffset << " of " << state.fileSize << endl;
+        }
+    }
     
-    gStartTime = time(NULL);
-    gTotalBytesCopied = 0;
+    // Reserve the whole file so it is allocated in one go instead of
+    // growing chunk by chunk. A delta copy rewrites in place and sizes
+    // the file itself.
+    if (m_preallocate && index == NULL && state.fileSize > resumeOffset) {
+        if (preallocateFile(state.destHandle, state.fileSize) == 0) {
+            state.preallocated = true;
+            if (m_debugMode) {
+                cout << "[DEBUG] Preallocated " << state.fileSize << " bytes" << endl;
+            }
+        } else if (m_debugMode) {
+            cout << "[DEBUG] Preallocation not supported here - copying without it" << endl;
+        }
+    }
+    
+    if (journal != NULL && !journal->start(state.sourceHandle, state.destHandle, state.fileSize, resumeOffset)) {
+        delete journal;
+        journal = NULL;
+    }
+    
+    bool error = false;
+    
+    // /v hashes every block while it is still in the copy buffer
+    Digest* digest = NULL;
+    if (m_verify) {
+        digest = new Digest(m_digestType);
+        if (resumeOffset > 0 && !digestPrefix(state.sourceHandle, resumeOffset, *digest)) {
+            cerr << "Error reading source for checksum" << endl;
+            error = true;
+        }
+    }
+    
+    // The journal and /v checksum data as it is written, so they need an
+    // engine that moves the data through our buffers
+    const char* engineName = m_engineName;
+    CopyEngine* engine = NULL;
+    DeltaEngine* deltaEngine = NULL;
+    if (index != NULL) {
+        engineName = "delta";
+        engine = deltaEngine = new DeltaEngine(index);
+    } else {
+        engine = createEngine(engineName, m_engineOptions);
+    }
+    if ((journal != NULL || digest != NULL) && engine != NULL && !engine->passesData()) {
+        delete engine;
+        engine = createSinkEngine(m_engineOptions);
+        engineName = engine->getName();
+        if (m_debugMode) {
+            cout << "[DEBUG] Engine bypasses the checksum - using " << engineName << endl;
+        }
+    }
+    TeeSink bothSinks(journal, digest);
+    if (engine != NULL && journal != NULL && digest != NULL) {
+        engine->setDataSink(&bothSinks);
+    } else if (engine != NULL && journal != NULL) {
+        engine->setDataSink(journal);
+    } else if (engine != NULL && digest != NULL) {
+        engine->setDataSink(digest);
+    }
+    if (error || engine == NULL || !engine->begin(state.sourceHandle, state.destHandle, state.fileSize)) {
+        if (!error) {
+            cerr << "Copy engine not available: " << engineName << endl;
+        }
+        if (dedupClaimed) m_dedup->abandon(contentKey, normalizedDest);
+        delete engine;
+        delete journal;
+        delete digest;
+        delete index;
+        close(state.sourceHandle);
+        close(state.destHandle);
+        state.sourceHandle = state.destHandle = -1;
+        releaseForeground(&state);
+        return false;
+    }
+    
+    if (m_debugMode) {
+        cout << "[DEBUG] Copy engine: " << engine->getActiveName() << endl;
+    }
+    
+    state.clock.reset();
+    state.totalBytesCopied = resumeOffset;
+    state.resumedFrom = resumeOffset;
+    state.journal = journal;
+    
+    // Speed tracking variables - "current" speed is the rate over the
+    // last RATE_WINDOW seconds, not the average since the start
+    const double RATE_WINDOW = 2.0;
+    RateEstimator rateEstimator(RATE_WINDOW);
+    rateEstimator.addSample(0.0, resumeOffset);
+    
+    // Every chunk goes into the throughput distribution for the log
+    const double THROUGHPUT_INTERVAL = 0.5;
+    ThroughputRecorder throughput(THROUGHPUT_INTERVAL);
+    throughput.start(0.0, resumeOffset);
     
-    // Speed tracking variables
     long maxBytesPerSec = 0;
     long minBytesPerSec = 0;  // Initialize to 0 instead of max long
     bool speedInitialized = false;
     int speedCount = 0;
     
-    time_t lastUpdateTime = gStartTime;
+    double lastUpdateTime = 0.0;
     
     // Removed "Starting copy operation..." message
-    cout << "Press CTRL+C to interrupt the transfer at any time." << endl;
-    
-    // Initial progress display
     Progress progress;
-    progress.showProgressBar(0, gFileSize, 0);
+    if (!m_quiet) {
+        cout << "Press CTRL+C to interrupt the transfer at any time." << endl;
+        
+        // Initial progress display
+        progress.showProgressBar(state.totalBytesCopied, state.fileSize, 0);
+    }
     
-    int bytesRead;
-    long loopCount = 0;
-    bool error = false;
+    long bytesRead;
     
     // Increase update frequency - update every 0.2 seconds
     const double UPDATE_INTERVAL = 0.2;
     
+    // Draw from a timer thread where there is one, so a slow console
+    // never holds up the copy
+    if (!m_quiet) {
+        progress.start((long)(UPDATE_INTERVAL * 1000.0));
+    }
+    
+    // Adaptive mode lets the tuner pick each chunk size within the budget
+    ChunkTuner* tuner = NULL;
+    // Nothing to tune when a limit sets the pace.
+    if (m_engineOptions.adaptiveChunk && engine->canResizeChunks() && !m_limiter) {
+        tuner = new ChunkTuner(MIN_ADAPTIVE_CHUNK, engine->getChunkSize(), START_ADAPTIVE_CHUNK);
+    }
+    long chunkSize = engine->getChunkSize();
+    
+    // Threaded engines take the limit into each thread
+    bool enginePaces = m_limiter && engine->setLimiter(m_limiter);
+    
+    // Under a limit, keep chunks within the burst so the sleeps stay
+    // short and progress keeps moving
+    if (m_limiter && chunkSize > m_limiter->getBurst()) {
+        chunkSize = m_limiter->getBurst();
+    }
+    
     // Copy in chunks
-    while ((bytesRead = read(gSourceHandle, buffer, BUFFER_SIZE)) > 0) {
-        loopCount++;
-        
-        // Write the chunk to destination
-        int bytesWritten = write(gDestHandle, buffer, bytesRead);
-        if (bytesWritten != bytesRead) {
-            cerr << "Error writing to destination file" << endl;
-            error = true;
+    for (;;) {
+        TRACE_START(chunkStart);
+        bytesRead = engine->copyChunk(state.sourceHandle, state.destHandle,
+                                      tuner ? tuner->getChunkSize() : chunkSize);
+        TRACE_END(TRACE_CHUNK, chunkStart, bytesRead);
+        if (bytesRead <= 0) {
             break;
         }
+        state.totalBytesCopied += bytesRead;
         
-        gTotalBytesCopied += bytesRead;
+        if (m_limiter && !enginePaces) {
+            m_limiter->consume(bytesRead);
+        }
+        
+        if (tuner) {
+            tuner->record(bytesRead);
+        }
         
         // Update progress display more frequently (every 0.2 seconds)
-        time_t currentTime = time(NULL);
-        if (difftime(currentTime, lastUpdateTime) >= UPDATE_INTERVAL) {
-            long elapsedSecs = (long)difftime(currentTime, gStartTime);
-            
-            // Calculate speed (bytes per second)
-            long currentBytesPerSec = 0;
-            if (elapsedSecs > 0) {
-                currentBytesPerSec = gTotalBytesCopied / elapsedSecs;
-            }
+        double currentTime = state.clock.lap();
+        throughput.record(currentTime, state.totalBytesCopied);
+        if (currentTime - lastUpdateTime >= UPDATE_INTERVAL) {
+            // Calculate speed (bytes per second) over the recent window
+            rateEstimator.addSample(currentTime, state.totalBytesCopied);
+            long currentBytesPerSec = rateEstimator.getRate();
             
             // Update min/max speed - integer only
             if (currentBytesPerSec > 0) {
@@ -362,61 +637,239 @@ void FileCopy::copyFile(const char* sourcePath, const char* destPath) {
             }
             
             // Update progress display
-            progress.showProgressBar(gTotalBytesCopied, gFileSize, currentBytesPerSec);
+            if (!m_quiet) progress.update(state.totalBytesCopied, state.fileSize, currentBytesPerSec);
             
             lastUpdateTime = currentTime;
         }
         
-        // Let DOS breathe occasionally
-        if (loopCount % 20 == 0) {
-            delay(1);
+        if (journal) {
+            journal->checkpointIfDue(currentTime);
         }
     }
     
+    // The last chunk rarely lands on an update - show where it ended
+    if (!m_quiet && bytesRead == 0) {
+        progress.update(state.totalBytesCopied, state.fileSize, rateEstimator.getRate());
+    }
+    progress.stop();
+    
+    if (bytesRead < 0) {
+        cerr << "Error copying to destination file" << endl;
+        error = true;
+        // e.g. which ranges of a striped copy made it
+        engine->reportFailure();
+    }
+    throughput.finish(state.clock.lap(), state.totalBytesCopied);
+    
+    // Nothing more to report on - the handles are about to close
+    state.journal = NULL;
+    
+    // Remember which path was really used before releasing the engine
+    char engineUsed[16];
+    strcpy(engineUsed, engine->getActiveName());
+    int queueDepth = engine->getQueueDepth();
+    long blockCount = 0;
+    long blocksWritten = 0;
+    fsize_t bytesWritten = -1;
+    if (deltaEngine) {
+        blockCount = deltaEngine->getBlockCount();
+        blocksWritten = deltaEngine->getBlocksWritten();
+        bytesWritten = deltaEngine->getBytesWritten();
+    }
+    engine->end();
+    PackInfo packInfo;
+    bool packed = engine->getPackInfo(packInfo);
+    delete engine;
+    
+    if (tuner) {
+        chunkSize = tuner->getBestChunkSize();
+        if (m_debugMode) {
+            cout << "[DEBUG] Adaptive chunk size: " << chunkSize
+                 << (tuner->isSettled() ? " bytes (settled)" : " bytes (still tuning)") << endl;
+        }
+        delete tuner;
+    }
+    
+    // A copy that ended short (error, or the source shrank) must not
+    // keep the reserved tail
+    if (state.preallocated && state.totalBytesCopied < state.fileSize &&
+        truncateFile(state.destHandle, state.totalBytesCopied) != 0) {
+        cerr << "Error trimming destination file" << endl;
+        error = true;
+    }
+    
+    // Read-back has to come from the device, not dirty pages in the cache
+    if (digest && m_readBack && !error) {
+        commitFile(state.destHandle);
+    }
+    
+    if (journal) {
+        if (error || journal->getOffset() != state.fileSize) {
+            // Keep what made it to disk for the next /resume
+            journal->checkpoint();
+        } else {
+            journal->remove();
+        }
+        delete journal;
+    }
+    
     // Close both files
-    close(gSourceHandle);
-    close(gDestHandle);
-    gSourceHandle = gDestHandle = -1;
+    TRACE_START(closeStart);
+    close(state.sourceHandle);
+    close(state.destHandle);
+    TRACE_END(TRACE_CLOSE, closeStart, 0);
+    state.sourceHandle = state.destHandle = -1;
+    
+    // Stamp the index only once the destination is closed and final
+    if (index) {
+        if (!error) {
+            index->finish(normalizedDest, blockCount);
+        }
+        delete index;
+    }
     
     if (error) {
-        return;
+        if (dedupClaimed) m_dedup->abandon(contentKey, normalizedDest);
+        delete digest;
+        releaseForeground(&state);
+        return false;
     }
     
-    time_t endTime = time(NULL);
-    long totalDuration = (long)difftime(endTime, gStartTime);
+    double totalSeconds = state.clock.lap();
+    long totalDuration = state.clock.getMillis();
     
     long avgBytesPerSec = 0;
-    if (totalDuration > 0) {
-        avgBytesPerSec = gTotalBytesCopied / totalDuration;
-    } else {
-        // For very fast transfers (less than 1 second), calculate based on file size
-        avgBytesPerSec = gFileSize;  // Assume file size = bytes per second for fast transfers
+    if (totalSeconds > 0.0) {
+        avgBytesPerSec = (long)((double)(state.totalBytesCopied - state.resumedFrom) / totalSeconds);
     }
     
-    cout << "\nCopy complete: " << gFileSize << " bytes in " 
-         << (totalDuration > 0 ? totalDuration : 1) << " seconds" << endl;
-         
-    // Format speed with proper units
-    char speedStr[20];
-    if (avgBytesPerSec <= 0) {
-        strcpy(speedStr, "0.00 KB/s");
-    } else if (avgBytesPerSec >= 2048 * 1024) {
-        double mbPerSec = (double)avgBytesPerSec / (1024.0 * 1024.0);
-        sprintf(speedStr, "%.2f MB/s", mbPerSec);
-    } else {
-        double kbPerSec = (double)avgBytesPerSec / 1024.0;
-        sprintf(speedStr, "%.2f KB/s", kbPerSec);
+    // Finished before the first progress update - the average is the only
+    // measurement there is
+    if (!speedInitialized) {
+        maxBytesPerSec = minBytesPerSec = avgBytesPerSec;
     }
     
-    cout << "Average speed: " << speedStr << endl;
+    if (!m_quiet) {
+        char durationStr[32];
+        formatDuration(totalDuration, durationStr);
+        cout << "\nCopy complete: " << state.fileSize << " bytes in " 
+             << durationStr << " seconds" << endl;
+             
+        // Format speed with proper units
+        char speedStr[20];
+        formatSpeed(avgBytesPerSec, speedStr);
+        
+        cout << "Average speed: " << speedStr << endl;
+        
+        if (bytesWritten >= 0) {
+            cout << "Delta: " << blocksWritten << " of " << blockCount
+                 << " blocks rewritten (" << bytesWritten << " bytes)" << endl;
+        }
+        
+        // Direct I/O quietly falls back where it is refused - say which ran
+        if (stricmp(engineName, "direct") == 0) {
+            cout << "Direct I/O: " << (strcmp(engineUsed, "direct") == 0 ? "yes" :
+                    "no - refused here, copied through the cache with streaming hints") << endl;
+        }
+        if (stricmp(engineName, "async") == 0) {
+            cout << "Async I/O: " << (strcmp(engineUsed, "async") == 0 ? "io_uring" :
+                    "pread/pwrite threads (io_uring unavailable)")
+                 << ", queue depth " << queueDepth << endl;
+        }
+        
+    }
+    
+    // Logical speed counts the data as it is outside the container
+    if (packed) {
+        packInfo.logicalRate = 0;
+        if (totalSeconds > 0.0) {
+            packInfo.logicalRate = (long)((double)packInfo.rawBytes / totalSeconds);
+        }
+        if (!m_quiet) {
+            char logicalStr[20];
+            formatSpeed(packInfo.logicalRate, logicalStr);
+            long percent = (packInfo.rawBytes > 0) ?
+                (long)((double)packInfo.packedBytes * 100.0 / (double)packInfo.rawBytes + 0.5) : 100;
+            cout << "Packed: " << packInfo.rawBytes << " -> " << packInfo.packedBytes
+                 << " bytes (" << percent << "% of original), logical speed " << logicalStr << endl;
+        }
+    }
     
-    if (gTotalBytesCopied == gFileSize) {
+    ThroughputInfo throughputInfo;
+    throughput.getInfo(throughputInfo);
+    if (!m_quiet && throughputInfo.stalls > 0) {
+        char stallStr[32];
+        formatDuration(throughputInfo.longestStall, stallStr);
+        cout << "Stalls: " << throughputInfo.stalls << " (longest " << stallStr
+             << " seconds)" << endl;
+    }
+    if (m_debugMode && throughputInfo.intervals > 0) {
+        char p5Str[20];
+        char p50Str[20];
+        char p95Str[20];
+        formatSpeed(throughputInfo.p5, p5Str);
+        formatSpeed(throughputInfo.p50, p50Str);
+        formatSpeed(throughputInfo.p95, p95Str);
+        cout << "[DEBUG] Throughput p5/p50/p95: " << p5Str << " / " << p50Str
+             << " / " << p95Str << " over " << throughputInfo.intervals << " intervals" << endl;
+    }
+    
+    // Checksum results, and the optional second pass over the destination
+    bool verified = true;
+    VerifyInfo verifyInfo;
+    if (digest) {
+        verifyInfo.algorithm = digest->getName();
+        digest->format(verifyInfo.digest);
+        verifyInfo.readBack[0] = '\0';
+        verifyInfo.hashRate = digest->getHashRate();
+        
+        if (!m_quiet) {
+            char hashRateStr[20];
+            formatSpeed(verifyInfo.hashRate, hashRateStr);
+            cout << "Checksum (" << verifyInfo.algorithm << "): " << verifyInfo.digest
+                 << " - hashed at " << hashRateStr << endl;
+        }
+        
+        if (m_readBack && state.totalBytesCopied == state.fileSize) {
+            Digest check(digest->getType());
+            if (!digestFile(normalizedDest, check, true)) {
+                cerr << "Error reading back destination file: " << normalizedDest << endl;
+                strcpy(verifyInfo.readBack, "unreadable");
+                verified = false;
+            } else {
+                check.format(verifyInfo.readBack);
+                verified = check.matches(*digest);
+            }
+            if (!verified) {
+                cerr << "Verification FAILED: " << normalizedDest << endl;
+            } else if (!m_quiet) {
+                cout << "Read-back: " << verifyInfo.readBack << " - OK" << endl;
+            }
+        }
+    }
+    
+    if (state.totalBytesCopied == state.fileSize) {
         Logger logger;
-        logger.logTransferDetails(sourcePath, destPath, gFileSize, 
+        logger.logTransferDetails(sourcePath, destPath, state.fileSize, 
                                 maxBytesPerSec, minBytesPerSec, 
-                                avgBytesPerSec, totalDuration);
+                                avgBytesPerSec, totalDuration, engineUsed,
+                                chunkSize, m_engineOptions.adaptiveChunk,
+                                queueDepth, bytesWritten, digest ? &verifyInfo : NULL,
+                                &throughputInfo, packed ? &packInfo : NULL);
+    }
+    delete digest;
+    
+    // Later sources with the same content can link to this copy; the
+    // ones waiting for it are let go either way
+    if (dedupClaimed) {
+        if (state.totalBytesCopied == state.fileSize && verified) {
+            m_dedup->add(contentKey, normalizedDest);
+        } else {
+            m_dedup->abandon(contentKey, normalizedDest);
+        }
     }
     
     // Reset signal handler to default
-    signal(SIGINT, SIG_DFL);
+    releaseForeground(&state);
+    return state.totalBytesCopied == state.fileSize && verified;
 }
\ No newline at end of file
@@ -1,19 +1,90 @@
 #ifndef FILECOPY_H
 #define FILECOPY_H
 
+#include "engine.h"
+#include "verify.h"
+#include "fileinfo.h"
+
+class RateLimiter;
+class DedupIndex;
+
 class FileCopy {
 private:
     bool m_debugMode;
+    bool m_quiet;               // No console output, progress or CTRL+C handler
+    bool m_resume;              // Journal the copy and continue an interrupted one
+    bool m_delta;               // Rewrite only the blocks that changed
+    bool m_verify;              // Checksum the data while copying (/v)
+    bool m_readBack;            // ...and compare against a second read of the destination
+    bool m_preallocate;         // Reserve the whole destination before copying
+    DigestType m_digestType;
+    const char* m_engineName;   // Copy engine to use (see engine.h)
+    EngineOptions m_engineOptions;
+    RateLimiter* m_limiter;     // Bandwidth cap (/limit), may be shared; not owned
+    int m_openSource;           // Handed over by setSourceHandle(), -1 if none
+    DedupIndex* m_dedup;        // Content index (/dedup), may be shared; not owned
+    bool m_duplicate;           // The last copyFile() linked or listed a duplicate
+    
+    // Hardlink or list a /dedup duplicate in place of copying it
+    bool copyDuplicate(const char* sourcePath, const char* destPath,
+                       const char* originalPath, const char* normalizedDest, fsize_t size);
     
 public:
-    void copyFile(const char* sourcePath, const char* destPath);
+    // Returns true if the whole file was copied. sourceInfo, if the
+    // caller already looked the source up, saves asking again for its size.
+    bool copyFile(const char* sourcePath, const char* destPath,
+                  const FileInfo* sourceInfo = NULL);
     
     // Set debug mode
     void setDebugMode(bool mode) { m_debugMode = mode; }
     bool getDebugMode() const { return m_debugMode; }
     
+    // Quiet mode is for background copies (tree-copy workers)
+    void setQuiet(bool quiet) { m_quiet = quiet; }
+    bool getQuiet() const { return m_quiet; }
+    
+    // Select the copy engine by name ("auto" picks one per transfer)
+    void setEngineName(const char* name) { m_engineName = name; }
+    const char* getEngineName() const { return m_engineName; }
+    void setEngineOptions(const EngineOptions& options) { m_engineOptions = options; }
+    
+    // Resumable transfers (see journal.h)
+    void setResume(bool resume) { m_resume = resume; }
+    bool getResume() const { return m_resume; }
+    
+    // Delta copies onto an existing destination (see delta.h)
+    void setDelta(bool delta) { m_delta = delta; }
+    bool getDelta() const { return m_delta; }
+    
+    // Inline checksum, optionally confirmed by reading the destination back
+    void setVerify(bool verify) { m_verify = verify; }
+    void setReadBack(bool readBack) { m_readBack = readBack; }
+    void setDigestType(DigestType type) { m_digestType = type; }
+    
+    // Reserve the destination's full size up front (/prealloc)
+    void setPreallocate(bool preallocate) { m_preallocate = preallocate; }
+    bool getPreallocate() const { return m_preallocate; }
+    
+    // Bandwidth limit, NULL for full speed (see limiter.h)
+    void setLimiter(RateLimiter* limiter) { m_limiter = limiter; }
+    
+    // Source already opened (read-only, binary) by the caller, e.g. while
+    // the previous file of a batch was copying. The next copyFile() uses
+    // it instead of opening sourcePath, and closes it.
+    void setSourceHandle(int handle) { m_openSource = handle; }
+    
+    // Write each distinct content once (see dedup.h), NULL to copy everything
+    void setDedup(DedupIndex* dedup) { m_dedup = dedup; }
+    DedupIndex* getDedup() const { return m_dedup; }
+    bool wasDuplicate() const { return m_duplicate; }
+    
     // Constructor
-    FileCopy() : m_debugMode(false) {}
+    FileCopy()
+        : m_debugMode(false), m_quiet(false), m_resume(false), m_delta(false),
+          m_verify(false), m_readBack(false), m_preallocate(false),
+          m_digestType(DEFAULT_DIGEST),
+          m_engineName("auto"), m_limiter(NULL), m_openSource(-1), m_dedup(NULL),
+          m_duplicate(false) {}
 };
 
 #endif // FILECOPY_H
\ No newline at end of file
@@ -0,0 +1,200 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "fileinfo.h"
+#include "dirscan.h"
+#include <ctype.h>
+
+#ifdef FC_DOS
+const int INFO_CACHE_SLOTS = 64;
+#else
+const int INFO_CACHE_SLOTS = 1024;
+#endif
+
+bool statFile(const char* path, FileInfo& info) {
+    info = FileInfo();
+#ifdef FC_DOS
+    // findfirst() can't see a drive's root directory
+    int length = strlen(path);
+    if ((length == 2 && path[1] == ':') ||
+        (length == 3 && path[1] == ':' && (path[2] == '\\' || path[2] == '/'))) {
+        info.kind = KIND_DIRECTORY;
+        info.attrib = FA_DIREC;
+        return true;
+    }
+
+    struct ffblk block;
+    int attrib = FA_DIREC | FA_RDONLY | FA_HIDDEN | FA_SYSTEM | FA_ARCH;
+    if (findfirst(path, &block, attrib) != 0) {
+        return false;
+    }
+    infoFromFind(block, info);
+#else
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+    info.attrib = (unsigned)st.st_mode;
+    info.mtime = (long)st.st_mtime;
+    if (S_ISREG(st.st_mode)) {
+        info.kind = KIND_FILE;
+        info.size = (fsize_t)st.st_size;
+    } else if (S_ISDIR(st.st_mode)) {
+        info.kind = KIND_DIRECTORY;
+    } else {
+        info.kind = KIND_OTHER;
+    }
+#endif
+    return true;
+}
+
+#ifdef FC_DOS
+
+void infoFromFind(const struct ffblk& block, FileInfo& info) {
+    info.attrib = block.ff_attrib;
+    info.mtime = ((long)block.ff_fdate << 16) | (unsigned)block.ff_ftime;
+    if (block.ff_attrib & FA_DIREC) {
+        info.kind = KIND_DIRECTORY;
+        info.size = 0;
+    } else {
+        info.kind = KIND_FILE;
+        info.size = block.ff_fsize;
+    }
+}
+
+#endif // FC_DOS
+
+// DOS names are case-insensitive, so the cache is too (see samePath)
+static unsigned long hashPath(const char* path) {
+    unsigned long hash = 5381;
+    for (const char* p = path; *p != '\0'; p++) {
+#ifdef FC_DOS
+        hash = hash * 33 + (unsigned char)toupper(*p);
+#else
+        hash = hash * 33 + (unsigned char)*p;
+#endif
+    }
+    return hash;
+}
+
+// Directory part of path, without the trailing separator. False if
+// there is none.
+static bool parentOf(const char* path, char* parent) {
+    const char* cut = NULL;
+    for (const char* p = path; *p != '\0'; p++) {
+        if (*p == '\\' || *p == '/') {
+            cut = p;
+        }
+    }
+    if (cut == NULL || cut == path || cut[1] == '\0') {
+        return false;
+    }
+    int length = (int)(cut - path);
+    memcpy(parent, path, length);
+    parent[length] = '\0';
+    return true;
+}
+
+FileInfoCache::FileInfoCache()
+    : m_slotCount(INFO_CACHE_SLOTS), m_lookups(0), m_calls(0) {
+    m_slots = new Slot[m_slotCount];
+    for (int i = 0; i < m_slotCount; i++) {
+        m_slots[i].path = NULL;
+        m_slots[i].emptyDir = false;
+    }
+}
+
+FileInfoCache::~FileInfoCache() {
+    for (int i = 0; i < m_slotCount; i++) {
+        delete[] m_slots[i].path;
+    }
+    delete[] m_slots;
+}
+
+FileInfoCache::Slot& FileInfoCache::slotFor(const char* path) {
+    return m_slots[hashPath(path) % (unsigned long)m_slotCount];
+}
+
+bool FileInfoCache::isEmptyDir(const char* path) {
+    Slot& slot = slotFor(path);
+    return slot.emptyDir && samePath(slot.path, path);
+}
+
+void FileInfoCache::fill(Slot& slot, const char* path, const FileInfo& info, bool emptyDir) {
+    if (slot.path == NULL || !samePath(slot.path, path)) {
+        // The entry going out may be all that says it exists, so its
+        // directory can't be trusted to be empty any more
+        char parent[MAXPATH];
+        if (slot.path != NULL && parentOf(slot.path, parent) && isEmptyDir(parent)) {
+            slotFor(parent).emptyDir = false;
+        }
+        delete[] slot.path;
+        slot.path = new char[strlen(path) + 1];
+        strcpy(slot.path, path);
+    }
+    slot.info = info;
+    slot.emptyDir = emptyDir;
+}
+
+bool FileInfoCache::lookup(const char* path, FileInfo& info) {
+    {
+#ifdef FC_THREADS
+        ScopedLock lock(m_lock);
+#endif
+        m_lookups++;
+        Slot& slot = slotFor(path);
+        if (slot.path != NULL && samePath(slot.path, path)) {
+            info = slot.info;
+            return info.exists();
+        }
+
+        char parent[MAXPATH];
+        if (parentOf(path, parent) && isEmptyDir(parent)) {
+            info = FileInfo();
+            return false;
+        }
+        m_calls++;
+    }
+
+    // Not under the lock - this is the slow part
+    statFile(path, info);
+
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    fill(slotFor(path), path, info, false);
+    return info.exists();
+}
+
+void FileInfoCache::store(const char* path, const FileInfo& info) {
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    fill(slotFor(path), path, info, false);
+}
+
+void FileInfoCache::storeEmptyDirectory(const char* path) {
+    FileInfo info;
+    info.kind = KIND_DIRECTORY;
+#ifdef FC_THREADS
+    ScopedLock lock(m_lock);
+#endif
+    fill(slotFor(path), path, info, true);
+}
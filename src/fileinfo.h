@@ -0,0 +1,86 @@
+#ifndef FILEINFO_H
+#define FILEINFO_H
+
+#include "platform.h"
+#include "fcthread.h"
+
+enum FileKind {
+    KIND_MISSING,
+    KIND_FILE,
+    KIND_DIRECTORY,
+    KIND_OTHER          // Device, pipe, socket
+};
+
+// What one findfirst() or stat() says about a path. Gathered once and
+// handed on, so a copy doesn't open the same file three times just to
+// learn it exists and how big it is - on a floppy or a network drive
+// each of those is a round trip.
+struct FileInfo {
+    FileKind kind;
+    fsize_t size;       // 0 unless kind is KIND_FILE
+    long mtime;         // Packed DOS date and time; seconds since 1970 on Linux
+    unsigned attrib;    // DOS attribute byte; st_mode on Linux
+
+    FileInfo() : kind(KIND_MISSING), size(0), mtime(0), attrib(0) {}
+
+    bool exists() const { return kind != KIND_MISSING; }
+    bool isFile() const { return kind == KIND_FILE; }
+    bool isDirectory() const { return kind == KIND_DIRECTORY; }
+};
+
+// Look a path up with a single call. Returns info.exists().
+bool statFile(const char* path, FileInfo& info);
+
+#ifdef FC_DOS
+// The same from a findfirst()/findnext() result
+void infoFromFind(const struct ffblk& block, FileInfo& info);
+#endif
+
+// Remembers FileInfo records for batch and tree copies, where the same
+// directory is asked about over and over. Direct-mapped: each path has
+// one slot and a newcomer replaces whatever was there, so memory stays
+// fixed however many files go by. Safe to share between threads.
+class FileInfoCache {
+private:
+    struct Slot {
+        char* path;         // NULL if empty
+        FileInfo info;
+        bool emptyDir;      // Nothing inside exists but what is cached
+    };
+
+    Slot* m_slots;
+    int m_slotCount;
+    long m_lookups;
+    long m_calls;           // Lookups that had to ask the file system
+#ifdef FC_THREADS
+    Mutex m_lock;
+#endif
+
+    Slot& slotFor(const char* path);
+    void fill(Slot& slot, const char* path, const FileInfo& info, bool emptyDir);
+    bool isEmptyDir(const char* path);
+
+    // Not copyable
+    FileInfoCache(const FileInfoCache&);
+    FileInfoCache& operator=(const FileInfoCache&);
+
+public:
+    FileInfoCache();
+    ~FileInfoCache();
+
+    // Info for path, from the cache if possible. Returns info.exists().
+    bool lookup(const char* path, FileInfo& info);
+
+    // Record what the caller knows, e.g. a file it has just written
+    void store(const char* path, const FileInfo& info);
+
+    // path is a directory the caller has just created, so lookups of
+    // anything directly inside it need no call. Files the caller then
+    // creates in it must be stored.
+    void storeEmptyDirectory(const char* path);
+
+    long getLookups() const { return m_lookups; }
+    long getCalls() const { return m_calls; }
+};
+
+#endif // FILEINFO_H
@@ -0,0 +1,113 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "histo.h"
+
+LogHistogram::LogHistogram() {
+    reset();
+}
+
+void LogHistogram::reset() {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        m_counts[i] = 0;
+    }
+    m_total = 0;
+    m_minimum = 0;
+    m_maximum = 0;
+    m_sum = 0.0;
+}
+
+// Values below SUB_COUNT get a bucket each; above that, the top
+// SUB_BITS bits after the leading one pick the bucket within the octave
+int LogHistogram::bucketOf(unsigned long value) {
+    if (value < (unsigned long)SUB_COUNT) {
+        return (int)value;
+    }
+    int exponent = 0;
+    for (unsigned long v = value; v > 1; v >>= 1) {
+        exponent++;
+    }
+    // Wider than 32 bits - clamp into the last bucket
+    if (exponent > 31) {
+        return BUCKET_COUNT - 1;
+    }
+    int sub = (int)((value >> (exponent - SUB_BITS)) & (SUB_COUNT - 1));
+    return SUB_COUNT * (exponent - SUB_BITS + 1) + sub;
+}
+
+unsigned long LogHistogram::bucketLow(int bucket) {
+    if (bucket < SUB_COUNT) {
+        return (unsigned long)bucket;
+    }
+    int exponent = bucket / SUB_COUNT + SUB_BITS - 1;
+    int sub = bucket % SUB_COUNT;
+    return (unsigned long)(SUB_COUNT + sub) << (exponent - SUB_BITS);
+}
+
+void LogHistogram::record(unsigned long value) {
+    m_counts[bucketOf(value)]++;
+    if (m_total == 0 || value < m_minimum) {
+        m_minimum = value;
+    }
+    if (value > m_maximum) {
+        m_maximum = value;
+    }
+    m_total++;
+    m_sum += (double)value;
+}
+
+void LogHistogram::merge(const LogHistogram& other) {
+    if (other.m_total == 0) {
+        return;
+    }
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        m_counts[i] += other.m_counts[i];
+    }
+    if (m_total == 0 || other.m_minimum < m_minimum) {
+        m_minimum = other.m_minimum;
+    }
+    if (other.m_maximum > m_maximum) {
+        m_maximum = other.m_maximum;
+    }
+    m_total += other.m_total;
+    m_sum += other.m_sum;
+}
+
+unsigned long LogHistogram::percentile(double percent) const {
+    if (m_total == 0) {
+        return 0;
+    }
+
+    // Rank of the sample we want, counting from 1
+    double wanted = (double)m_total * percent / 100.0;
+    unsigned long rank = (unsigned long)wanted;
+    if ((double)rank < wanted || rank == 0) {
+        rank++;
+    }
+
+    unsigned long seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += m_counts[i];
+        if (seen >= rank) {
+            unsigned long top = (i + 1 < BUCKET_COUNT) ? bucketLow(i + 1) - 1 : m_maximum;
+            return (top < m_maximum) ? top : m_maximum;
+        }
+    }
+    return m_maximum;
+}
@@ -0,0 +1,44 @@
+#ifndef HISTO_H
+#define HISTO_H
+
+// Histogram over log-spaced buckets: each power of two is split into
+// eight buckets, so any value is placed within 12.5% of its true size
+// while the whole unsigned long range fits in 240 counters. Used for
+// per-operation latencies in microseconds and per-interval throughput.
+class LogHistogram {
+private:
+    enum {
+        SUB_BITS = 3,
+        SUB_COUNT = 1 << SUB_BITS,
+        BUCKET_COUNT = SUB_COUNT * (32 - SUB_BITS + 1)
+    };
+
+    unsigned long m_counts[BUCKET_COUNT];
+    unsigned long m_total;
+    unsigned long m_minimum;
+    unsigned long m_maximum;
+    double m_sum;
+
+    static int bucketOf(unsigned long value);
+    static unsigned long bucketLow(int bucket);
+
+public:
+    LogHistogram();
+
+    void reset();
+    void record(unsigned long value);
+
+    // Add another histogram's samples to this one
+    void merge(const LogHistogram& other);
+
+    unsigned long getCount() const { return m_total; }
+    unsigned long getMinimum() const { return m_total ? m_minimum : 0; }
+    unsigned long getMaximum() const { return m_maximum; }
+    double getMean() const { return m_total ? m_sum / (double)m_total : 0.0; }
+
+    // Value at or below which the given percent of samples fall (e.g.
+    // 99.9). Reports the top of the bucket, so it never understates.
+    unsigned long percentile(double percent) const;
+};
+
+#endif // HISTO_H
@@ -0,0 +1,66 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "hrtimer.h"
+
+#ifdef FC_POSIX
+#include <time.h>
+#else
+#include <bios.h>
+#endif
+
+#ifdef FC_DOS
+// The BIOS tick counter resets to zero at midnight after this many ticks
+const unsigned long TICKS_PER_DAY = 1573040UL;
+
+// One BIOS tick is 65536 / 1193182 seconds
+const unsigned long MICROS_PER_TICK = 54925UL;
+#endif
+
+unsigned long hrNowMicros() {
+#ifdef FC_POSIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000UL + (unsigned long)(ts.tv_nsec / 1000L);
+#else
+    // Keep counting across midnight instead of jumping back to zero
+    static unsigned long lastTicks = 0;
+    static unsigned long dayOffset = 0;
+
+    unsigned long ticks = (unsigned long)biostime(0, 0L);
+    if (ticks < lastTicks) {
+        dayOffset += TICKS_PER_DAY;
+    }
+    lastTicks = ticks;
+    return (ticks + dayOffset) * MICROS_PER_TICK;
+#endif
+}
+
+void Stopwatch::reset() {
+    m_last = hrNowMicros();
+    m_seconds = 0.0;
+}
+
+double Stopwatch::lap() {
+    unsigned long now = hrNowMicros();
+    m_seconds += (double)hrElapsedMicros(m_last, now) / 1000000.0;
+    m_last = now;
+    return m_seconds;
+}
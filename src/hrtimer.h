@@ -0,0 +1,37 @@
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+// Monotonic high-resolution clock. Readings are microseconds from an
+// arbitrary origin and wrap with the width of unsigned long (every ~71
+// minutes on DOS), so only differences between nearby readings mean
+// anything. Use Stopwatch for durations that may run longer than that.
+//
+// Resolution is 1 us on Linux (CLOCK_MONOTONIC) and one BIOS tick
+// (~55 ms) on DOS.
+unsigned long hrNowMicros();
+
+// Microseconds between two readings, correct across a wrap
+inline unsigned long hrElapsedMicros(unsigned long start, unsigned long end) {
+    return end - start;
+}
+
+// Accumulates elapsed time lap by lap, so the total never wraps as long
+// as lap() is called more often than the clock wraps
+class Stopwatch {
+private:
+    unsigned long m_last;
+    double m_seconds;
+
+public:
+    Stopwatch() { reset(); }
+
+    void reset();
+
+    // Fold in the time since the previous lap and return the total seconds
+    double lap();
+
+    double getSeconds() const { return m_seconds; }
+    long getMillis() const { return (long)(m_seconds * 1000.0); }
+};
+
+#endif // HRTIMER_H
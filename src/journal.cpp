@@ -0,0 +1,231 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "journal.h"
+#include "checksum.h"
+#include "byteio.h"
+#include "dirscan.h"
+#include "trace.h"
+#include <sys/stat.h>
+
+// Seconds between checkpoints
+const double CHECKPOINT_INTERVAL = 2.0;
+
+// Sidecar name: DISK.IMG.JRN, or DISK.0Z$ on DOS
+const char JOURNAL_EXTENSION[] = ".JRN";
+const char JOURNAL_MARKER = '$';
+
+// Record layout, little-endian so DOS and Linux can read each other's:
+//   0  "FCJ1"
+//   4  source size       (8 bytes)
+//  12  source time       (8 bytes)
+//  20  committed offset  (8 bytes)
+//  28  CRC-32 of committed data
+//  32  CRC-32 of bytes 0-31
+const int RECORD_SIZE = 36;
+const char RECORD_MAGIC[] = "FCJ1";
+
+// Buffer for re-reading the destination prefix
+const unsigned VALIDATE_BUFFER_SIZE = 8192;
+
+// Modification time of an open file, 0 if unknown
+static long getSourceTime(int handle) {
+    struct stat st;
+    if (fstat(handle, &st) != 0) {
+        return 0;
+    }
+    return (long)st.st_mtime;
+}
+
+CopyJournal::CopyJournal(const char* destPath)
+    : m_handle(-1), m_destHandle(-1), m_fileSize(0), m_sourceTime(0),
+      m_offset(0), m_crc(CRC32_INIT), m_lastCheckpoint(0.0) {
+    makeSidecarPath(destPath, JOURNAL_EXTENSION, JOURNAL_MARKER, m_path);
+}
+
+CopyJournal::~CopyJournal() {
+    if (m_handle >= 0) {
+        close(m_handle);
+    }
+}
+
+bool CopyJournal::exists(const char* destPath) {
+    char path[MAXPATH];
+    makeSidecarPath(destPath, JOURNAL_EXTENSION, JOURNAL_MARKER, path);
+    return access(path, 0) == 0;
+}
+
+bool CopyJournal::readRecord(fsize_t& fileSize, long& sourceTime, fsize_t& offset, unsigned long& crc) {
+    int handle = open(m_path, O_RDONLY | O_BINARY);
+    if (handle < 0) {
+        return false;
+    }
+
+    unsigned char record[RECORD_SIZE];
+    int got = read(handle, record, RECORD_SIZE);
+    close(handle);
+
+    if (got != RECORD_SIZE || memcmp(record, RECORD_MAGIC, 4) != 0) {
+        return false;
+    }
+    // A torn write leaves a record that fails its own check
+    if (crc32Final(crc32Update(CRC32_INIT, record, 32)) != getValue(record + 32, 4)) {
+        return false;
+    }
+
+    fileSize = getSize(record + 4);
+    sourceTime = (long)getSize(record + 12);
+    offset = getSize(record + 20);
+    crc = getValue(record + 28, 4);
+    return true;
+}
+
+bool CopyJournal::writeRecord() {
+    unsigned char record[RECORD_SIZE];
+    memcpy(record, RECORD_MAGIC, 4);
+    putSize(record + 4, m_fileSize);
+    putSize(record + 12, m_sourceTime);
+    putSize(record + 20, m_offset);
+    putValue(record + 28, m_crc, 4);
+    putValue(record + 32, crc32Final(crc32Update(CRC32_INIT, record, 32)), 4);
+
+    if (lseek(m_handle, 0L, SEEK_SET) != 0) {
+        return false;
+    }
+    if (write(m_handle, record, RECORD_SIZE) != RECORD_SIZE) {
+        return false;
+    }
+    return commitFile(m_handle) == 0;
+}
+
+fsize_t CopyJournal::validate(int sourceHandle, fsize_t fileSize, const char* destPath, bool debugMode) {
+    fsize_t journalSize, offset;
+    long journalTime;
+    unsigned long journalCrc;
+
+    if (!readRecord(journalSize, journalTime, offset, journalCrc)) {
+        return 0;
+    }
+
+    if (journalSize != fileSize || journalTime != getSourceTime(sourceHandle)) {
+        cout << "Source changed since the interrupted copy - starting over." << endl;
+        return 0;
+    }
+    if (offset <= 0 || offset > fileSize) {
+        return 0;
+    }
+
+    // The journal is only trusted once the destination prefix checks out
+    int destHandle = open(destPath, O_RDONLY | O_BINARY);
+    if (destHandle < 0) {
+        return 0;
+    }
+    if (filelength(destHandle) < offset) {
+        close(destHandle);
+        cout << "Destination is shorter than the journal says - starting over." << endl;
+        return 0;
+    }
+
+    // Tree workers validate at the same time, so each gets its own buffer
+    char* buffer = new char[VALIDATE_BUFFER_SIZE];
+    if (buffer == NULL) {
+        close(destHandle);
+        return 0;
+    }
+
+    cout << "Checking " << offset << " bytes already copied..." << endl;
+
+    unsigned long crc = CRC32_INIT;
+    fsize_t remaining = offset;
+    while (remaining > 0) {
+        unsigned want = (remaining > (fsize_t)VALIDATE_BUFFER_SIZE) ? VALIDATE_BUFFER_SIZE : (unsigned)remaining;
+        int got = read(destHandle, buffer, want);
+        if (got <= 0) {
+            break;
+        }
+        crc = crc32Update(crc, buffer, got);
+        remaining -= got;
+    }
+    close(destHandle);
+    delete[] buffer;
+
+    if (remaining != 0 || crc != journalCrc) {
+        cout << "Destination does not match the journal - starting over." << endl;
+        return 0;
+    }
+
+    if (debugMode) {
+        char crcStr[12];
+        sprintf(crcStr, "%08lX", crc32Final(crc));
+        cout << "[DEBUG] Journal OK: offset " << offset << ", CRC " << crcStr << endl;
+    }
+
+    m_crc = journalCrc;
+    return offset;
+}
+
+bool CopyJournal::start(int sourceHandle, int destHandle, fsize_t fileSize, fsize_t offset) {
+    m_destHandle = destHandle;
+    m_fileSize = fileSize;
+    m_sourceTime = getSourceTime(sourceHandle);
+    m_offset = offset;
+    if (offset == 0) {
+        m_crc = CRC32_INIT;
+    }
+    m_lastCheckpoint = 0.0;
+
+    m_handle = open(m_path, O_RDWR | O_CREAT | O_BINARY, 0666);
+    if (m_handle < 0) {
+        cerr << "Error creating journal: " << m_path << endl;
+        return false;
+    }
+    return writeRecord();
+}
+
+void CopyJournal::onData(const char* data, long length) {
+    m_crc = crc32Update(m_crc, data, length);
+    m_offset += length;
+}
+
+bool CopyJournal::checkpoint() {
+    if (m_handle < 0) {
+        return false;
+    }
+    // Data first - the record must never claim bytes that aren't on disk
+    TRACE_START(syncStart);
+    bool ok = commitFile(m_destHandle) == 0 && writeRecord();
+    TRACE_END(TRACE_SYNC, syncStart, m_offset);
+    return ok;
+}
+
+void CopyJournal::checkpointIfDue(double seconds) {
+    if (seconds - m_lastCheckpoint >= CHECKPOINT_INTERVAL) {
+        checkpoint();
+        m_lastCheckpoint = seconds;
+    }
+}
+
+void CopyJournal::remove() {
+    if (m_handle >= 0) {
+        close(m_handle);
+        m_handle = -1;
+    }
+    unlink(m_path);
+}
@@ -0,0 +1,62 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "platform.h"
+#include "engine.h"
+
+// Checkpoint journal for resumable transfers (/resume). It sits next to
+// the destination (FILE.xx$ on DOS, file.JRN elsewhere) and holds one
+// fixed-size record: the source size and time, the number of bytes
+// committed to the destination, and the CRC-32 of those bytes. The
+// record is rewritten in place every couple of seconds after the
+// destination has been flushed, and deleted when the copy completes.
+class CopyJournal : public DataSink {
+private:
+    char m_path[MAXPATH];
+    int m_handle;
+    int m_destHandle;
+    fsize_t m_fileSize;
+    long m_sourceTime;
+    fsize_t m_offset;       // Bytes committed so far
+    unsigned long m_crc;    // Running CRC-32 of those bytes
+    double m_lastCheckpoint;
+
+    bool readRecord(fsize_t& fileSize, long& sourceTime, fsize_t& offset, unsigned long& crc);
+    bool writeRecord();
+
+    // Not copyable
+    CopyJournal(const CopyJournal&);
+    CopyJournal& operator=(const CopyJournal&);
+
+public:
+    CopyJournal(const char* destPath);
+    virtual ~CopyJournal();
+
+    // True if a journal exists for this destination
+    static bool exists(const char* destPath);
+
+    // Check an existing journal against the source and re-read the
+    // destination prefix to confirm its checksum. Returns the offset to
+    // resume from, or 0 to start over.
+    fsize_t validate(int sourceHandle, fsize_t fileSize, const char* destPath, bool debugMode);
+
+    // Start journalling at offset (0 or the value from validate())
+    bool start(int sourceHandle, int destHandle, fsize_t fileSize, fsize_t offset);
+
+    // Running checksum of everything the engine writes
+    virtual void onData(const char* data, long length);
+
+    // Flush the destination and record the committed offset
+    bool checkpoint();
+
+    // Checkpoint if enough time has passed since the last one
+    void checkpointIfDue(double seconds);
+
+    // Transfer complete - the journal is no longer needed
+    void remove();
+
+    fsize_t getOffset() const { return m_offset; }
+    const char* getPath() const { return m_path; }
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,62 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "limiter.h"
+#include "hrtimer.h"
+
+// Smallest bucket - below this every chunk would mean a sleep
+const long MIN_BURST = 4096L;
+
+RateLimiter::RateLimiter(long bytesPerSecond, long burstBytes)
+    : m_rate(bytesPerSecond), m_burst(burstBytes) {
+    if (m_burst <= 0) {
+        m_burst = m_rate / 4;
+    }
+    if (m_burst < MIN_BURST) {
+        m_burst = MIN_BURST;
+    }
+    // Start full so the first chunk goes straight through
+    m_tokens = (double)m_burst;
+    m_last = hrNowMicros();
+}
+
+void RateLimiter::consume(long bytes) {
+    double waitSeconds;
+    {
+#ifdef FC_THREADS
+        ScopedLock lock(m_lock);
+#endif
+        unsigned long now = hrNowMicros();
+        m_tokens += (double)hrElapsedMicros(m_last, now) * (double)m_rate / 1000000.0;
+        m_last = now;
+        if (m_tokens > (double)m_burst) {
+            m_tokens = (double)m_burst;
+        }
+        m_tokens -= (double)bytes;
+        waitSeconds = (m_tokens < 0.0) ? -m_tokens / (double)m_rate : 0.0;
+    }
+
+    // Sleep outside the lock so other workers can take their share.
+    // Debts under a millisecond carry over to the next chunk.
+    unsigned milliseconds = (unsigned)(waitSeconds * 1000.0);
+    if (milliseconds > 0) {
+        delay(milliseconds);
+    }
+}
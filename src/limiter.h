@@ -0,0 +1,40 @@
+#ifndef LIMITER_H
+#define LIMITER_H
+
+#include "fcthread.h"
+
+// Token-bucket bandwidth limiter (/limit). The bucket fills at the
+// configured rate up to burst bytes; every chunk copied takes its size
+// out, and a copier that overdraws the bucket sleeps until the rate
+// has paid the debt back. Short bursts run at full speed while the
+// average stays at the limit.
+//
+// One limiter can be shared by all tree-copy workers, which then share
+// the bandwidth between them. Without /limit no limiter exists and the
+// copy loop never sleeps.
+class RateLimiter {
+private:
+    long m_rate;            // Bytes per second
+    long m_burst;           // Bucket size in bytes
+    double m_tokens;        // Negative while in debt
+    unsigned long m_last;   // Clock reading of the last refill
+#ifdef FC_THREADS
+    Mutex m_lock;
+#endif
+
+    // Not copyable
+    RateLimiter(const RateLimiter&);
+    RateLimiter& operator=(const RateLimiter&);
+
+public:
+    // burstBytes 0 picks a quarter of a second's worth
+    RateLimiter(long bytesPerSecond, long burstBytes);
+
+    long getRate() const { return m_rate; }
+    long getBurst() const { return m_burst; }
+
+    // Account for bytes just copied, sleeping if they went over the rate
+    void consume(long bytes);
+};
+
+#endif // LIMITER_H
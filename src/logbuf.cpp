@@ -0,0 +1,128 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "logbuf.h"
+#include "hrtimer.h"
+#include "trace.h"
+
+LogWriter::LogWriter(const char* path, const char* header, long capacity, long maxSize)
+    : m_header(header), m_used(0), m_capacity(capacity), m_maxSize(maxSize),
+      m_firstRecord(0) {
+    strcpy(m_path, path);
+    m_buffer = new char[(unsigned)m_capacity];
+}
+
+LogWriter::~LogWriter() {
+    flush();
+    delete[] m_buffer;
+}
+
+bool LogWriter::append(const char* record) {
+    long length = strlen(record);
+
+    // Make room; a record bigger than the whole buffer goes straight out
+    if (m_used + length > m_capacity && !flush()) {
+        return false;
+    }
+    if (length > m_capacity) {
+        TRACE_START(writeStart);
+        bool ok = writeOut(record, length);
+        TRACE_END(TRACE_LOG, writeStart, length);
+        return ok;
+    }
+
+    if (m_used == 0) {
+        m_firstRecord = hrNowMicros();
+    }
+    memcpy(m_buffer + m_used, record, (size_t)length);
+    m_used += length;
+    return true;
+}
+
+bool LogWriter::isDue() const {
+    return m_used > 0 &&
+           hrElapsedMicros(m_firstRecord, hrNowMicros()) >= (unsigned long)LOG_FLUSH_SECONDS * 1000000UL;
+}
+
+bool LogWriter::flush() {
+    if (m_used == 0) {
+        return true;
+    }
+    TRACE_START(writeStart);
+    bool ok = writeOut(m_buffer, m_used);
+    TRACE_END(TRACE_LOG, writeStart, m_used);
+    m_used = 0;
+    return ok;
+}
+
+// Rotated name: the last character of the name replaced by the
+// generation number, which keeps DOS 8.3 names valid
+static void rotatedPath(const char* path, int generation, char* result) {
+    strcpy(result, path);
+    result[strlen(result) - 1] = (char)('0' + generation);
+}
+
+void LogWriter::rotate() {
+    char older[MAXPATH];
+    char newer[MAXPATH];
+    rotatedPath(m_path, LOG_GENERATIONS, older);
+    unlink(older);
+    for (int generation = LOG_GENERATIONS - 1; generation >= 1; generation--) {
+        rotatedPath(m_path, generation, newer);
+        rename(newer, older);
+        strcpy(older, newer);
+    }
+    rename(m_path, older);
+}
+
+bool LogWriter::writeOut(const char* data, long length) {
+    int handle = open(m_path, O_WRONLY | O_CREAT | O_APPEND | O_BINARY, 0666);
+    if (handle < 0) {
+        return false;
+    }
+
+    long size = filelength(handle);
+    if (size > 0 && size + length > m_maxSize) {
+        close(handle);
+        rotate();
+        handle = open(m_path, O_WRONLY | O_CREAT | O_APPEND | O_BINARY, 0666);
+        if (handle < 0) {
+            return false;
+        }
+        size = 0;
+    }
+
+    bool ok = true;
+    if (size == 0 && m_header != NULL) {
+        unsigned headerLength = (unsigned)strlen(m_header);
+        ok = (write(handle, m_header, headerLength) == (int)headerLength);
+    }
+    while (ok && length > 0) {
+        // DOS write() takes at most 64K - 1 bytes
+        unsigned part = (unsigned)((length < 32768L) ? length : 32768L);
+        ok = (write(handle, data, part) == (int)part);
+        data += part;
+        length -= part;
+    }
+    if (close(handle) != 0) {
+        ok = false;
+    }
+    return ok;
+}
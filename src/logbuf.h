@@ -0,0 +1,55 @@
+#ifndef LOGBUF_H
+#define LOGBUF_H
+
+#include "platform.h"
+
+// Keep this many rotated files besides the live one
+const int LOG_GENERATIONS = 3;
+
+// Buffered records are written out once the oldest is this old
+const long LOG_FLUSH_SECONDS = 30L;
+
+// Buffered, size-rotated writer for the structured logs. Records collect
+// in memory and reach the file in batches - when the buffer fills, when
+// the oldest record has waited LOG_FLUSH_SECONDS, or when the writer is
+// destroyed - so a tree copy opens the log once per batch instead of
+// once per file.
+//
+// When a batch would take the file past maxSize it is rotated first:
+// TRANSFER.JSL becomes TRANSFER.JS1, TRANSFER.JS1 becomes TRANSFER.JS2
+// and so on, keeping LOG_GENERATIONS old files. header, if given, starts
+// every new file (the CSV column names).
+class LogWriter {
+private:
+    char m_path[MAXPATH];
+    const char* m_header;
+    char* m_buffer;
+    long m_used;
+    long m_capacity;
+    long m_maxSize;
+    unsigned long m_firstRecord;    // Clock reading when the batch started
+
+    bool writeOut(const char* data, long length);
+    void rotate();
+
+    // Not copyable
+    LogWriter(const LogWriter&);
+    LogWriter& operator=(const LogWriter&);
+
+public:
+    LogWriter(const char* path, const char* header, long capacity, long maxSize);
+    ~LogWriter();
+
+    const char* getPath() const { return m_path; }
+
+    // Queue one record, which must end with a newline
+    bool append(const char* record);
+
+    // Write out everything queued. Returns false if the file can't be written.
+    bool flush();
+
+    // True if the queued records have waited long enough
+    bool isDue() const;
+};
+
+#endif // LOGBUF_H
@@ -1,27 +1,16 @@
+#include "platform.h"
 #include "logger.h"
-#include <fstream.h>
-#include <iostream.h>
+#include "fcthread.h"
+#include "logbuf.h"
+#include "progress.h"
+#include "trace.h"
+#include <stdlib.h>
 #include <time.h>
-#include <string.h>
-#include <stdio.h>
-#include <dir.h>  // For directory handling
-
-// Function to format speed for logging
-void formatSpeedForLog(long bytesPerSec, char* buffer) {
-    if (bytesPerSec <= 0) {
-        strcpy(buffer, "0.00 KB/s");
-        return;
-    }
-    
-    // Use MB/s for speeds over 2048 KB/s (2 MB/s)
-    if (bytesPerSec >= 2048 * 1024) {
-        double mbPerSec = (double)bytesPerSec / (1024.0 * 1024.0);
-        sprintf(buffer, "%.2f MB/s", mbPerSec);
-    } else {
-        double kbPerSec = (double)bytesPerSec / 1024.0;
-        sprintf(buffer, "%.2f KB/s", kbPerSec);
-    }
-}
+
+#ifdef FC_THREADS
+// Tree-copy workers log from several threads
+static Mutex gLogLock;
+#endif
 
 // Extract the directory path from a full file path
 void extractDirectory(const char* filePath, char* dirPath) {
@@ -39,23 +28,380 @@ void extractDirectory(const char* filePath, char* dirPath) {
         *(lastSep + 1) = '\0';
     } else {
         // No directory separator found, use current directory
-        strcpy(dirPath, ".\\");
+        strcpy(dirPath, "." PATH_SEP_STR);
     }
 }
 
+// Structured log settings. DOS gets a few small buffers; a Linux tree
+// copy may be writing into many directories at once.
+#ifdef FC_DOS
+const int MAX_LOG_WRITERS = 4;
+const long LOG_BUFFER_SIZE = 4096L;
+const long DEFAULT_LOG_MAX_SIZE = 1024L * 1024L;
+#else
+const int MAX_LOG_WRITERS = 16;
+const long LOG_BUFFER_SIZE = 65536L;
+const long DEFAULT_LOG_MAX_SIZE = 16L * 1024L * 1024L;
+#endif
+
+// Column order of a structured record. The JSON keys are the same, in
+// the same order; new fields are only ever added at the end.
+static const char CSV_HEADER[] =
+    "v,time,status,source,destination,size,copied,written,duration_ms,"
+    "avg_Bps,min_Bps,max_Bps,p5_Bps,p50_Bps,p95_Bps,stalls,longest_stall_ms,"
+    "engine,chunk,adaptive,checksum_alg,checksum,readback,hash_Bps,journal,"
+    "series_step_ms,series_KBps,queue_depth,pack_mode,raw_bytes,packed_bytes,"
+    "pack_pct,logical_Bps,dedup_of,saved_bytes\n";
+// Raised whenever a field is added
+const int LOG_SCHEMA_VERSION = 4;
+
+static LogFormat gFormat = LOG_TEXT;
+static long gMaxSize = DEFAULT_LOG_MAX_SIZE;
+static LogWriter* gWriters[MAX_LOG_WRITERS];
+static unsigned long gWriterUse[MAX_LOG_WRITERS];   // For least-recently-used eviction
+static unsigned long gUseCounter = 0;
+static bool gAtExitRegistered = false;
+
+// Builds one JSON-lines or CSV record into a fixed buffer. Fields must be
+// added in CSV_HEADER order.
+class RecordBuilder {
+private:
+    LogFormat m_format;
+    char* m_text;
+    long m_length;
+    long m_capacity;
+    bool m_first;
+
+    void addChar(char c) {
+        // Leave room for the closing characters
+        if (m_length < m_capacity - 4) {
+            m_text[m_length++] = c;
+        }
+    }
+
+    void addRaw(const char* text) {
+        while (*text != '\0') {
+            addChar(*text++);
+        }
+    }
+
+    void startField(const char* name) {
+        if (!m_first) {
+            addChar(',');
+        }
+        m_first = false;
+        if (m_format == LOG_JSON) {
+            addChar('"');
+            addRaw(name);
+            addRaw("\":");
+        }
+    }
+
+public:
+    RecordBuilder(LogFormat format, long capacity)
+        : m_format(format), m_length(0), m_capacity(capacity), m_first(true) {
+        m_text = new char[(unsigned)capacity];
+        if (m_format == LOG_JSON) {
+            addChar('{');
+        }
+    }
+
+    ~RecordBuilder() {
+        delete[] m_text;
+    }
+
+    void addNull(const char* name) {
+        startField(name);
+        if (m_format == LOG_JSON) {
+            addRaw("null");
+        }
+    }
+
+    void addNumber(const char* name, fsize_t value) {
+        char number[24];
+        sprintf(number, FSIZE_FORMAT, value);
+        startField(name);
+        addRaw(number);
+    }
+
+    void addBool(const char* name, bool value) {
+        startField(name);
+        addRaw(value ? "true" : "false");
+    }
+
+    // JSON escapes backslashes (every DOS path has them), quotes and
+    // control characters; CSV doubles quotes
+    void addString(const char* name, const char* value) {
+        if (value == NULL) {
+            addNull(name);
+            return;
+        }
+        startField(name);
+        addChar('"');
+        for (const char* p = value; *p != '\0'; p++) {
+            unsigned char c = (unsigned char)*p;
+            if (m_format == LOG_CSV) {
+                if (c == '"') {
+                    addChar('"');
+                }
+                addChar((char)c);
+            } else if (c == '"' || c == '\\') {
+                addChar('\\');
+                addChar((char)c);
+            } else if (c < 0x20) {
+                char escape[8];
+                sprintf(escape, "\\u%04x", (unsigned)c);
+                addRaw(escape);
+            } else {
+                addChar((char)c);
+            }
+        }
+        addChar('"');
+    }
+
+    // Array in JSON, space-separated string in CSV
+    void addSeries(const char* name, const long* values, int count) {
+        startField(name);
+        addChar(m_format == LOG_JSON ? '[' : '"');
+        for (int i = 0; i < count; i++) {
+            char number[24];
+            sprintf(number, "%ld", values[i]);
+            if (i > 0) {
+                addChar(m_format == LOG_JSON ? ',' : ' ');
+            }
+            addRaw(number);
+        }
+        addChar(m_format == LOG_JSON ? ']' : '"');
+    }
+
+    const char* finish() {
+        if (m_format == LOG_JSON) {
+            m_text[m_length++] = '}';
+        }
+        m_text[m_length++] = '\n';
+        m_text[m_length] = '\0';
+        return m_text;
+    }
+};
+
+void Logger::setFormat(LogFormat format) {
+    gFormat = format;
+}
+
+LogFormat Logger::getFormat() {
+    return gFormat;
+}
+
+void Logger::setMaxSize(long maxSize) {
+    gMaxSize = maxSize;
+}
+
+// Caller holds gLogLock
+static void flushWriters() {
+    for (int i = 0; i < MAX_LOG_WRITERS; i++) {
+        if (gWriters[i] != NULL) {
+            if (!gWriters[i]->flush()) {
+                cerr << "Error writing log file: " << gWriters[i]->getPath() << endl;
+            }
+            delete gWriters[i];
+            gWriters[i] = NULL;
+        }
+    }
+}
+
+static void flushAtExit() {
+    Logger::flushAll();
+}
+
+void Logger::flushAll() {
+#ifdef FC_THREADS
+    ScopedLock lock(gLogLock);
+#endif
+    flushWriters();
+}
+
+void Logger::flushFromSignal() {
+#ifdef FC_THREADS
+    // A worker may be in the middle of a record - give it a moment, but
+    // never wait on a lock this thread itself might hold
+    for (int attempt = 0; attempt < 20; attempt++) {
+        if (gLogLock.tryLock()) {
+            flushWriters();
+            gLogLock.unlock();
+            return;
+        }
+        delay(10);
+    }
+#else
+    flushWriters();
+#endif
+}
+
+// Queue a record for the structured log in a directory. Caller holds
+// gLogLock.
+static void appendRecord(const char* directory, const char* record) {
+    char path[MAXPATH];
+    strcpy(path, directory);
+    strcat(path, (gFormat == LOG_JSON) ? "TRANSFER.JSL" : "TRANSFER.CSV");
+
+    if (!gAtExitRegistered) {
+        atexit(flushAtExit);
+        gAtExitRegistered = true;
+    }
+
+    // Find the directory's writer, or make room for one
+    int slot = -1;
+    int oldest = 0;
+    for (int i = 0; i < MAX_LOG_WRITERS; i++) {
+        if (gWriters[i] != NULL && strcmp(gWriters[i]->getPath(), path) == 0) {
+            slot = i;
+            break;
+        }
+        if (gWriters[i] == NULL || (gWriters[oldest] != NULL && gWriterUse[i] < gWriterUse[oldest])) {
+            oldest = i;
+        }
+    }
+    if (slot < 0) {
+        slot = oldest;
+        delete gWriters[slot];
+        gWriters[slot] = new LogWriter(path, (gFormat == LOG_CSV) ? CSV_HEADER : NULL,
+                                       LOG_BUFFER_SIZE, gMaxSize);
+    }
+    gWriterUse[slot] = ++gUseCounter;
+
+    if (!gWriters[slot]->append(record)) {
+        cerr << "Error writing log file: " << path << endl;
+    }
+
+    // Don't let a quiet directory sit on its records for the whole run
+    for (int i = 0; i < MAX_LOG_WRITERS; i++) {
+        if (gWriters[i] != NULL && gWriters[i]->isDue() && !gWriters[i]->flush()) {
+            cerr << "Error writing log file: " << gWriters[i]->getPath() << endl;
+        }
+    }
+}
+
+// Local time as ISO 8601
+static void formatLogTime(char* buffer) {
+    time_t now = time(NULL);
+    strftime(buffer, 32, "%Y-%m-%dT%H:%M:%S", localtime(&now));
+}
+
+// Packed size as a percentage of the original
+static long packPercent(const PackInfo* pack) {
+    if (pack->rawBytes <= 0) {
+        return 100;
+    }
+    return (long)((double)pack->packedBytes * 100.0 / (double)pack->rawBytes + 0.5);
+}
+
+// Room for two escaped paths plus the fixed fields
+const long RECORD_SIZE = 4L * MAXPATH + 2048L;
+
 // Changed to use longs instead of doubles
 void Logger::logTransferDetails(const char* source, const char* destination, 
-                               long fileSize, long maxSpeed, long minSpeed, 
-                               long avgSpeed, long duration) {
+                               fsize_t fileSize, long maxSpeed, long minSpeed, 
+                               long avgSpeed, long duration,
+                               const char* engineName, long chunkSize,
+                               bool adaptiveChunk, int queueDepth,
+                               fsize_t bytesWritten,
+                               const VerifyInfo* verify,
+                               const ThroughputInfo* throughput,
+                               const PackInfo* pack) {
+#ifdef FC_THREADS
+    ScopedLock lock(gLogLock);
+#endif
     // Extract the destination directory
-    char destDir[256];
+    char destDir[MAXPATH];
     extractDirectory(destination, destDir);
     
+    if (gFormat != LOG_TEXT) {
+        char timeBuffer[32];
+        formatLogTime(timeBuffer);
+        bool mismatch = verify != NULL && verify->readBack[0] != '\0' &&
+                        strcmp(verify->readBack, verify->digest) != 0;
+        bool measured = throughput != NULL && throughput->intervals > 0;
+
+        RecordBuilder record(gFormat, RECORD_SIZE);
+        record.addNumber("v", LOG_SCHEMA_VERSION);
+        record.addString("time", timeBuffer);
+        record.addString("status", mismatch ? "mismatch" : "ok");
+        record.addString("source", source);
+        record.addString("destination", destination);
+        record.addNumber("size", fileSize);
+        record.addNumber("copied", fileSize);
+        if (bytesWritten >= 0) {
+            record.addNumber("written", bytesWritten);
+        } else {
+            record.addNull("written");
+        }
+        record.addNumber("duration_ms", duration);
+        record.addNumber("avg_Bps", avgSpeed);
+        record.addNumber("min_Bps", minSpeed);
+        record.addNumber("max_Bps", maxSpeed);
+        if (measured) {
+            record.addNumber("p5_Bps", throughput->p5);
+            record.addNumber("p50_Bps", throughput->p50);
+            record.addNumber("p95_Bps", throughput->p95);
+        } else {
+            record.addNull("p5_Bps");
+            record.addNull("p50_Bps");
+            record.addNull("p95_Bps");
+        }
+        record.addNumber("stalls", throughput ? throughput->stalls : 0);
+        record.addNumber("longest_stall_ms", throughput ? throughput->longestStall : 0);
+        record.addString("engine", engineName);
+        record.addNumber("chunk", chunkSize);
+        record.addBool("adaptive", adaptiveChunk);
+        if (verify != NULL) {
+            record.addString("checksum_alg", verify->algorithm);
+            record.addString("checksum", verify->digest);
+            record.addString("readback", verify->readBack[0] != '\0' ? verify->readBack : NULL);
+            record.addNumber("hash_Bps", verify->hashRate);
+        } else {
+            record.addNull("checksum_alg");
+            record.addNull("checksum");
+            record.addNull("readback");
+            record.addNull("hash_Bps");
+        }
+        record.addNull("journal");
+        if (throughput != NULL && throughput->seriesCount > 0) {
+            long series[MAX_SERIES_POINTS];
+            for (int i = 0; i < throughput->seriesCount; i++) {
+                series[i] = throughput->series[i] / 1024L;
+            }
+            record.addNumber("series_step_ms", throughput->seriesStep);
+            record.addSeries("series_KBps", series, throughput->seriesCount);
+        } else {
+            record.addNull("series_step_ms");
+            record.addSeries("series_KBps", NULL, 0);
+        }
+        record.addNumber("queue_depth", (long)queueDepth);
+        if (pack != NULL) {
+            record.addString("pack_mode", pack->mode);
+            record.addNumber("raw_bytes", pack->rawBytes);
+            record.addNumber("packed_bytes", pack->packedBytes);
+            record.addNumber("pack_pct", packPercent(pack));
+            record.addNumber("logical_Bps", pack->logicalRate);
+        } else {
+            record.addNull("pack_mode");
+            record.addNull("raw_bytes");
+            record.addNull("packed_bytes");
+            record.addNull("pack_pct");
+            record.addNull("logical_Bps");
+        }
+        record.addNull("dedup_of");
+        record.addNull("saved_bytes");
+        appendRecord(destDir, record.finish());
+        return;
+    }
+    
     // Create log file path in the destination directory
-    char logPath[256];
+    char logPath[MAXPATH];
     strcpy(logPath, destDir);
     strcat(logPath, "TRANSFER.LOG");
     
+    TRACE_START(logStart);
     ofstream logFile(logPath, ios::app);
     
     if (!logFile) {
@@ -74,9 +420,9 @@ void Logger::logTransferDetails(const char* source, const char* destination,
     char minSpeedStr[20];
     char avgSpeedStr[20];
     
-    formatSpeedForLog(maxSpeed, maxSpeedStr);
-    formatSpeedForLog(minSpeed, minSpeedStr);
-    formatSpeedForLog(avgSpeed, avgSpeedStr);
+    formatSpeed(maxSpeed, maxSpeedStr);
+    formatSpeed(minSpeed, minSpeedStr);
+    formatSpeed(avgSpeed, avgSpeedStr);
 
     logFile << "Transfer Log" << endl;
     logFile << "Date and Time: " << timeBuffer << endl;
@@ -86,8 +432,241 @@ void Logger::logTransferDetails(const char* source, const char* destination,
     logFile << "Max: " << maxSpeedStr << endl;
     logFile << "Min: " << minSpeedStr << endl;
     logFile << "Avg: " << avgSpeedStr << endl;
-    logFile << "Time: " << duration << " seconds" << endl;
+    char durationStr[32];
+    formatDuration(duration, durationStr);
+    logFile << "Time: " << durationStr << " seconds" << endl;
+    logFile << "Engine: " << engineName << endl;
+    logFile << "Chunk: " << chunkSize << " bytes"
+            << (adaptiveChunk ? " (adaptive)" : "") << endl;
+    logFile << "Queue depth: " << queueDepth << endl;
+    if (bytesWritten >= 0) {
+        logFile << "Written: " << bytesWritten << " bytes (delta)" << endl;
+    }
+    if (pack != NULL) {
+        char logicalStr[20];
+        formatSpeed(pack->logicalRate, logicalStr);
+        logFile << "Packed: " << pack->rawBytes << " -> " << pack->packedBytes << " bytes ("
+                << packPercent(pack) << "% of original, " << pack->mode << ")" << endl;
+        logFile << "Logical speed: " << logicalStr << endl;
+    }
+    if (verify != NULL) {
+        char hashRateStr[20];
+        formatSpeed(verify->hashRate, hashRateStr);
+        logFile << "Checksum: " << verify->algorithm << " " << verify->digest << endl;
+        if (verify->readBack[0] != '\0') {
+            logFile << "Read-back: " << verify->readBack
+                    << (strcmp(verify->readBack, verify->digest) == 0 ? " (OK)" : " (MISMATCH)") << endl;
+        }
+        logFile << "Hash rate: " << hashRateStr << endl;
+    }
+    if (throughput != NULL && throughput->intervals > 0) {
+        char p5Str[20];
+        char p50Str[20];
+        char p95Str[20];
+        formatSpeed(throughput->p5, p5Str);
+        formatSpeed(throughput->p50, p50Str);
+        formatSpeed(throughput->p95, p95Str);
+        logFile << "Throughput p5/p50/p95: " << p5Str << " / " << p50Str
+                << " / " << p95Str << endl;
+
+        char stallStr[32];
+        formatDuration(throughput->longestStall, stallStr);
+        logFile << "Stalls: " << throughput->stalls;
+        if (throughput->stalls > 0) {
+            logFile << " (longest " << stallStr << " seconds)";
+        }
+        logFile << endl;
+    }
+    if (throughput != NULL && throughput->seriesCount > 0) {
+        char stepStr[32];
+        formatDuration(throughput->seriesStep, stepStr);
+        logFile << "Series (KB/s every " << stepStr << " s):";
+        for (int i = 0; i < throughput->seriesCount; i++) {
+            logFile << " " << throughput->series[i] / 1024L;
+        }
+        logFile << endl;
+    }
     logFile << "----------------------------------------" << endl;
 
     logFile.close();
-}
\ No newline at end of file
+    TRACE_END(TRACE_LOG, logStart, 0);
+}
+
+void Logger::logDuplicate(const char* source, const char* destination, const char* original,
+                          fsize_t fileSize, bool linked) {
+#ifdef FC_THREADS
+    ScopedLock lock(gLogLock);
+#endif
+    char destDir[MAXPATH];
+    extractDirectory(destination, destDir);
+    
+    if (gFormat != LOG_TEXT) {
+        char timeBuffer[32];
+        formatLogTime(timeBuffer);
+        
+        RecordBuilder record(gFormat, RECORD_SIZE + MAXPATH * 2L);
+        record.addNumber("v", LOG_SCHEMA_VERSION);
+        record.addString("time", timeBuffer);
+        record.addString("status", linked ? "linked" : "listed");
+        record.addString("source", source);
+        record.addString("destination", destination);
+        record.addNumber("size", fileSize);
+        record.addNumber("copied", (fsize_t)0);
+        record.addNumber("written", (fsize_t)0);
+        record.addNull("duration_ms");
+        record.addNull("avg_Bps");
+        record.addNull("min_Bps");
+        record.addNull("max_Bps");
+        record.addNull("p5_Bps");
+        record.addNull("p50_Bps");
+        record.addNull("p95_Bps");
+        record.addNull("stalls");
+        record.addNull("longest_stall_ms");
+        record.addNull("engine");
+        record.addNull("chunk");
+        record.addNull("adaptive");
+        record.addNull("checksum_alg");
+        record.addNull("checksum");
+        record.addNull("readback");
+        record.addNull("hash_Bps");
+        record.addNull("journal");
+        record.addNull("series_step_ms");
+        record.addSeries("series_KBps", NULL, 0);
+        record.addNull("queue_depth");
+        record.addNull("pack_mode");
+        record.addNull("raw_bytes");
+        record.addNull("packed_bytes");
+        record.addNull("pack_pct");
+        record.addNull("logical_Bps");
+        record.addString("dedup_of", original);
+        record.addNumber("saved_bytes", fileSize);
+        appendRecord(destDir, record.finish());
+        return;
+    }
+    
+    char logPath[MAXPATH];
+    strcpy(logPath, destDir);
+    strcat(logPath, "TRANSFER.LOG");
+    
+    TRACE_START(logStart);
+    ofstream logFile(logPath, ios::app);
+    if (!logFile) {
+        cerr << "Error opening log file: " << logPath << endl;
+        return;
+    }
+    
+    time_t now = time(NULL);
+    char timeBuffer[80];
+    strftime(timeBuffer, 80, "%Y-%m-%d %H:%M:%S", localtime(&now));
+    
+    logFile << "Transfer Log" << endl;
+    logFile << "Date and Time: " << timeBuffer << endl;
+    logFile << "Source: " << source << endl;
+    logFile << "Destination: " << destination << endl;
+    logFile << "Size: " << fileSize << " bytes" << endl;
+    logFile << "Duplicate of: " << original << endl;
+    logFile << "Saved: " << fileSize << " bytes ("
+            << (linked ? "hardlink" : "listed in DEDUP.LST") << ")" << endl;
+    logFile << "----------------------------------------" << endl;
+    
+    logFile.close();
+    TRACE_END(TRACE_LOG, logStart, 0);
+}
+
+void Logger::logRandomIo(const char* directory, const RandomIoInfo& info) {
+#ifdef FC_THREADS
+    ScopedLock lock(gLogLock);
+#endif
+    char logPath[MAXPATH];
+    strcpy(logPath, directory);
+    int length = strlen(logPath);
+    if (length > 0 && logPath[length - 1] != '\\' && logPath[length - 1] != '/') {
+        strcat(logPath, PATH_SEP_STR);
+    }
+    strcat(logPath, "TRANSFER.LOG");
+
+    ofstream logFile(logPath, ios::app);
+    if (!logFile) {
+        cerr << "Error opening log file: " << logPath << endl;
+        return;
+    }
+
+    time_t now = time(NULL);
+    char timeBuffer[80];
+    strftime(timeBuffer, 80, "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    char durationStr[32];
+    formatDuration(info.duration, durationStr);
+    char rateStr[20];
+    formatSpeed((long)((double)info.iops * (double)info.ioSize), rateStr);
+
+    logFile << "Random I/O Log" << endl;
+    logFile << "Date and Time: " << timeBuffer << endl;
+    logFile << "Directory: " << directory << endl;
+    logFile << "Test: random " << info.test << endl;
+    logFile << "Size: " << info.fileSize << " bytes" << endl;
+    logFile << "Block: " << info.ioSize << " bytes" << endl;
+    logFile << "Queue depth: " << info.queueDepth << endl;
+    logFile << "Operations: " << info.operations << endl;
+    logFile << "Time: " << durationStr << " seconds" << endl;
+    logFile << "IOPS: " << info.iops << " (" << rateStr << ")" << endl;
+    logFile << "Latency p50: " << info.p50 << " us" << endl;
+    logFile << "Latency p99: " << info.p99 << " us" << endl;
+    logFile << "Latency p99.9: " << info.p999 << " us" << endl;
+    logFile << "Latency max: " << info.maximum << " us" << endl;
+    logFile << "----------------------------------------" << endl;
+}
+
+void Logger::logInterrupted(const char* source, const char* destination,
+                            fsize_t fileSize, fsize_t bytesCopied, long avgSpeed,
+                            long duration, fsize_t journalOffset) {
+    char destDir[MAXPATH];
+    extractDirectory(destination, destDir);
+    char timeBuffer[32];
+    formatLogTime(timeBuffer);
+
+    RecordBuilder record(gFormat, RECORD_SIZE);
+    record.addNumber("v", LOG_SCHEMA_VERSION);
+    record.addString("time", timeBuffer);
+    record.addString("status", "interrupted");
+    record.addString("source", source);
+    record.addString("destination", destination);
+    record.addNumber("size", fileSize);
+    record.addNumber("copied", bytesCopied);
+    record.addNull("written");
+    record.addNumber("duration_ms", duration);
+    record.addNumber("avg_Bps", avgSpeed);
+    record.addNull("min_Bps");
+    record.addNull("max_Bps");
+    record.addNull("p5_Bps");
+    record.addNull("p50_Bps");
+    record.addNull("p95_Bps");
+    record.addNull("stalls");
+    record.addNull("longest_stall_ms");
+    record.addNull("engine");
+    record.addNull("chunk");
+    record.addNull("adaptive");
+    record.addNull("checksum_alg");
+    record.addNull("checksum");
+    record.addNull("readback");
+    record.addNull("hash_Bps");
+    if (journalOffset >= 0) {
+        record.addNumber("journal", journalOffset);
+    } else {
+        record.addNull("journal");
+    }
+    record.addNull("series_step_ms");
+    record.addSeries("series_KBps", NULL, 0);
+    record.addNull("queue_depth");
+    record.addNull("pack_mode");
+    record.addNull("raw_bytes");
+    record.addNull("packed_bytes");
+    record.addNull("pack_pct");
+    record.addNull("logical_Bps");
+    record.addNull("dedup_of");
+    record.addNull("saved_bytes");
+
+    // Called from the interrupt handler, which flushes afterwards - no
+    // locking here for the same reason as flushFromSignal()
+    appendRecord(destDir, record.finish());
+}
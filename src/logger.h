@@ -1,12 +1,108 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include "platform.h"
+
+// Checksum results for the log (see verify.h)
+struct VerifyInfo {
+    const char* algorithm;
+    char digest[17];        // Of the data as it was written
+    char readBack[17];      // Of the destination read back, empty if not checked
+    long hashRate;          // Hashing throughput in bytes per second
+};
+
+// Most points in the throughput time series
+const int MAX_SERIES_POINTS = 48;
+
+// Distribution of per-interval throughput over one transfer (see
+// thruput.h). Rates are in bytes per second.
+struct ThroughputInfo {
+    unsigned long intervals;    // Complete intervals measured
+    long p5;
+    long p50;
+    long p95;
+    int stalls;                 // Runs of intervals with no progress
+    long longestStall;          // Milliseconds
+    long seriesStep;            // Milliseconds covered by each series point
+    int seriesCount;
+    long series[MAX_SERIES_POINTS];
+};
+
+// Packed transfer results for the log (see packer.h). The logical rate
+// is uncompressed bytes per second, whichever way the data went.
+struct PackInfo {
+    const char* mode;       // "pack" or "unpack"
+    fsize_t rawBytes;
+    fsize_t packedBytes;
+    long logicalRate;
+};
+
+// Summary of one /bench /random test for the log (see randio.h).
+// Latencies are in microseconds.
+struct RandomIoInfo {
+    const char* test;       // "read" or "write"
+    fsize_t fileSize;
+    long ioSize;
+    int queueDepth;
+    unsigned long operations;
+    long duration;          // Milliseconds
+    long iops;
+    unsigned long p50;
+    unsigned long p99;
+    unsigned long p999;
+    unsigned long maximum;
+};
+
+// Format of the per-directory transfer log. LOG_TEXT is TRANSFER.LOG;
+// the structured formats go to TRANSFER.JSL (one JSON object per line)
+// or TRANSFER.CSV through a buffered, rotating writer (see logbuf.h).
+enum LogFormat {
+    LOG_TEXT,
+    LOG_JSON,
+    LOG_CSV
+};
+
 class Logger {
 public:
-    // Changed to use longs instead of doubles
+    // Process-wide log settings. maxSize is the size at which structured
+    // logs are rotated.
+    static void setFormat(LogFormat format);
+    static LogFormat getFormat();
+    static void setMaxSize(long maxSize);
+
+    // Write out every buffered structured record. Runs at exit; the
+    // signal version gives up rather than wait on a lock held by the
+    // interrupted thread.
+    static void flushAll();
+    static void flushFromSignal();
+
+    // Record an interrupted transfer in the structured log. journalOffset
+    // is the resumable byte count, -1 without /resume.
+    void logInterrupted(const char* source, const char* destination,
+                        fsize_t fileSize, fsize_t bytesCopied, long avgSpeed,
+                        long duration, fsize_t journalOffset);
+
+    // Changed to use longs instead of doubles - duration is in milliseconds.
+    // bytesWritten is only given for delta copies, where it can be less
+    // than fileSize; verify only with /v. queueDepth is the number of
+    // requests the engine kept in flight; pack only with /pack or /unpack.
     void logTransferDetails(const char* source, const char* destination, 
-                            long fileSize, long maxSpeed, long minSpeed, 
-                            long avgSpeed, long duration);
+                            fsize_t fileSize, long maxSpeed, long minSpeed, 
+                            long avgSpeed, long duration,
+                            const char* engineName, long chunkSize,
+                            bool adaptiveChunk, int queueDepth,
+                            fsize_t bytesWritten = -1,
+                            const VerifyInfo* verify = NULL,
+                            const ThroughputInfo* throughput = NULL,
+                            const PackInfo* pack = NULL);
+
+    // Record a /dedup duplicate that was hardlinked to original (linked)
+    // or listed in DEDUP.LST instead of being copied
+    void logDuplicate(const char* source, const char* destination, const char* original,
+                      fsize_t fileSize, bool linked);
+
+    // Append a random I/O benchmark result to TRANSFER.LOG in directory
+    void logRandomIo(const char* directory, const RandomIoInfo& info);
 };
 
 #endif // LOGGER_H
\ No newline at end of file
@@ -0,0 +1,185 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "lzpack.h"
+
+const long LZ_MIN_MATCH = 4;
+
+// Matches stop this far from the end and the last bytes are always
+// literals, which keeps the decoder's checks simple
+const long LZ_END_LITERALS = 5;
+const long LZ_MATCH_MARGIN = 12;
+
+// Too small to be worth compressing
+const long LZ_MIN_BLOCK = 16;
+
+static unsigned hashAt(const unsigned char* p) {
+    unsigned long value = (unsigned long)p[0] | ((unsigned long)p[1] << 8) |
+                          ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+    return (unsigned)((((value * 2654435761UL) & 0xFFFFFFFFUL) >> (32 - LZ_HASH_BITS)) &
+                      (LZ_HASH_SIZE - 1));
+}
+
+// Length continuation bytes for counts of 15 and over
+static unsigned char* putLength(unsigned char* out, long length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+long lzPack(const unsigned char* in, long length, unsigned char* out, long capacity,
+            unsigned short* table) {
+    if (length < LZ_MIN_BLOCK || length > LZ_MAX_BLOCK) {
+        return -1;
+    }
+    for (int i = 0; i < LZ_HASH_SIZE; i++) {
+        table[i] = 0;
+    }
+
+    unsigned char* op = out;
+    unsigned char* outEnd = out + capacity;
+    long anchor = 0;
+    long pos = 0;
+    long matchStartLimit = length - LZ_MATCH_MARGIN;
+    long matchEndLimit = length - LZ_END_LITERALS;
+    long misses = 0;
+
+    while (pos < matchStartLimit) {
+        unsigned hash = hashAt(in + pos);
+        long candidate = table[hash];
+        table[hash] = (unsigned short)pos;
+
+        if (candidate >= pos || in[candidate] != in[pos] || in[candidate + 1] != in[pos + 1] ||
+            in[candidate + 2] != in[pos + 2] || in[candidate + 3] != in[pos + 3]) {
+            // Skip ahead faster the longer nothing matches, so data that
+            // won't compress goes by quickly
+            pos += 1 + (misses++ >> 5);
+            continue;
+        }
+        misses = 0;
+
+        long matchLength = LZ_MIN_MATCH;
+        while (pos + matchLength < matchEndLimit && in[candidate + matchLength] == in[pos + matchLength]) {
+            matchLength++;
+        }
+
+        // Worst case for this sequence: token, literals, their length
+        // bytes, offset and match length bytes
+        long literals = pos - anchor;
+        if (op + 1 + literals + literals / 255 + 2 + matchLength / 255 + 2 > outEnd) {
+            return -1;
+        }
+        unsigned char* token = op++;
+        long extraMatch = matchLength - LZ_MIN_MATCH;
+        *token = (unsigned char)(((literals < 15) ? literals : 15) << 4);
+        *token |= (unsigned char)((extraMatch < 15) ? extraMatch : 15);
+        if (literals >= 15) {
+            op = putLength(op, literals - 15);
+        }
+        memcpy(op, in + anchor, (size_t)literals);
+        op += literals;
+        unsigned offset = (unsigned)(pos - candidate);
+        *op++ = (unsigned char)(offset & 0xFF);
+        *op++ = (unsigned char)(offset >> 8);
+        if (extraMatch >= 15) {
+            op = putLength(op, extraMatch - 15);
+        }
+
+        pos += matchLength;
+        anchor = pos;
+    }
+
+    // Whatever is left goes out as literals
+    long literals = length - anchor;
+    if (op + 1 + literals + literals / 255 + 1 > outEnd) {
+        return -1;
+    }
+    *op++ = (unsigned char)(((literals < 15) ? literals : 15) << 4);
+    if (literals >= 15) {
+        op = putLength(op, literals - 15);
+    }
+    memcpy(op, in + anchor, (size_t)literals);
+    op += literals;
+
+    long packed = (long)(op - out);
+    return (packed < length) ? packed : -1;
+}
+
+// Read a continued length, false if the input runs out
+static bool getLength(const unsigned char*& ip, const unsigned char* end, long& length) {
+    unsigned char byte;
+    do {
+        if (ip >= end) {
+            return false;
+        }
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+long lzUnpack(const unsigned char* in, long length, unsigned char* out, long capacity) {
+    const unsigned char* ip = in;
+    const unsigned char* end = in + length;
+    unsigned char* op = out;
+    unsigned char* outEnd = out + capacity;
+
+    while (ip < end) {
+        unsigned token = *ip++;
+
+        long literals = token >> 4;
+        if (literals == 15 && !getLength(ip, end, literals)) {
+            return -1;
+        }
+        if (literals > end - ip || literals > outEnd - op) {
+            return -1;
+        }
+        memcpy(op, ip, (size_t)literals);
+        ip += literals;
+        op += literals;
+
+        if (ip == end) {
+            break;      // The last sequence has no match
+        }
+        if (end - ip < 2) {
+            return -1;
+        }
+        long offset = (long)ip[0] | ((long)ip[1] << 8);
+        ip += 2;
+        long matchLength = token & 15;
+        if (matchLength == 15 && !getLength(ip, end, matchLength)) {
+            return -1;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op - out || matchLength > outEnd - op) {
+            return -1;
+        }
+
+        // Byte by byte - the match may overlap what it is copying
+        const unsigned char* match = op - offset;
+        while (matchLength-- > 0) {
+            *op++ = *match++;
+        }
+    }
+    return (long)(op - out);
+}
@@ -0,0 +1,35 @@
+#ifndef LZPACK_H
+#define LZPACK_H
+
+#include "platform.h"
+
+// Small, fast LZ77 block codec for the packed container (packer.h).
+// Each block is compressed on its own, so any block can be decoded
+// without the ones before it. Byte-oriented and free of 64-bit or
+// unaligned access, so a block packed on Linux unpacks on DOS.
+//
+// A block is a run of sequences. Each sequence is a token byte (high
+// nibble literal count, low nibble match length minus 4; 15 means more
+// length bytes follow, each adding up to 255), the literals, then a
+// two-byte little-endian match offset and any extra match length bytes.
+// The last sequence has literals only.
+
+// Largest block the codec accepts. Offsets and the hash table hold
+// 16-bit positions, and DOS can't read() more than this in one go.
+const long LZ_MAX_BLOCK = 32256L;
+
+// Entries in the match-finder hash table
+const int LZ_HASH_BITS = 12;
+const int LZ_HASH_SIZE = 1 << LZ_HASH_BITS;
+
+// Compress length bytes of in to out. Returns the packed size, or -1 if
+// the block doesn't get smaller (store it as it is). table is scratch
+// space of LZ_HASH_SIZE entries.
+long lzPack(const unsigned char* in, long length, unsigned char* out, long capacity,
+            unsigned short* table);
+
+// Expand a packed block into out. Returns the unpacked size, or -1 if
+// the data is damaged or wouldn't fit in capacity.
+long lzUnpack(const unsigned char* in, long length, unsigned char* out, long capacity);
+
+#endif // LZPACK_H
@@ -20,19 +20,44 @@
  * Source: https://github.com/FDOS/xcopy/tree/master/source
  */
 
-#include <iostream.h>
-#include <string.h>
-#include <dos.h>
-#include <dir.h>
-#include <stdio.h>
+#include "platform.h"
 #include <ctype.h>
+#include <stdlib.h>
 #include "filecopy.h"
+#include "engine.h"
+#include "treecopy.h"
+#include "batch.h"
+#include "fileinfo.h"
+#include "journal.h"
+#include "verify.h"
+#include "logger.h"
+#include "bench.h"
+#include "randio.h"
+#include "progress.h"
+#include "limiter.h"
+#include "dedup.h"
+#include "trace.h"
 
 #define VERSION "0.6"
 
 // Flags for operation modes
 bool forceOverwrite = false;
 bool debugMode = false;  // New flag for debug mode
+const char* engineName = "auto";
+EngineOptions engineOptions;
+bool resumeMode = false;   // /resume - journal the copy so it can be continued
+bool deltaMode = false;    // /delta - rewrite only changed blocks of an existing file
+bool preallocMode = false; // /prealloc - reserve the destination's full size first
+bool verifyMode = false;   // /v - checksum the data while copying
+bool readBackMode = false; // /vr - also checksum the destination afterwards
+DigestType digestType = DEFAULT_DIGEST;
+bool treeMode = false;     // /s - copy a whole directory tree
+int treeWorkers = 4;
+long largeFileMB = 64;
+long limitRate = 0;        // /limit - bytes per second, 0 for full speed
+long limitBurst = 0;
+bool dedupMode = false;    // /dedup - write each distinct content once
+bool dedupKeep = false;    // /dedup:keep - index kept in the destination
 
 void showUsage(const char* programName) {
     cout << "FileCopy Utility v" << VERSION << endl;
@@ -41,59 +66,103 @@ void showUsage(const char* programName) {
     cout << "GitHub: https://github.com/danifunker/dos-file-test" << endl;
     cout << endl;
     cout << "Usage: " << programName << " <source_file> <destination_file> [options]" << endl;
+    cout << "       " << programName << " <source_file>... <directory> [options]" << endl;
+    cout << "       " << programName << " /bench <directory> [benchmark options]" << endl;
     cout << endl;
     cout << "Parameters:" << endl;
     cout << "  <source_file>      - Path to the file to be copied" << endl;
     cout << "  <destination_file> - Path where the file will be copied to" << endl;
+    cout << "  <source_file>...   - Several files, or wildcards (*.DAT), copied as one batch" << endl;
     cout << endl;
     cout << "Options:" << endl;
     cout << "  /y                 - Overwrite files without prompting" << endl;
     cout << "  /d                 - Show debug information" << endl;
+    cout << "  /q                 - No progress line (for batch jobs and slow terminals)" << endl;
+    cout << "  /e:<engine>        - Copy engine: ";
+    listEngines();
+    cout << endl;
+    cout << "  /p                 - Pipelined copy (same as /e:pipe)" << endl;
+    cout << "  /ring:<n>          - Buffers in the pipeline ring (default 4)" << endl;
+#ifdef FC_THREADS
+    cout << "  /qd:<n>            - Requests /e:async keeps in flight (default 8)" << endl;
+    cout << "  /stripe:<n>        - Copy n byte ranges of the file at once (same as /e:stripe)" << endl;
+#endif
+    cout << "  /pack              - Write a compressed container (same as /e:pack)" << endl;
+    cout << "  /unpack            - Expand a /pack container (same as /e:unpack)" << endl;
+    cout << "  /chunk:<KB>        - Chunk size in KB (default depends on engine)" << endl;
+    cout << "  /chunk:auto        - Tune the chunk size while copying" << endl;
+    cout << "  /mem:<KB>          - Largest chunk /chunk:auto may use" << endl;
+    cout << "  /resume            - Journal the copy; continue an interrupted one" << endl;
+    cout << "  /delta             - Rewrite only the parts of an existing file that changed" << endl;
+    cout << "  /prealloc          - Reserve the whole destination first (less fragmentation)" << endl;
+    cout << "  /v[:<alg>]         - Checksum while copying: crc32, crc32c";
+#ifdef FC_POSIX
+    cout << ", xxh64";
+#endif
+    cout << " (default " << digestName(DEFAULT_DIGEST) << ")" << endl;
+    cout << "  /vr                - Checksum, then read the destination back and compare" << endl;
+    cout << "  /s                 - Copy a directory and all its subdirectories" << endl;
+    cout << "  /t:<n>             - Worker threads for /s (default 4)" << endl;
+    cout << "  /big:<MB>          - Files this big get dedicated workers (default 64)" << endl;
+    cout << "  /dedup             - Copy identical files once; link or list the rest" << endl;
+    cout << "  /dedup:keep        - The same, remembering contents in DEDUP.IDX for next time" << endl;
+    cout << "  /limit:<rate>      - Cap bandwidth, in KB/s or with K/M suffix (e.g. 10M)" << endl;
+    cout << "  /burst:<size>      - Bytes /limit lets through at full speed (default 1/4 s)" << endl;
+    cout << "  /log:<format>      - Transfer log: text (TRANSFER.LOG), json or csv" << endl;
+    cout << "  /logmax:<KB>       - Rotate json/csv logs at this size" << endl;
+#ifdef FC_TRACE
+    cout << "  /trace:<file>      - Record opens, reads, writes and redraws as a Chrome trace" << endl;
+#endif
+    cout << endl;
+    cout << "Benchmark options:" << endl;
+    cout << "  /blocks:<KB,...>   - Block sizes to sweep" << endl;
+    cout << "  /files:<MB,...>    - Test file sizes to sweep" << endl;
+    cout << "  /trials:<n>        - Timed runs per test (default 3)" << endl;
+    cout << "  /e:<engine,...>    - Engines for the copy test (default rw)" << endl;
+    cout << "  /random            - Random read/write IOPS and latency instead" << endl;
+    cout << "  /io:<size>         - Bytes per random operation, K/M suffix allowed" << endl;
+#ifdef FC_THREADS
+    cout << "  /qd:<n>            - Random operations in flight (default 1)" << endl;
+#endif
+    cout << "  /time:<s>          - Seconds per random test (default 10)" << endl;
     cout << endl;
     cout << "Examples: " << endl;
     cout << "  " << programName << " C:\\DATA.TXT D:\\BACKUP.TXT" << endl;
     cout << "  " << programName << " DATA.TXT BACKUP.TXT" << endl;
     cout << "  " << programName << " ..\\SOURCE\\DATA.TXT ..\\DEST\\DATA.TXT /y" << endl;
-}
-
-// Function to check if a file exists
-bool fileExists(const char* filePath) {
-    FILE* file = fopen(filePath, "r");
-    if (file) {
-        fclose(file);
-        return true;
-    }
-    return false;
-}
-
-// Function to get file size
-long getFileSize(const char* filePath) {
-    FILE* file = fopen(filePath, "rb");
-    if (!file) return 0;
-    
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fclose(file);
-    return size;
+    cout << "  " << programName << " C:\\GAMES D:\\GAMES /s /y" << endl;
+    cout << "  " << programName << " C:\\DATA\\*.DAT D:\\BACKUP /y" << endl;
+    cout << "  " << programName << " C:\\DATA.DB A:\\DATA.FCP /pack" << endl;
+    cout << "  " << programName << " /bench D:\\ /blocks:4,32 /files:1,8" << endl;
+    cout << "  " << programName << " /bench D:\\ /random /io:512 /time:30" << endl;
 }
 
 // Function to format file size with MB and bytes
-void formatFileSize(long sizeInBytes, char* buffer) {
+void formatFileSize(fsize_t sizeInBytes, char* buffer) {
     // Calculate size in MB with 2 decimal places
     double sizeInMB = (double)sizeInBytes / (1024.0 * 1024.0);
-    sprintf(buffer, "%.2f MB [%ld bytes]", sizeInMB, sizeInBytes);
+    sprintf(buffer, "%.2f MB [" FSIZE_FORMAT " bytes]", sizeInMB, sizeInBytes);
 }
 
-// Function to prompt for file overwrite
-bool promptOverwrite(const char* filePath, const char* sourcePath) {
-    long destSize = getFileSize(filePath);
-    long sourceSize = getFileSize(sourcePath);
-    
+// One size for an option held in a long: parseSizeList() takes file
+// sizes, which can be wider
+bool parseLongSize(const char* text, long scale, long& value) {
+    fsize_t size;
+    if (parseSizeList(text, scale, &size, 1) != 1 || size > 0x7FFFFFFFL) {
+        return false;
+    }
+    value = (long)size;
+    return true;
+}
+
+// Function to prompt for file overwrite - the sizes come from the
+// lookups main() has already made
+bool promptOverwrite(const char* filePath, const FileInfo& destInfo, const FileInfo& sourceInfo) {
     char destSizeStr[50];
     char sourceSizeStr[50];
     
-    formatFileSize(destSize, destSizeStr);
-    formatFileSize(sourceSize, sourceSizeStr);
+    formatFileSize(destInfo.size, destSizeStr);
+    formatFileSize(sourceInfo.size, sourceSizeStr);
     
     cout << "File already exists: " << filePath << endl;
     cout << "Destination size: " << destSizeStr << endl;
@@ -114,14 +183,8 @@ bool promptOverwrite(const char* filePath, const char* sourcePath) {
 
 // Add this function to check if a path is a directory
 bool isDirectory(const char* path) {
-    struct ffblk fileInfo;
-    int result = findfirst(path, &fileInfo, FA_DIREC);
-    
-    if (result != 0) {
-        return false;  // Path doesn't exist or other error
-    }
-    
-    return (fileInfo.ff_attrib & FA_DIREC) != 0;
+    FileInfo info;
+    return statFile(path, info) && info.isDirectory();
 }
 
 // Add this function to extract the filename from a path
@@ -142,6 +205,183 @@ void extractFilename(const char* path, char* filename) {
     }
 }
 
+// Options whose value is a path, so it may hold more slashes
+static const char* const PATH_OPTIONS[] = { "/trace:", NULL };
+
+// Options start with '/'. On Linux so do absolute paths, so there an
+// option is a known path option or a single component that names
+// nothing on disk.
+bool isOptionArg(const char* arg) {
+    if (arg[0] != '/') {
+        return false;
+    }
+    for (int i = 0; PATH_OPTIONS[i] != NULL; i++) {
+        if (strnicmp(arg, PATH_OPTIONS[i], strlen(PATH_OPTIONS[i])) == 0) {
+            return true;
+        }
+    }
+#ifdef FC_POSIX
+    if (strchr(arg + 1, '/') != NULL || access(arg, 0) == 0) {
+        return false;
+    }
+#endif
+    return true;
+}
+
+// Prefix a relative path with the current directory
+void makeAbsolute(char* path) {
+    if (!isAbsolutePath(path)) {
+        char temp[MAXPATH];
+        getcwd(temp, MAXPATH);
+        strcat(temp, PATH_SEP_STR);
+        strcat(temp, path);
+        strcpy(path, temp);
+    }
+}
+
+// Apply the command line settings to a copier
+void configureCopier(FileCopy& fileCopy, RateLimiter* limiter) {
+    fileCopy.setDebugMode(debugMode);
+    fileCopy.setEngineName(engineName);
+    fileCopy.setEngineOptions(engineOptions);
+    fileCopy.setResume(resumeMode);
+    fileCopy.setDelta(deltaMode);
+    fileCopy.setPreallocate(preallocMode);
+    fileCopy.setVerify(verifyMode);
+    fileCopy.setDigestType(digestType);
+    fileCopy.setReadBack(readBackMode);
+    fileCopy.setLimiter(limiter);
+}
+
+// /bench <directory> [options] - sequential throughput sweep, or random
+// I/O with /random
+int runBenchmark(int argc, char* argv[]) {
+    // The directory is optional. Linux paths start with '/' like the
+    // options do, so tell them apart by the option syntax.
+    char directory[MAXPATH];
+    int firstOption = 2;
+    bool isOption = argc > 2 && (strchr(argv[2], ':') != NULL || stricmp(argv[2], "/d") == 0 ||
+                                 stricmp(argv[2], "/random") == 0) &&
+                    !isDirectory(argv[2]);
+    if (argc > 2 && !isOption) {
+        if (!isDirectory(argv[2])) {
+            cerr << "Error: Not a directory: " << argv[2] << endl;
+            return 1;
+        }
+        strcpy(directory, argv[2]);
+        firstOption = 3;
+    } else {
+        getcwd(directory, MAXPATH);
+    }
+
+    BenchOptions options;
+    RandomOptions randomOptions;
+    bool random = false;
+    bool filesGiven = false;
+    for (int i = firstOption; i < argc; i++) {
+        if (strnicmp(argv[i], "/blocks:", 8) == 0) {
+            fsize_t blockSizes[MAX_BENCH_SIZES];
+            options.blockCount = parseSizeList(argv[i] + 8, 1024L, blockSizes, MAX_BENCH_SIZES);
+            for (int b = 0; b < options.blockCount; b++) {
+                if (blockSizes[b] > MAX_CHUNK_SIZE) {
+                    options.blockCount = 0;
+                    break;
+                }
+                options.blockSizes[b] = (long)blockSizes[b];
+            }
+            if (options.blockCount == 0) {
+                cerr << "Error: Block sizes must be between 1 and "
+                     << MAX_CHUNK_SIZE / 1024L << " KB" << endl;
+                return 1;
+            }
+        }
+        else if (strnicmp(argv[i], "/files:", 7) == 0) {
+            options.fileCount = parseSizeList(argv[i] + 7, 1048576L, options.fileSizes, MAX_BENCH_SIZES);
+            if (options.fileCount == 0) {
+                cerr << "Error: Invalid file size list: " << argv[i] + 7 << endl;
+                return 1;
+            }
+            filesGiven = true;
+        }
+        else if (strnicmp(argv[i], "/trials:", 8) == 0) {
+            options.trials = atoi(argv[i] + 8);
+            if (options.trials < 1 || options.trials > 32) {
+                cerr << "Error: Trials must be between 1 and 32" << endl;
+                return 1;
+            }
+        }
+        else if (strnicmp(argv[i], "/e:", 3) == 0) {
+            options.engineCount = parseNameList(argv[i] + 3, options.engineNames, MAX_BENCH_ENGINES);
+            if (options.engineCount == 0) {
+                cerr << "Error: Invalid engine list: " << argv[i] + 3 << endl;
+                return 1;
+            }
+        }
+        else if (stricmp(argv[i], "/d") == 0) {
+            debugMode = true;
+        }
+        else if (stricmp(argv[i], "/random") == 0) {
+            random = true;
+        }
+        else if (strnicmp(argv[i], "/io:", 4) == 0) {
+            if (!parseLongSize(argv[i] + 4, 1L, randomOptions.ioSize) ||
+                randomOptions.ioSize > MAX_CHUNK_SIZE) {
+                cerr << "Error: Invalid random I/O size: " << argv[i] + 4 << endl;
+                return 1;
+            }
+        }
+        else if (strnicmp(argv[i], "/qd:", 4) == 0) {
+            randomOptions.queueDepth = atoi(argv[i] + 4);
+#ifdef FC_THREADS
+            if (randomOptions.queueDepth < 1 || randomOptions.queueDepth > 64) {
+                cerr << "Error: Queue depth must be between 1 and 64" << endl;
+                return 1;
+            }
+            // Also the depth for /e:async in the copy test
+            options.engineOptions.queueDepth = randomOptions.queueDepth;
+#else
+            if (randomOptions.queueDepth != 1) {
+                cerr << "Error: Only queue depth 1 is supported on this platform" << endl;
+                return 1;
+            }
+#endif
+        }
+        else if (strnicmp(argv[i], "/time:", 6) == 0) {
+            randomOptions.seconds = atoi(argv[i] + 6);
+            if (randomOptions.seconds < 1 || randomOptions.seconds > 3600) {
+                cerr << "Error: Time must be between 1 and 3600 seconds" << endl;
+                return 1;
+            }
+        }
+    }
+
+    if (random) {
+        if (filesGiven) {
+            randomOptions.fileSize = options.fileSizes[0];
+        }
+        if (randomOptions.fileSize < randomOptions.ioSize) {
+            cerr << "Error: Test file is smaller than one random I/O" << endl;
+            return 1;
+        }
+        RandomBenchmark benchmark(directory, randomOptions);
+        benchmark.setDebugMode(debugMode);
+        return benchmark.run() ? 0 : 1;
+    }
+
+    for (int e = 0; e < options.engineCount; e++) {
+        CopyEngine* probe = createEngine(options.engineNames[e], options.engineOptions);
+        if (probe == NULL) {
+            cerr << "Error: Unknown copy engine: " << options.engineNames[e] << endl;
+            return 1;
+        }
+        delete probe;
+    }
+
+    Benchmark benchmark(directory, options);
+    benchmark.setDebugMode(debugMode);
+    return benchmark.run() ? 0 : 1;
+}
+
 // Modify the main function to handle directory destinations
 int main(int argc, char* argv[]) {
     cout << "FileCopy Utility v" << VERSION << endl;
@@ -152,84 +392,367 @@ int main(int argc, char* argv[]) {
     char destinationPath[MAXPATH] = {0};
     char finalDestPath[MAXPATH] = {0};  // Will store the final destination path
 
+    if (argc >= 2 && stricmp(argv[1], "/bench") == 0) {
+        return runBenchmark(argc, argv);
+    }
+
     // Process command line arguments
     if (argc < 3) {
         showUsage(argv[0]);
         return 1;
     }
     
+    // Everything before the first option is a path; the last of them is
+    // the destination and any before it are sources
+    int pathCount = 1;
+    while (pathCount < argc && !isOptionArg(argv[pathCount])) {
+        pathCount++;
+    }
+    int sourceCount = pathCount - 2;
+    if (sourceCount < 1) {
+        showUsage(argv[0]);
+        return 1;
+    }
+    bool batchMode = sourceCount > 1 || hasWildcard(argv[1]);
+    
     // Copy arguments to our buffers
     strcpy(sourcePath, argv[1]);
-    strcpy(destinationPath, argv[2]);
+    strcpy(destinationPath, argv[pathCount - 1]);
     
     // Check for flags
-    for (int i = 3; i < argc; i++) {
+    for (int i = pathCount; i < argc; i++) {
         if (stricmp(argv[i], "/y") == 0) {
             forceOverwrite = true;
         }
         else if (stricmp(argv[i], "/d") == 0) {
             debugMode = true;
         }
+        else if (stricmp(argv[i], "/q") == 0) {
+            Progress::setQuietMode(true);
+        }
+        else if (strnicmp(argv[i], "/e:", 3) == 0) {
+            engineName = argv[i] + 3;
+        }
+        else if (stricmp(argv[i], "/p") == 0) {
+            engineName = "pipe";
+        }
+        else if (stricmp(argv[i], "/pack") == 0) {
+            engineName = "pack";
+        }
+        else if (stricmp(argv[i], "/unpack") == 0) {
+            engineName = "unpack";
+        }
+        else if (strnicmp(argv[i], "/ring:", 6) == 0) {
+            engineOptions.ringDepth = atoi(argv[i] + 6);
+            if (engineOptions.ringDepth < 2 || engineOptions.ringDepth > 64) {
+                cerr << "Error: Ring depth must be between 2 and 64" << endl;
+                return 1;
+            }
+        }
+#ifdef FC_THREADS
+        else if (strnicmp(argv[i], "/stripe:", 8) == 0) {
+            engineName = "stripe";
+            engineOptions.stripes = atoi(argv[i] + 8);
+            if (engineOptions.stripes < 2 || engineOptions.stripes > 64) {
+                cerr << "Error: Stripe count must be between 2 and 64" << endl;
+                return 1;
+            }
+        }
+        else if (strnicmp(argv[i], "/qd:", 4) == 0) {
+            engineOptions.queueDepth = atoi(argv[i] + 4);
+            if (engineOptions.queueDepth < 1 || engineOptions.queueDepth > 64) {
+                cerr << "Error: Queue depth must be between 1 and 64" << endl;
+                return 1;
+            }
+        }
+#endif
+        else if (stricmp(argv[i], "/chunk:auto") == 0) {
+            engineOptions.adaptiveChunk = true;
+        }
+        else if (strnicmp(argv[i], "/chunk:", 7) == 0) {
+            long chunkKB = atol(argv[i] + 7);
+            if (chunkKB < 1 || chunkKB * 1024L > MAX_CHUNK_SIZE) {
+                cerr << "Error: Chunk size must be between 1 and "
+                     << MAX_CHUNK_SIZE / 1024L << " KB" << endl;
+                return 1;
+            }
+            engineOptions.chunkSize = chunkKB * 1024L;
+        }
+        else if (strnicmp(argv[i], "/mem:", 5) == 0) {
+            long budgetKB = atol(argv[i] + 5);
+            if (budgetKB < 4 || budgetKB * 1024L > MAX_CHUNK_SIZE) {
+                cerr << "Error: Memory budget must be between 4 and "
+                     << MAX_CHUNK_SIZE / 1024L << " KB" << endl;
+                return 1;
+            }
+            engineOptions.memoryBudget = budgetKB * 1024L;
+        }
+        else if (stricmp(argv[i], "/resume") == 0) {
+            resumeMode = true;
+        }
+        else if (stricmp(argv[i], "/delta") == 0) {
+            deltaMode = true;
+        }
+        else if (stricmp(argv[i], "/prealloc") == 0) {
+            preallocMode = true;
+        }
+        else if (stricmp(argv[i], "/v") == 0) {
+            verifyMode = true;
+        }
+        else if (strnicmp(argv[i], "/v:", 3) == 0) {
+            verifyMode = true;
+            if (!digestFromName(argv[i] + 3, digestType)) {
+                cerr << "Error: Unknown checksum: " << argv[i] + 3 << endl;
+                return 1;
+            }
+        }
+        else if (stricmp(argv[i], "/vr") == 0) {
+            verifyMode = true;
+            readBackMode = true;
+        }
+        else if (stricmp(argv[i], "/s") == 0) {
+            treeMode = true;
+        }
+        else if (strnicmp(argv[i], "/t:", 3) == 0) {
+            treeWorkers = atoi(argv[i] + 3);
+            if (treeWorkers < 1 || treeWorkers > 64) {
+                cerr << "Error: Worker count must be between 1 and 64" << endl;
+                return 1;
+            }
+        }
+        else if (strnicmp(argv[i], "/big:", 5) == 0) {
+            largeFileMB = atol(argv[i] + 5);
+            if (largeFileMB < 1) {
+                cerr << "Error: Large file threshold must be at least 1 MB" << endl;
+                return 1;
+            }
+        }
+        else if (stricmp(argv[i], "/dedup") == 0) {
+            dedupMode = true;
+        }
+        else if (stricmp(argv[i], "/dedup:keep") == 0) {
+            dedupMode = true;
+            dedupKeep = true;
+        }
+        else if (strnicmp(argv[i], "/limit:", 7) == 0) {
+            if (!parseLongSize(argv[i] + 7, 1024L, limitRate)) {
+                cerr << "Error: Invalid bandwidth limit: " << argv[i] + 7 << endl;
+                return 1;
+            }
+        }
+        else if (strnicmp(argv[i], "/burst:", 7) == 0) {
+            if (!parseLongSize(argv[i] + 7, 1024L, limitBurst)) {
+                cerr << "Error: Invalid burst size: " << argv[i] + 7 << endl;
+                return 1;
+            }
+        }
+        else if (strnicmp(argv[i], "/log:", 5) == 0) {
+            if (stricmp(argv[i] + 5, "text") == 0) {
+                Logger::setFormat(LOG_TEXT);
+            } else if (stricmp(argv[i] + 5, "json") == 0) {
+                Logger::setFormat(LOG_JSON);
+            } else if (stricmp(argv[i] + 5, "csv") == 0) {
+                Logger::setFormat(LOG_CSV);
+            } else {
+                cerr << "Error: Log format must be text, json or csv" << endl;
+                return 1;
+            }
+        }
+        else if (strnicmp(argv[i], "/logmax:", 8) == 0) {
+            long maxKB = atol(argv[i] + 8);
+            if (maxKB < 1 || maxKB > 1048576L) {
+                cerr << "Error: Log size must be between 1 and 1048576 KB" << endl;
+                return 1;
+            }
+            Logger::setMaxSize(maxKB * 1024L);
+        }
+        else if (strnicmp(argv[i], "/trace:", 7) == 0) {
+#ifdef FC_TRACE
+            if (!traceStart(argv[i] + 7)) {
+                cerr << "Error: Not enough memory for the trace buffer" << endl;
+                return 1;
+            }
+#else
+            cerr << "Error: /trace needs a build with FC_TRACE (make -f makefile.lnx TRACE=1)" << endl;
+            return 1;
+#endif
+        }
+    }
+    
+    // Make sure the requested engine exists in this build
+    CopyEngine* probe = createEngine(engineName, engineOptions);
+    if (probe == NULL) {
+        cerr << "Error: Unknown copy engine: " << engineName << endl;
+        return 1;
+    }
+    delete probe;
+    
+    // A container's offsets don't match the file it holds
+    if ((stricmp(engineName, "pack") == 0 || stricmp(engineName, "unpack") == 0) &&
+        (resumeMode || deltaMode || preallocMode)) {
+        cerr << "Error: /resume, /delta and /prealloc can't be used with /pack or /unpack" << endl;
+        return 1;
+    }
+    
+    // Duplicates are found among the files of one tree or batch
+    if (dedupMode && !treeMode && !batchMode) {
+        cerr << "Error: /dedup needs /s or several source files" << endl;
+        return 1;
+    }
+    if (dedupMode && (deltaMode || stricmp(engineName, "pack") == 0 ||
+                      stricmp(engineName, "unpack") == 0)) {
+        cerr << "Error: /dedup can't be used with /delta, /pack or /unpack" << endl;
+        return 1;
+    }
+    
+    // Shared by every copier, so /s workers split the bandwidth
+    RateLimiter rateLimiter(limitRate > 0 ? limitRate : 1L, limitBurst);
+    RateLimiter* limiter = NULL;
+    if (limitRate > 0) {
+        limiter = &rateLimiter;
+        if (debugMode) {
+            char rateStr[20];
+            formatSpeed(limiter->getRate(), rateStr);
+            cout << "[DEBUG] Limit: " << rateStr << ", burst " << limiter->getBurst() << " bytes" << endl;
+        }
     }
     
     // Get absolute paths if needed
-    if (sourcePath[0] != '\\' && sourcePath[1] != ':') {
-        char temp[MAXPATH];
-        getcwd(temp, MAXPATH);
-        strcat(temp, "\\");
-        strcat(temp, sourcePath);
-        strcpy(sourcePath, temp);
+    makeAbsolute(sourcePath);
+    makeAbsolute(destinationPath);
+    
+    // One content index for the whole tree or batch
+    DedupIndex dedupIndex(destinationPath);
+    DedupIndex* dedup = NULL;
+    if (dedupMode) {
+        dedup = &dedupIndex;
+        if (dedupKeep) {
+            dedup->load();
+        }
     }
     
-    if (destinationPath[0] != '\\' && destinationPath[1] != ':') {
-        char temp[MAXPATH];
-        getcwd(temp, MAXPATH);
-        strcat(temp, "\\");
-        strcat(temp, destinationPath);
-        strcpy(destinationPath, temp);
+    // A batch copies every source into one existing directory
+    if (batchMode) {
+        if (treeMode) {
+            cerr << "Error: /s takes a single source directory" << endl;
+            return 1;
+        }
+        if (!isDirectory(destinationPath)) {
+            cerr << "Error: Destination must be a directory: " << destinationPath << endl;
+            return 1;
+        }
+        
+        BatchCopy batch;
+        batch.setOverwrite(forceOverwrite);
+        batch.setDebugMode(debugMode);
+        configureCopier(batch.getCopier(), limiter);
+        batch.getCopier().setDedup(dedup);
+        for (int i = 1; i <= sourceCount; i++) {
+            char pattern[MAXPATH];
+            strcpy(pattern, argv[i]);
+            makeAbsolute(pattern);
+            if (!batch.addSource(pattern)) {
+                cerr << "Warning: No files match: " << argv[i] << endl;
+            }
+        }
+        if (batch.getCount() == 0) {
+            cerr << "Error: Nothing to copy" << endl;
+            return 1;
+        }
+        
+        cout << "Files: " << batch.getCount() << endl;
+        cout << "Destination: " << destinationPath << endl;
+        cout << endl;
+        
+        bool ok = batch.run(destinationPath);
+        if (dedupKeep && !dedup->save()) {
+            ok = false;
+        }
+        
+        cout << "File transfer operation completed." << endl;
+        return ok ? 0 : 1;
+    }
+    
+    // Tree mode copies the contents of the source directory into the
+    // destination directory, creating it if needed
+    if (treeMode) {
+        if (!isDirectory(sourcePath)) {
+            cerr << "Error: Source is not a directory: " << sourcePath << endl;
+            return 1;
+        }
+        
+        cout << "Source: " << sourcePath << endl;
+        cout << "Destination: " << destinationPath << endl;
+        cout << endl;
+        
+        TreeCopy treeCopy;
+        treeCopy.setWorkers(treeWorkers);
+        treeCopy.setLargeFileThreshold(largeFileMB * 1024L * 1024L);
+        treeCopy.setOverwrite(forceOverwrite);
+        treeCopy.setDebugMode(debugMode);
+        configureCopier(treeCopy.getCopier(), limiter);
+        treeCopy.getCopier().setDedup(dedup);
+        bool ok = treeCopy.copyTree(sourcePath, destinationPath);
+        if (dedupKeep && !dedup->save()) {
+            ok = false;
+        }
+        
+        cout << "File transfer operation completed." << endl;
+        return ok ? 0 : 1;
     }
     
-    // Check if source file exists
-    if (!fileExists(sourcePath)) {
+    // Check if source file exists. One lookup each for the source and
+    // the destination; everything below reuses them.
+    FileInfo sourceInfo;
+    if (!statFile(sourcePath, sourceInfo)) {
         cerr << "Error: Source file does not exist: " << sourcePath << endl;
         return 1;
     }
+    if (sourceInfo.isDirectory()) {
+        cerr << "Error: Source is a directory (use /s): " << sourcePath << endl;
+        return 1;
+    }
     
     // Check if destination is a directory
     strcpy(finalDestPath, destinationPath);  // Start with the provided destination
+    FileInfo destInfo;
+    statFile(destinationPath, destInfo);
     
-    if (isDirectory(destinationPath)) {
+    if (destInfo.isDirectory()) {
         char sourceFilename[MAXPATH];
         extractFilename(sourcePath, sourceFilename);
         
         // Ensure destination path ends with a backslash
         int destLen = strlen(destinationPath);
         if (destinationPath[destLen-1] != '\\' && destinationPath[destLen-1] != '/') {
-            strcat(finalDestPath, "\\");
+            strcat(finalDestPath, PATH_SEP_STR);
         }
         
         // Append the source filename to the destination directory
         strcat(finalDestPath, sourceFilename);
         
         cout << "Destination is a directory, using: " << finalDestPath << endl;
+        statFile(finalDestPath, destInfo);
     }
     
     cout << "Source: " << sourcePath << endl;
     cout << "Destination: " << finalDestPath << endl;
     cout << endl;
     
-    // Check if destination file exists and prompt for overwrite if needed
-    if (fileExists(finalDestPath) && !forceOverwrite) {
-        if (!promptOverwrite(finalDestPath, sourcePath)) {
+    // Check if destination file exists and prompt for overwrite if needed.
+    // A partial copy with a journal is continued rather than overwritten.
+    bool resuming = resumeMode && CopyJournal::exists(finalDestPath);
+    if (destInfo.exists() && !forceOverwrite && !resuming) {
+        if (!promptOverwrite(finalDestPath, destInfo, sourceInfo)) {
             cout << "Copy operation cancelled." << endl;
             return 0;
         }
     }
 
     FileCopy fileCopy;
-    fileCopy.setDebugMode(debugMode);  // Pass debug mode to FileCopy
-    fileCopy.copyFile(sourcePath, finalDestPath);
+    configureCopier(fileCopy, limiter);
+    bool ok = fileCopy.copyFile(sourcePath, finalDestPath, &sourceInfo);
     
     cout << "File transfer operation completed." << endl;
-    return 0;
+    return ok ? 0 : 1;
 }
\ No newline at end of file
@@ -0,0 +1,353 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "packer.h"
+#include "lzpack.h"
+#include "checksum.h"
+#include "byteio.h"
+#include "logger.h"
+
+// Raw bytes per frame - the same on every platform, so a file packed on
+// Linux unpacks on DOS
+const long PACK_BLOCK_SIZE = LZ_MAX_BLOCK;
+
+const long PACK_HEADER_SIZE = 16;
+const long FRAME_HEADER_SIZE = 12;
+const unsigned char PACK_VERSION = 1;
+
+// Biggest frame buffer: the header, a stored block and the end frame
+const long FRAME_CAPACITY = PACK_HEADER_SIZE + PACK_BLOCK_SIZE + 2 * FRAME_HEADER_SIZE;
+
+// Frames queued between the packing thread and the writer
+#ifdef FC_THREADS
+const int PACK_FRAME_DEPTH = 4;
+#else
+const int PACK_FRAME_DEPTH = 1;
+#endif
+
+// Read until length bytes or end of file. Returns the count, -1 on error.
+static long readFull(int handle, char* buffer, long length) {
+    long got = 0;
+    while (got < length) {
+        int n = read(handle, buffer + got, (unsigned)(length - got));
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        got += n;
+    }
+    return got;
+}
+
+PackEngine::PackEngine(bool unpack)
+    : m_unpack(unpack), m_started(false), m_finished(false), m_failed(false),
+      m_originalSize(0), m_rawBytes(0), m_packedBytes(0), m_blockIndex(0),
+      m_sourceHandle(-1), m_depth(PACK_FRAME_DEPTH)
+#ifdef FC_THREADS
+      , m_head(0), m_tail(0), m_filled(0), m_producerDone(false), m_stop(false)
+#endif
+{
+    m_input = new char[PACK_BLOCK_SIZE];
+    m_table = new unsigned short[LZ_HASH_SIZE];
+    m_frames = new Frame[m_depth];
+    for (int i = 0; i < m_depth; i++) {
+        m_frames[i].data = new char[FRAME_CAPACITY];
+        m_frames[i].length = 0;
+        m_frames[i].consumed = 0;
+    }
+}
+
+PackEngine::~PackEngine() {
+    end();
+    for (int i = 0; i < m_depth; i++) {
+        delete[] m_frames[i].data;
+    }
+    delete[] m_frames;
+    delete[] m_table;
+    delete[] m_input;
+}
+
+long PackEngine::getChunkSize() const {
+    return PACK_BLOCK_SIZE;
+}
+
+// Next block of the source as a frame, with the header in front of the
+// first and the end frame after the last
+bool PackEngine::packNext(Frame& frame) {
+    unsigned char* out = (unsigned char*)frame.data;
+    long length = 0;
+    if (!m_started) {
+        memcpy(out, "FCPK", 4);
+        out[4] = PACK_VERSION;
+        out[5] = out[6] = out[7] = 0;
+        putSize(out + 8, m_originalSize);
+        length = PACK_HEADER_SIZE;
+        m_started = true;
+    }
+
+    long got = readFull(m_sourceHandle, m_input, PACK_BLOCK_SIZE);
+    if (got < 0) {
+        return false;
+    }
+    if (got > 0) {
+        unsigned char* payload = out + length + FRAME_HEADER_SIZE;
+        long stored = lzPack((const unsigned char*)m_input, got, payload, PACK_BLOCK_SIZE, m_table);
+        if (stored < 0) {
+            memcpy(payload, m_input, (size_t)got);
+            stored = got;
+        }
+        putValue(out + length, (unsigned long)got, 4);
+        putValue(out + length + 4, (unsigned long)stored, 4);
+        putValue(out + length + 8, crc32Final(crc32Update(CRC32_INIT, m_input, got)), 4);
+        length += FRAME_HEADER_SIZE + stored;
+        m_rawBytes += got;
+        m_blockIndex++;
+    }
+
+    if (got < PACK_BLOCK_SIZE) {
+        // The header promised m_originalSize bytes
+        if (m_rawBytes != m_originalSize) {
+            cerr << "Error: Source changed size while packing" << endl;
+            return false;
+        }
+        memset(out + length, 0, (size_t)FRAME_HEADER_SIZE);
+        length += FRAME_HEADER_SIZE;
+        m_finished = true;
+    }
+
+    frame.length = length;
+    frame.consumed = got;
+    m_packedBytes += length;
+    return true;
+}
+
+// Next frame of the container, expanded
+bool PackEngine::unpackNext(Frame& frame) {
+    unsigned char header[PACK_HEADER_SIZE];
+    long consumed = 0;
+    if (!m_started) {
+        if (readFull(m_sourceHandle, (char*)header, PACK_HEADER_SIZE) != PACK_HEADER_SIZE ||
+            memcmp(header, "FCPK", 4) != 0 || header[4] != PACK_VERSION) {
+            cerr << "Error: Not a packed file (see /pack)" << endl;
+            return false;
+        }
+        m_originalSize = getSize(header + 8);
+        consumed = PACK_HEADER_SIZE;
+        m_started = true;
+    }
+
+    if (readFull(m_sourceHandle, (char*)header, FRAME_HEADER_SIZE) != FRAME_HEADER_SIZE) {
+        cerr << "Error: Packed file ends early, after block " << m_blockIndex << endl;
+        return false;
+    }
+    long raw = (long)getValue(header, 4);
+    long stored = (long)getValue(header + 4, 4);
+    unsigned long crc = getValue(header + 8, 4);
+    consumed += FRAME_HEADER_SIZE;
+
+    if (raw == 0) {
+        if (stored != 0 || m_rawBytes != m_originalSize) {
+            cerr << "Error: Packed file is damaged - expected " << m_originalSize
+                 << " bytes, found " << m_rawBytes << endl;
+            return false;
+        }
+        m_finished = true;
+        frame.length = 0;
+    } else {
+        if (raw < 0 || raw > PACK_BLOCK_SIZE || stored <= 0 || stored > raw) {
+            cerr << "Error: Packed file is damaged at block " << m_blockIndex + 1 << endl;
+            return false;
+        }
+
+        // A stored block goes straight into the frame
+        char* target = (stored == raw) ? frame.data : m_input;
+        if (readFull(m_sourceHandle, target, stored) != stored) {
+            cerr << "Error: Packed file ends early, in block " << m_blockIndex + 1 << endl;
+            return false;
+        }
+        if (stored < raw &&
+            lzUnpack((const unsigned char*)m_input, stored, (unsigned char*)frame.data, raw) != raw) {
+            cerr << "Error: Packed file is damaged at block " << m_blockIndex + 1 << endl;
+            return false;
+        }
+        if (crc32Final(crc32Update(CRC32_INIT, frame.data, raw)) != crc) {
+            cerr << "Error: Checksum mismatch in packed block " << m_blockIndex + 1 << endl;
+            return false;
+        }
+        consumed += stored;
+        frame.length = raw;
+        m_rawBytes += raw;
+        m_blockIndex++;
+    }
+
+    frame.consumed = consumed;
+    m_packedBytes += consumed;
+    return true;
+}
+
+// Fill a frame. Both counts zero means there is nothing left.
+bool PackEngine::produce(Frame& frame) {
+    if (m_finished) {
+        frame.length = 0;
+        frame.consumed = 0;
+        return true;
+    }
+    return m_unpack ? unpackNext(frame) : packNext(frame);
+}
+
+bool PackEngine::writeFrame(int destHandle, const Frame& frame) {
+    long written = 0;
+    while (written < frame.length) {
+        int n = write(destHandle, frame.data + written, (unsigned)(frame.length - written));
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    if (m_sink && frame.length > 0) {
+        m_sink->onData(frame.data, frame.length);
+    }
+    return true;
+}
+
+#ifdef FC_THREADS
+
+void* PackEngine::producerEntry(void* arg) {
+    ((PackEngine*)arg)->producerLoop();
+    return NULL;
+}
+
+// Packing stage: read and (un)pack into free frames while the caller
+// writes the filled ones
+void PackEngine::producerLoop() {
+    for (;;) {
+        int slot;
+        {
+            ScopedLock lock(m_lock);
+            while (m_filled == m_depth && !m_stop) {
+                m_frameFreed.wait(m_lock);
+            }
+            if (m_stop) {
+                return;
+            }
+            slot = m_head;
+        }
+
+        Frame& frame = m_frames[slot];
+        bool ok = produce(frame);
+
+        ScopedLock lock(m_lock);
+        if (!ok) {
+            m_failed = true;
+        }
+        if (!ok || (frame.length == 0 && frame.consumed == 0)) {
+            m_producerDone = true;
+            m_frameFilled.signal();
+            return;
+        }
+        m_head = (m_head + 1) % m_depth;
+        m_filled++;
+        m_frameFilled.signal();
+    }
+}
+
+#endif // FC_THREADS
+
+bool PackEngine::begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+    (void)destHandle;
+    end();
+    m_sourceHandle = sourceHandle;
+    m_originalSize = m_unpack ? 0 : fileSize;
+    m_started = m_finished = m_failed = false;
+    m_rawBytes = m_packedBytes = 0;
+    m_blockIndex = 0;
+#ifdef FC_THREADS
+    m_head = m_tail = m_filled = 0;
+    m_producerDone = m_stop = false;
+    return m_producer.start(producerEntry, this);
+#else
+    return true;
+#endif
+}
+
+long PackEngine::copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+    (void)sourceHandle;
+    (void)maxBytes;
+
+#ifdef FC_THREADS
+    int slot;
+    {
+        ScopedLock lock(m_lock);
+        while (m_filled == 0 && !m_producerDone) {
+            m_frameFilled.wait(m_lock);
+        }
+        if (m_filled == 0) {
+            return m_failed ? -1 : 0;
+        }
+        slot = m_tail;
+    }
+
+    const Frame& frame = m_frames[slot];
+    if (!writeFrame(destHandle, frame)) {
+        ScopedLock lock(m_lock);
+        m_stop = true;
+        m_frameFreed.signal();
+        return -1;
+    }
+    long consumed = frame.consumed;
+
+    ScopedLock lock(m_lock);
+    m_tail = (m_tail + 1) % m_depth;
+    m_filled--;
+    m_frameFreed.signal();
+    return consumed;
+#else
+    Frame& frame = m_frames[0];
+    if (!produce(frame)) {
+        m_failed = true;
+        return -1;
+    }
+    if (!writeFrame(destHandle, frame)) {
+        return -1;
+    }
+    return frame.consumed;
+#endif
+}
+
+void PackEngine::end() {
+#ifdef FC_THREADS
+    {
+        ScopedLock lock(m_lock);
+        m_stop = true;
+        m_frameFreed.signal();
+    }
+    m_producer.join();
+#endif
+}
+
+bool PackEngine::getPackInfo(PackInfo& info) const {
+    info.mode = getName();
+    info.rawBytes = m_rawBytes;
+    info.packedBytes = m_packedBytes;
+    info.logicalRate = 0;
+    return true;
+}
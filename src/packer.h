@@ -0,0 +1,88 @@
+#ifndef PACKER_H
+#define PACKER_H
+
+#include "engine.h"
+#include "fcthread.h"
+
+// Packed container for slow destinations (floppies, Zip drives, network
+// redirectors), where bytes written cost far more than CPU time:
+//
+//   header  "FCPK", version, 3 reserved bytes, original size (8 bytes)
+//   frames  raw size (4), stored size (4), CRC-32 of the raw data (4),
+//           then the data - LZ-packed (lzpack.h), or as it was if
+//           stored size equals raw size
+//   end     a frame with raw size 0
+//
+// Numbers are little-endian. Frames are independent, so damage stays
+// within one block and the CRC says which.
+//
+// "pack" (/pack) writes the container while copying, "unpack" (/unpack)
+// reads one back. Either way copyChunk() returns source bytes, so the
+// progress line follows the file being read. On Linux a second thread
+// reads and (un)packs the next blocks while the caller writes.
+class PackEngine : public CopyEngine {
+private:
+    struct Frame {
+        char* data;         // Bytes to write
+        long length;
+        long consumed;      // Source bytes they stand for
+    };
+
+    bool m_unpack;
+    char* m_input;          // Raw block (pack) or stored frame (unpack)
+    unsigned short* m_table;
+    bool m_started;         // Header handled
+    bool m_finished;        // End frame handled
+    bool m_failed;
+    fsize_t m_originalSize;
+    fsize_t m_rawBytes;     // Uncompressed bytes so far
+    fsize_t m_packedBytes;  // Container bytes so far
+    long m_blockIndex;
+    int m_sourceHandle;
+
+    Frame* m_frames;
+    int m_depth;
+#ifdef FC_THREADS
+    // Ring of frames between the packing thread and the writer, as in
+    // PipelineEngine; guarded by m_lock
+    int m_head;
+    int m_tail;
+    int m_filled;
+    bool m_producerDone;
+    bool m_stop;
+    Mutex m_lock;
+    Condition m_frameFilled;
+    Condition m_frameFreed;
+    Thread m_producer;
+
+    static void* producerEntry(void* arg);
+    void producerLoop();
+#endif
+
+    bool produce(Frame& frame);
+    bool packNext(Frame& frame);
+    bool unpackNext(Frame& frame);
+    bool writeFrame(int destHandle, const Frame& frame);
+
+    // Not copyable
+    PackEngine(const PackEngine&);
+    PackEngine& operator=(const PackEngine&);
+
+public:
+    PackEngine(bool unpack);
+    virtual ~PackEngine();
+
+    virtual const char* getName() const { return m_unpack ? "unpack" : "pack"; }
+    virtual long getChunkSize() const;
+    virtual bool canResizeChunks() const { return false; }
+    virtual bool passesData() const { return true; }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize);
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes);
+    virtual void end();
+
+    // Counted by the engine's own thread - complete after end()
+    virtual bool getPackInfo(PackInfo& info) const;
+};
+
+#endif // PACKER_H
@@ -0,0 +1,165 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "pipeline.h"
+#include "trace.h"
+
+#ifdef FC_THREADS
+
+PipelineEngine::PipelineEngine(int ringDepth, long chunkSize)
+    : m_slots(NULL), m_depth(ringDepth), m_chunkSize(chunkSize),
+      m_head(0), m_tail(0), m_filled(0),
+      m_eof(false), m_readError(false), m_stop(false),
+      m_sourceHandle(-1) {
+    // Preallocate the whole ring up front - nothing is allocated per chunk
+    m_slots = new Slot[m_depth];
+    for (int i = 0; i < m_depth; i++) {
+        m_slots[i].data = new char[m_chunkSize];
+        m_slots[i].length = 0;
+    }
+}
+
+PipelineEngine::~PipelineEngine() {
+    end();
+    for (int i = 0; i < m_depth; i++) {
+        delete[] m_slots[i].data;
+    }
+    delete[] m_slots;
+}
+
+void* PipelineEngine::readerEntry(void* arg) {
+    ((PipelineEngine*)arg)->readerLoop();
+    return NULL;
+}
+
+// Reader stage: fill free slots until end of file, an error, or stop
+void PipelineEngine::readerLoop() {
+    for (;;) {
+        int slot;
+        {
+            ScopedLock lock(m_lock);
+            while (m_filled == m_depth && !m_stop) {
+                m_slotFreed.wait(m_lock);
+            }
+            if (m_stop) {
+                return;
+            }
+            slot = m_head;
+        }
+
+        // Fill the slot outside the lock so the writer keeps going
+        char* data = m_slots[slot].data;
+        long length = 0;
+        bool failed = false;
+        while (length < m_chunkSize) {
+            TRACE_START(readStart);
+            ssize_t got = read(m_sourceHandle, data + length, (size_t)(m_chunkSize - length));
+            TRACE_END(TRACE_READ, readStart, got);
+            if (got < 0) {
+                failed = true;
+                break;
+            }
+            if (got == 0) {
+                break;
+            }
+            length += (long)got;
+        }
+
+        ScopedLock lock(m_lock);
+        if (failed) {
+            m_readError = true;
+            m_slotFilled.signal();
+            return;
+        }
+        if (length == 0) {
+            m_eof = true;
+            m_slotFilled.signal();
+            return;
+        }
+        m_slots[slot].length = length;
+        m_head = (m_head + 1) % m_depth;
+        m_filled++;
+        m_slotFilled.signal();
+    }
+}
+
+bool PipelineEngine::begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+    (void)destHandle;
+    (void)fileSize;
+    m_sourceHandle = sourceHandle;
+    m_head = m_tail = m_filled = 0;
+    m_eof = m_readError = m_stop = false;
+    return m_reader.start(readerEntry, this);
+}
+
+// Writer stage: drain one filled slot to the destination
+long PipelineEngine::copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+    (void)sourceHandle;
+    (void)maxBytes;
+
+    int slot;
+    {
+        ScopedLock lock(m_lock);
+        while (m_filled == 0 && !m_eof && !m_readError) {
+            m_slotFilled.wait(m_lock);
+        }
+        if (m_filled == 0) {
+            // Everything read has been written
+            return m_readError ? -1 : 0;
+        }
+        slot = m_tail;
+    }
+
+    const char* data = m_slots[slot].data;
+    long length = m_slots[slot].length;
+    long written = 0;
+    while (written < length) {
+        TRACE_START(writeStart);
+        ssize_t put = write(destHandle, data + written, (size_t)(length - written));
+        TRACE_END(TRACE_WRITE, writeStart, put);
+        if (put <= 0) {
+            ScopedLock lock(m_lock);
+            m_stop = true;
+            m_slotFreed.signal();
+            return -1;
+        }
+        written += (long)put;
+    }
+    if (m_sink) {
+        m_sink->onData(data, length);
+    }
+
+    ScopedLock lock(m_lock);
+    m_tail = (m_tail + 1) % m_depth;
+    m_filled--;
+    m_slotFreed.signal();
+    return length;
+}
+
+void PipelineEngine::end() {
+    {
+        ScopedLock lock(m_lock);
+        m_stop = true;
+        m_slotFreed.signal();
+    }
+    m_reader.join();
+}
+
+#endif // FC_THREADS
@@ -0,0 +1,61 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "engine.h"
+#include "fcthread.h"
+
+#ifdef FC_THREADS
+
+// Double-buffered copy: a reader thread fills a ring of preallocated
+// chunks while the caller's thread drains them to the destination, so
+// both devices stay busy. copyChunk() returns only bytes the writer has
+// committed, which keeps progress and speed accounting honest.
+class PipelineEngine : public CopyEngine {
+private:
+    struct Slot {
+        char* data;
+        long length;
+    };
+
+    Slot* m_slots;
+    int m_depth;
+    long m_chunkSize;
+
+    // Ring state, guarded by m_lock
+    int m_head;        // Next slot the reader fills
+    int m_tail;        // Next slot the writer drains
+    int m_filled;      // Slots waiting to be written
+    bool m_eof;        // Reader hit end of file
+    bool m_readError;  // Reader failed
+    bool m_stop;       // Writer gave up - reader must exit
+
+    Mutex m_lock;
+    Condition m_slotFilled;
+    Condition m_slotFreed;
+    Thread m_reader;
+    int m_sourceHandle;
+
+    static void* readerEntry(void* arg);
+    void readerLoop();
+
+    // Not copyable
+    PipelineEngine(const PipelineEngine&);
+    PipelineEngine& operator=(const PipelineEngine&);
+
+public:
+    PipelineEngine(int ringDepth, long chunkSize);
+    virtual ~PipelineEngine();
+
+    virtual const char* getName() const { return "pipe"; }
+    virtual long getChunkSize() const { return m_chunkSize; }
+    virtual bool canResizeChunks() const { return false; }
+    virtual bool passesData() const { return true; }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize);
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes);
+    virtual void end();
+};
+
+#endif // FC_THREADS
+
+#endif // PIPELINE_H
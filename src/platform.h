@@ -0,0 +1,150 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+// Platform layer so the same sources build with Borland C++ for DOS
+// (makefile) and with g++ on Linux (makefile.lnx)
+
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+
+#if defined(__MSDOS__) || defined(__BORLANDC__)
+
+#define FC_DOS 1
+
+#include <iostream.h>
+#include <fstream.h>
+#include <iomanip.h>
+#include <dos.h>
+#include <dir.h>
+#include <io.h>
+#include <process.h>
+
+#define PATH_SEP '\\'
+#define PATH_SEP_STR "\\"
+
+// File sizes and offsets. DOS files stop at 2GB and Borland has no
+// 64-bit integer, so a long is as wide as a size can get.
+typedef long fsize_t;
+#define FSIZE_FORMAT "%ld"
+
+// Flush DOS buffers for a handle to disk (INT 21h AH=68h, DOS 3.3+)
+inline int commitFile(int handle) {
+    union REGS regs;
+    regs.h.ah = 0x68;
+    regs.x.bx = handle;
+    intdos(&regs, &regs);
+    return regs.x.cflag ? -1 : 0;
+}
+
+// Cut or extend an open file
+inline int truncateFile(int handle, fsize_t size) {
+    return chsize(handle, size);
+}
+
+// Reserve clusters for size bytes so the file is laid out in one pass.
+// chsize() would zero-fill; a zero-length write at the new end (INT 21h
+// AH=40h, CX=0) only sets the size and allocates. The file pointer is
+// left where it was.
+inline int preallocateFile(int handle, fsize_t size) {
+    long position = lseek(handle, 0L, SEEK_CUR);
+    if (position < 0 || lseek(handle, size, SEEK_SET) != size) {
+        return -1;
+    }
+    union REGS regs;
+    regs.h.ah = 0x40;
+    regs.x.bx = handle;
+    regs.x.cx = 0;
+    intdos(&regs, &regs);
+    lseek(handle, position, SEEK_SET);
+    return regs.x.cflag ? -1 : 0;
+}
+
+// Nothing to evict - DOS has no page cache of its own, though a disk
+// cache such as SMARTDRV may still answer reads
+inline void dropFileCache(int handle) {
+    (void)handle;
+}
+
+#else
+
+#define FC_POSIX 1
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <unistd.h>
+#include <strings.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#define MAXPATH PATH_MAX
+#define PATH_SEP '/'
+#define PATH_SEP_STR "/"
+
+#define stricmp strcasecmp
+#define strnicmp strncasecmp
+
+// File sizes and offsets. 64 bits even where long is 32; makefile.lnx
+// builds with _FILE_OFFSET_BITS=64 so off_t and the open/lseek family
+// match.
+typedef long long fsize_t;
+#define FSIZE_FORMAT "%lld"
+
+// Borland io.h: length of an open file
+inline fsize_t filelength(int handle) {
+    struct stat st;
+    if (fstat(handle, &st) != 0) return -1;
+    return (fsize_t)st.st_size;
+}
+
+// Make written data durable before recording it anywhere
+inline int commitFile(int handle) {
+    return fdatasync(handle);
+}
+
+// Cut or extend an open file
+inline int truncateFile(int handle, fsize_t size) {
+    return ftruncate(handle, (off_t)size);
+}
+
+// Reserve blocks for size bytes so the filesystem can lay the file out
+// in as few extents as possible. On Linux this fails rather than
+// writing zeros where the filesystem cannot reserve space.
+inline int preallocateFile(int handle, fsize_t size) {
+#ifdef __linux__
+    return fallocate(handle, 0, 0, (off_t)size);
+#else
+    return posix_fallocate(handle, 0, (off_t)size) == 0 ? 0 : -1;
+#endif
+}
+
+// Evict a file's clean pages so the next read comes from the device
+inline void dropFileCache(int handle) {
+    posix_fadvise(handle, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+// Borland dos.h: sleep for a number of milliseconds
+inline void delay(unsigned milliseconds) {
+    usleep(milliseconds * 1000UL);
+}
+
+#endif
+
+// True if the path does not need the current directory prepended
+inline bool isAbsolutePath(const char* path) {
+#ifdef FC_DOS
+    return path[0] == '\\' || path[0] == '/' || (path[0] != '\0' && path[1] == ':');
+#else
+    return path[0] == '/';
+#endif
+}
+
+#endif // PLATFORM_H
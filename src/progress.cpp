@@ -1,8 +1,6 @@
+#include "platform.h"
 #include "progress.h"
-#include <iostream.h>
-#include <iomanip.h>
-#include <stdio.h>  // For sprintf
-#include <string.h> // For strcpy
+#include "trace.h"
 
 // Function to format time remaining in minutes:seconds
 void formatTimeRemaining(long secondsRemaining, char* buffer) {
@@ -38,49 +36,182 @@ void formatSpeed(long bytesPerSec, char* buffer) {
     }
 }
 
-// Changed to use longs instead of double for speed
-void Progress::showProgressBar(long bytesTransferred, long totalBytes, long bytesPerSec) {
-    // Make sure we don't divide by zero
-    if (totalBytes <= 0) {
-        cout << "Progress: 0% complete      \r";
-        cout.flush();
+// Function to format a duration in seconds with 2 decimal places
+void formatDuration(long millis, char* buffer) {
+    sprintf(buffer, "%ld.%02ld", millis / 1000L, (millis % 1000L) / 10L);
+}
+
+// Same as formatSpeed(), in integer math - this runs for every update
+static void formatSpeedFixed(long bytesPerSec, char* buffer) {
+    if (bytesPerSec <= 0) {
+        strcpy(buffer, "0.00 KB/s");
         return;
     }
     
-    // Calculate percentage safely to avoid integer overflow
-    // First divide each term to keep values in range
-    long percent;
-    if (totalBytes > 10000000L) {
-        // For large files, scale down to avoid overflow
-        percent = (bytesTransferred / 1024) * 100L / (totalBytes / 1024);
+    unsigned long hundredths;
+    if (bytesPerSec >= 2048L * 1024L) {
+        hundredths = (unsigned long)bytesPerSec / 1024UL * 100UL / 1024UL;
+        sprintf(buffer, "%lu.%02lu MB/s", hundredths / 100UL, hundredths % 100UL);
     } else {
-        // For smaller files, use the original calculation
-        percent = (bytesTransferred * 100L) / totalBytes;
+        hundredths = (unsigned long)bytesPerSec * 100UL / 1024UL;
+        sprintf(buffer, "%lu.%02lu KB/s", hundredths / 100UL, hundredths % 100UL);
     }
-    
-    // Cap at 100% to avoid showing more than 100%
-    if (percent > 100) percent = 100;
-    
-    // Calculate time remaining (in seconds)
-    long secondsRemaining = -1;
-    if (bytesPerSec > 0 && bytesTransferred < totalBytes) {
-        long bytesLeft = totalBytes - bytesTransferred;
-        secondsRemaining = bytesLeft / bytesPerSec;
+}
+
+long percentOf(fsize_t done, fsize_t total) {
+    if (total <= 0) {
+        return 0;
     }
+#ifdef FC_DOS
+    // 32-bit sizes: scale large files down first so done * 100 fits
+    if (total > 10000000L) {
+        return (done / 1024) * 100L / (total / 1024);
+    }
+#endif
+    // 64-bit sizes have room for done * 100 up to 80 PB
+    return (long)(done * 100 / total);
+}
+
+bool Progress::s_quietMode = false;
+
+Progress::Progress()
+    : m_shownLength(0)
+#ifdef FC_THREADS
+      , m_intervalMs(0), m_stopping(false)
+#endif
+{
+    m_line[0] = '\0';
+}
+
+Progress::~Progress() {
+    stop();
+}
+
+void Progress::render(fsize_t bytesTransferred, fsize_t totalBytes, long bytesPerSec) {
+    char text[PROGRESS_LINE_SIZE];
     
-    char timeRemainingStr[20];
-    formatTimeRemaining(secondsRemaining, timeRemainingStr);
-    
-    char speedStr[20];
-    formatSpeed(bytesPerSec, speedStr);
-    
-    cout << "Progress: " << percent << "% complete";
+    // Make sure we don't divide by zero
+    if (totalBytes <= 0) {
+        strcpy(text, "Progress: 0% complete");
+    } else {
+        long percent = percentOf(bytesTransferred, totalBytes);
+        
+        // Cap at 100% to avoid showing more than 100%
+        if (percent > 100) percent = 100;
+        
+        // Only show speed and time remaining if we have valid data
+        if (bytesPerSec > 0) {
+            long secondsRemaining = -1;
+            if (bytesTransferred < totalBytes) {
+                secondsRemaining = (long)((totalBytes - bytesTransferred) / bytesPerSec);
+            }
+            char timeRemainingStr[32];
+            char speedStr[32];
+            formatTimeRemaining(secondsRemaining, timeRemainingStr);
+            formatSpeedFixed(bytesPerSec, speedStr);
+            sprintf(text, "Progress: %ld%% complete - %s - %s remaining",
+                    percent, speedStr, timeRemainingStr);
+        } else {
+            sprintf(text, "Progress: %ld%% complete", percent);
+        }
+    }
     
-    // Only show speed and time remaining if we have valid data
-    if (bytesPerSec > 0) {
-        cout << " - " << speedStr << " - " << timeRemainingStr << " remaining";
+    // Nothing visible changed - leave the console alone
+    if (m_shownLength > 0 && strcmp(text, m_line) == 0) {
+        return;
     }
     
-    cout << "      \r";
+    // Blank out whatever is left of a longer previous line, then return
+    // the cursor, all in one write
+    char output[PROGRESS_LINE_SIZE * 2];
+    int length = strlen(text);
+    memcpy(output, text, length);
+    while (length < m_shownLength) {
+        output[length++] = ' ';
+    }
+    output[length++] = '\r';
+    TRACE_START(drawStart);
+    cout.write(output, length);
     cout.flush();
-}
\ No newline at end of file
+    TRACE_END(TRACE_PROGRESS, drawStart, length);
+    
+    strcpy(m_line, text);
+    m_shownLength = strlen(text);
+}
+
+void Progress::showProgressBar(fsize_t bytesTransferred, fsize_t totalBytes, long bytesPerSec) {
+    if (!s_quietMode) {
+#ifdef FC_THREADS
+        // Seed the timer thread too, so it never redraws from zero
+        m_bytes.set(bytesTransferred);
+        m_total.set(totalBytes);
+        m_rate.set(bytesPerSec);
+#endif
+        render(bytesTransferred, totalBytes, bytesPerSec);
+    }
+}
+
+#ifdef FC_THREADS
+
+void* Progress::tickerEntry(void* arg) {
+    ((Progress*)arg)->tickerLoop();
+    return NULL;
+}
+
+void Progress::tickerLoop() {
+    ScopedLock lock(m_lock);
+    while (!m_stopping) {
+        m_wake.waitFor(m_lock, m_intervalMs);
+        if (m_stopping) {
+            break;
+        }
+        m_lock.unlock();
+        render(m_bytes.get(), m_total.get(), m_rate.get());
+        m_lock.lock();
+    }
+}
+
+#endif // FC_THREADS
+
+void Progress::start(long intervalMs) {
+#ifdef FC_THREADS
+    if (s_quietMode || m_ticker.isStarted()) {
+        return;
+    }
+    m_intervalMs = intervalMs;
+    m_stopping = false;
+    m_ticker.start(tickerEntry, this);
+#else
+    (void)intervalMs;
+#endif
+}
+
+void Progress::update(fsize_t bytesTransferred, fsize_t totalBytes, long bytesPerSec) {
+    if (s_quietMode) {
+        return;
+    }
+#ifdef FC_THREADS
+    if (m_ticker.isStarted()) {
+        m_bytes.set(bytesTransferred);
+        m_total.set(totalBytes);
+        m_rate.set(bytesPerSec);
+        return;
+    }
+#endif
+    render(bytesTransferred, totalBytes, bytesPerSec);
+}
+
+void Progress::stop() {
+#ifdef FC_THREADS
+    if (!m_ticker.isStarted()) {
+        return;
+    }
+    {
+        ScopedLock lock(m_lock);
+        m_stopping = true;
+        m_wake.signal();
+    }
+    m_ticker.join();
+    render(m_bytes.get(), m_total.get(), m_rate.get());
+#endif
+}
@@ -1,10 +1,77 @@
 #ifndef PROGRESS_H
 #define PROGRESS_H
 
+#include "fcthread.h"
+
+// Format a speed as KB/s or MB/s with 2 decimal places
+void formatSpeed(long bytesPerSec, char* buffer);
+
+// Format a duration as seconds with 2 decimal places
+void formatDuration(long millis, char* buffer);
+
+// Whole percent of total that done is, without overflowing on large files
+long percentOf(fsize_t done, fsize_t total);
+
+// Room for the longest progress line. Real lines stay well inside 80
+// columns; the slack covers 64-bit numbers.
+const int PROGRESS_LINE_SIZE = 128;
+
+// Console progress line. Each update is formatted with integer math into
+// a preallocated buffer and written with a single call, and only when the
+// visible text changed, so slow consoles and serial terminals cost the
+// copy as little as possible.
+//
+// On Linux start() hands rendering to a timer thread: update() then only
+// stores the counters and the copy loop never waits on the console.
+// Quiet mode (/q) turns every Progress into a no-op for batch jobs.
 class Progress {
+private:
+    char m_line[PROGRESS_LINE_SIZE];
+    int m_shownLength;      // Length of the text on screen, for erasing
+
+    static bool s_quietMode;
+
+    void render(fsize_t bytesTransferred, fsize_t totalBytes, long bytesPerSec);
+
+#ifdef FC_THREADS
+    AtomicSize m_bytes;
+    AtomicSize m_total;
+    AtomicLong m_rate;
+    long m_intervalMs;
+    bool m_stopping;        // Guarded by m_lock
+    Mutex m_lock;
+    Condition m_wake;
+    Thread m_ticker;
+
+    static void* tickerEntry(void* arg);
+    void tickerLoop();
+#endif
+
+    // Not copyable
+    Progress(const Progress&);
+    Progress& operator=(const Progress&);
+
 public:
-    // Changed to use longs instead of double for speed
-    void showProgressBar(long bytesTransferred, long totalBytes, long bytesPerSec);
+    Progress();
+    ~Progress();
+
+    // Process-wide switch for /q
+    static void setQuietMode(bool quiet) { s_quietMode = quiet; }
+    static bool getQuietMode() { return s_quietMode; }
+
+    // Changed to use longs instead of double for speed. Renders now, on
+    // the calling thread, and seeds the counters a later start() draws.
+    void showProgressBar(fsize_t bytesTransferred, fsize_t totalBytes, long bytesPerSec);
+
+    // Render every intervalMs on a timer thread until stop(). Without
+    // threads updates are rendered as they come.
+    void start(long intervalMs);
+
+    // New counters: stored for the timer thread, or rendered directly
+    void update(fsize_t bytesTransferred, fsize_t totalBytes, long bytesPerSec);
+
+    // Stop the timer thread after drawing the latest counters
+    void stop();
 };
 
-#endif // PROGRESS_H
\ No newline at end of file
+#endif // PROGRESS_H
@@ -0,0 +1,300 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include <stdlib.h>
+#include "randio.h"
+#include "bench.h"
+#include "hrtimer.h"
+#include "logger.h"
+#include "progress.h"
+#include "fcthread.h"
+
+// Defaults: sector-sized requests on a small DOS file, page-sized ones
+// on a Linux file big enough to spread over the device
+#ifdef FC_DOS
+const long DEFAULT_RANDOM_FILE = 8L * 1048576L;
+const long DEFAULT_RANDOM_IO = 512L;
+const long FILL_CHUNK = 32256L;
+#else
+const long DEFAULT_RANDOM_FILE = 256L * 1048576L;
+const long DEFAULT_RANDOM_IO = 4096L;
+const long FILL_CHUNK = 1048576L;
+#endif
+const int DEFAULT_RANDOM_SECONDS = 10;
+
+RandomOptions::RandomOptions()
+    : fileSize(DEFAULT_RANDOM_FILE), ioSize(DEFAULT_RANDOM_IO),
+      queueDepth(1), seconds(DEFAULT_RANDOM_SECONDS) {
+}
+
+// Positioned I/O. DOS has a single request in flight, so seeking the
+// shared handle is safe there.
+static long readAt(int handle, char* buffer, long length, fsize_t offset) {
+#ifdef FC_POSIX
+    return (long)pread(handle, buffer, (size_t)length, (off_t)offset);
+#else
+    if (lseek(handle, offset, SEEK_SET) != offset) {
+        return -1;
+    }
+    return (long)read(handle, buffer, (unsigned)length);
+#endif
+}
+
+static long writeAt(int handle, const char* buffer, long length, fsize_t offset) {
+#ifdef FC_POSIX
+    return (long)pwrite(handle, buffer, (size_t)length, (off_t)offset);
+#else
+    if (lseek(handle, offset, SEEK_SET) != offset) {
+        return -1;
+    }
+    return (long)write(handle, buffer, (unsigned)length);
+#endif
+}
+
+// Fill a buffer with incompressible bytes
+static void fillBuffer(char* buffer, long length, unsigned long seed) {
+    for (long i = 0; i < length; i++) {
+        seed = (seed * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+        buffer[i] = (char)(seed >> 16);
+    }
+}
+
+// Latency for the console: microseconds, or milliseconds once large
+static void formatLatency(unsigned long micros, char* buffer) {
+    if (micros >= 10000UL) {
+        sprintf(buffer, "%.1f ms", (double)micros / 1000.0);
+    } else {
+        sprintf(buffer, "%lu us", micros);
+    }
+}
+
+RandomBenchmark::RandomBenchmark(const char* directory, const RandomOptions& options)
+    : m_options(options), m_handle(-1), m_writing(false), m_start(0),
+      m_durationMicros(0), m_failed(false), m_debugMode(false) {
+    strcpy(m_directory, directory);
+    int length = strlen(m_directory);
+    if (length > 0 && m_directory[length - 1] != '\\' && m_directory[length - 1] != '/') {
+        strcat(m_directory, PATH_SEP_STR);
+    }
+    strcpy(m_testPath, m_directory);
+    strcat(m_testPath, "RANDIO.TMP");
+}
+
+// Write the whole test file up front so reads hit allocated blocks and
+// writes overwrite in place instead of extending the file
+bool RandomBenchmark::createTestFile() {
+    int handle = open(m_testPath, O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (handle < 0) {
+        return false;
+    }
+
+    char* buffer = new char[(unsigned)FILL_CHUNK];
+    fillBuffer(buffer, FILL_CHUNK, 54321UL);
+
+    bool ok = true;
+    fsize_t remaining = m_options.fileSize;
+    while (remaining > 0 && ok) {
+        unsigned length = (unsigned)((remaining < FILL_CHUNK) ? remaining : FILL_CHUNK);
+        ok = (write(handle, buffer, length) == (int)length);
+        remaining -= length;
+    }
+    if (ok) {
+        ok = (commitFile(handle) == 0);
+    }
+
+    delete[] buffer;
+    close(handle);
+    return ok;
+}
+
+// Random block-aligned offset. The 15-bit LCG output is used twice so
+// files of more than 32768 blocks are still covered.
+fsize_t RandomBenchmark::nextOffset(unsigned long& seed) const {
+    seed = (seed * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+    unsigned long high = (seed >> 16) & 0x7FFFUL;
+    seed = (seed * 1103515245UL + 12345UL) & 0xFFFFFFFFUL;
+    unsigned long low = (seed >> 16) & 0x7FFFUL;
+
+    fsize_t blocks = m_options.fileSize / m_options.ioSize;
+    return (fsize_t)((high << 15) | low) % blocks * m_options.ioSize;
+}
+
+void* RandomBenchmark::workerEntry(void* arg) {
+    Worker* worker = (Worker*)arg;
+    worker->owner->runWorker(*worker);
+    return NULL;
+}
+
+// Issue one operation at a time until the test time is up
+void RandomBenchmark::runWorker(Worker& worker) {
+    long length = m_options.ioSize;
+    unsigned long now = hrNowMicros();
+    while (!m_failed && hrElapsedMicros(m_start, now) < m_durationMicros) {
+        fsize_t offset = nextOffset(worker.seed);
+        long done;
+        if (m_writing) {
+            done = writeAt(m_handle, worker.buffer, length, offset);
+        } else {
+            done = readAt(m_handle, worker.buffer, length, offset);
+        }
+        unsigned long finished = hrNowMicros();
+        if (done != length) {
+            m_failed = true;
+            break;
+        }
+        worker.latency.record(hrElapsedMicros(now, finished));
+        now = finished;
+    }
+}
+
+bool RandomBenchmark::runTest(bool writing) {
+    int flags = writing ? O_WRONLY : O_RDONLY;
+#ifdef FC_POSIX
+    // Each write must reach the device, or this measures the page cache
+    if (writing) {
+        flags |= O_DSYNC;
+    }
+#endif
+    m_handle = open(m_testPath, flags | O_BINARY);
+    if (m_handle < 0) {
+        return false;
+    }
+    dropFileCache(m_handle);
+#ifdef FC_POSIX
+    posix_fadvise(m_handle, 0, 0, POSIX_FADV_RANDOM);
+#endif
+
+    int depth = m_options.queueDepth;
+    Worker* workers = new Worker[depth];
+    for (int i = 0; i < depth; i++) {
+        workers[i].owner = this;
+        workers[i].seed = 1UL + (unsigned long)i * 7919UL + (writing ? 104729UL : 0UL);
+        workers[i].buffer = new char[(unsigned)m_options.ioSize];
+        fillBuffer(workers[i].buffer, m_options.ioSize, workers[i].seed);
+    }
+
+    m_writing = writing;
+    m_failed = false;
+    m_durationMicros = (unsigned long)m_options.seconds * 1000000UL;
+    Stopwatch clock;
+    m_start = hrNowMicros();
+
+#ifdef FC_THREADS
+    Thread* threads = new Thread[depth];
+    for (int i = 1; i < depth; i++) {
+        if (!threads[i].start(workerEntry, &workers[i])) {
+            m_failed = true;
+        }
+    }
+    runWorker(workers[0]);
+    for (int i = 1; i < depth; i++) {
+        threads[i].join();
+    }
+    delete[] threads;
+#else
+    runWorker(workers[0]);
+#endif
+
+    double seconds = clock.lap();
+    close(m_handle);
+    m_handle = -1;
+
+    LogHistogram latency;
+    for (int i = 0; i < depth; i++) {
+        latency.merge(workers[i].latency);
+        delete[] workers[i].buffer;
+    }
+    delete[] workers;
+
+    if (m_failed || latency.getCount() == 0) {
+        cerr << "Error: random " << (writing ? "write" : "read") << " test failed in "
+             << m_directory << endl;
+        return false;
+    }
+
+    RandomIoInfo info;
+    info.test = writing ? "write" : "read";
+    info.fileSize = m_options.fileSize;
+    info.ioSize = m_options.ioSize;
+    info.queueDepth = depth;
+    info.operations = latency.getCount();
+    info.duration = (long)(seconds * 1000.0);
+    info.iops = (seconds > 0.0) ? (long)((double)info.operations / seconds) : 0;
+    info.p50 = latency.percentile(50.0);
+    info.p99 = latency.percentile(99.0);
+    info.p999 = latency.percentile(99.9);
+    info.maximum = latency.getMaximum();
+
+    char rateStr[20];
+    char p50Str[16];
+    char p99Str[16];
+    char p999Str[16];
+    char maxStr[16];
+    formatSpeed((long)((double)info.iops * (double)info.ioSize), rateStr);
+    formatLatency(info.p50, p50Str);
+    formatLatency(info.p99, p99Str);
+    formatLatency(info.p999, p999Str);
+    formatLatency(info.maximum, maxStr);
+
+    cout << setw(6) << info.test << setw(10) << info.iops << setw(14) << rateStr
+         << setw(10) << p50Str << setw(10) << p99Str << setw(10) << p999Str
+         << setw(10) << maxStr << endl;
+    if (m_debugMode) {
+        char meanStr[16];
+        char minStr[16];
+        formatLatency((unsigned long)latency.getMean(), meanStr);
+        formatLatency(latency.getMinimum(), minStr);
+        cout << "[DEBUG] " << info.operations << " operations, mean " << meanStr
+             << ", min " << minStr << endl;
+    }
+
+    Logger logger;
+    logger.logRandomIo(m_directory, info);
+    return true;
+}
+
+bool RandomBenchmark::run() {
+    char fileStr[16];
+    char ioStr[16];
+    formatSize(m_options.fileSize, fileStr);
+    formatSize(m_options.ioSize, ioStr);
+    cout << "Random I/O on " << m_directory << " - " << ioStr << " blocks, queue depth "
+         << m_options.queueDepth << ", " << m_options.seconds << " s per test, "
+         << fileStr << " file" << endl;
+
+    cout << "Creating test file..." << endl;
+    if (!createTestFile()) {
+        cerr << "Error: Cannot create test file " << m_testPath << endl;
+        unlink(m_testPath);
+        return false;
+    }
+
+    cout << endl;
+    cout << setw(6) << "Test" << setw(10) << "IOPS" << setw(14) << "Throughput"
+         << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "p99.9"
+         << setw(10) << "Max" << endl;
+
+    bool ok = runTest(false) && runTest(true);
+
+    unlink(m_testPath);
+    cout << endl;
+    cout << "Results logged to " << m_directory << "TRANSFER.LOG" << endl;
+    return ok;
+}
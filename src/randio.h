@@ -0,0 +1,65 @@
+#ifndef RANDIO_H
+#define RANDIO_H
+
+#include "platform.h"
+#include "histo.h"
+
+// Settings for /bench /random
+struct RandomOptions {
+    fsize_t fileSize;   // Bytes in the test file
+    long ioSize;        // Bytes per operation; offsets are multiples of it
+    int queueDepth;     // Operations in flight (worker threads on Linux)
+    int seconds;        // Run time of each test
+
+    RandomOptions();
+};
+
+// Random-access benchmark (/bench /random). Fills a test file, then
+// issues aligned reads and afterwards aligned writes at random offsets
+// for a fixed time, timing every operation. Each test reports IOPS and
+// a latency histogram to the console and to TRANSFER.LOG.
+//
+// On Linux queue depth N means N threads each keeping one pread() or
+// pwrite() outstanding, and writes use O_DSYNC so each one reaches the
+// device. DOS can only have one request in flight, and its clock ticks
+// every 55 ms, so latencies there are coarse and IOPS is the figure to
+// compare.
+class RandomBenchmark {
+private:
+    struct Worker {
+        RandomBenchmark* owner;
+        LogHistogram latency;   // Microseconds per operation
+        unsigned long seed;
+        char* buffer;
+    };
+
+    RandomOptions m_options;
+    char m_directory[MAXPATH];
+    char m_testPath[MAXPATH];
+    int m_handle;
+    bool m_writing;
+    unsigned long m_start;
+    unsigned long m_durationMicros;
+    volatile bool m_failed;
+    bool m_debugMode;
+
+    bool createTestFile();
+    bool runTest(bool writing);
+    void runWorker(Worker& worker);
+    static void* workerEntry(void* arg);
+    fsize_t nextOffset(unsigned long& seed) const;
+
+    // Not copyable
+    RandomBenchmark(const RandomBenchmark&);
+    RandomBenchmark& operator=(const RandomBenchmark&);
+
+public:
+    RandomBenchmark(const char* directory, const RandomOptions& options);
+
+    void setDebugMode(bool mode) { m_debugMode = mode; }
+
+    // Run the read and write tests. Returns false if either failed.
+    bool run();
+};
+
+#endif // RANDIO_H
@@ -0,0 +1,62 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "rate.h"
+
+RateEstimator::RateEstimator(double windowSeconds)
+    : m_windowSeconds(windowSeconds) {
+    reset();
+}
+
+void RateEstimator::reset() {
+    m_first = 0;
+    m_count = 0;
+}
+
+void RateEstimator::addSample(double seconds, fsize_t totalBytes) {
+    // Ring is full - drop the oldest sample
+    if (m_count == MAX_SAMPLES) {
+        m_first = (m_first + 1) % MAX_SAMPLES;
+        m_count--;
+    }
+
+    int slot = (m_first + m_count) % MAX_SAMPLES;
+    m_times[slot] = seconds;
+    m_bytes[slot] = totalBytes;
+    m_count++;
+
+    // Expire samples that fell out of the window, keeping at least two
+    while (m_count > 2 && seconds - m_times[(m_first + 1) % MAX_SAMPLES] >= m_windowSeconds) {
+        m_first = (m_first + 1) % MAX_SAMPLES;
+        m_count--;
+    }
+}
+
+long RateEstimator::getRate() const {
+    if (m_count < 2) {
+        return 0;
+    }
+
+    int last = (m_first + m_count - 1) % MAX_SAMPLES;
+    double seconds = m_times[last] - m_times[m_first];
+    if (seconds <= 0.0) {
+        return 0;
+    }
+    return (long)((double)(m_bytes[last] - m_bytes[m_first]) / seconds);
+}
@@ -0,0 +1,29 @@
+#ifndef RATE_H
+#define RATE_H
+
+#include "platform.h"
+
+// Sliding-window throughput estimator. Feed it (elapsed seconds, total
+// bytes) samples as the copy runs; getRate() reports bytes per second over
+// the most recent window instead of the average since the start.
+class RateEstimator {
+private:
+    enum { MAX_SAMPLES = 32 };
+
+    double m_times[MAX_SAMPLES];
+    fsize_t m_bytes[MAX_SAMPLES];
+    int m_first;    // Oldest sample still in the window
+    int m_count;
+    double m_windowSeconds;
+
+public:
+    RateEstimator(double windowSeconds);
+
+    void reset();
+    void addSample(double seconds, fsize_t totalBytes);
+
+    // Bytes per second across the window, 0 until two samples exist
+    long getRate() const;
+};
+
+#endif // RATE_H
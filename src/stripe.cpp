@@ -0,0 +1,233 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "stripe.h"
+#include "bufpool.h"
+#include "limiter.h"
+#include "trace.h"
+
+#ifdef FC_THREADS
+
+#include <errno.h>
+
+StripeEngine::StripeEngine(int stripes, long chunkSize)
+    : m_ranges(NULL), m_stripes(stripes), m_rangeCount(0), m_chunkSize(chunkSize),
+      m_limiter(NULL), m_sourceHandle(-1), m_destHandle(-1), m_destShift(0),
+      m_written(0), m_reported(0), m_running(0), m_failed(false), m_stop(false) {
+    m_ranges = new Range[m_stripes];
+}
+
+StripeEngine::~StripeEngine() {
+    end();
+    delete[] m_ranges;
+}
+
+void* StripeEngine::rangeEntry(void* arg) {
+    Range* range = (Range*)arg;
+    range->owner->copyRange(*range);
+    return NULL;
+}
+
+void StripeEngine::copyRange(Range& range) {
+    char* buffer = BufferPool::acquire(m_chunkSize);
+    fsize_t offset = range.start;
+    bool failed = (buffer == NULL);
+
+    while (!failed && offset < range.end) {
+        {
+            ScopedLock lock(m_lock);
+            if (m_stop) {
+                break;
+            }
+        }
+
+        fsize_t left = range.end - offset;
+        long length = (left < m_chunkSize) ? (long)left : m_chunkSize;
+        long got = 0;
+        while (got < length) {
+            TRACE_START(readStart);
+            ssize_t moved = pread(m_sourceHandle, buffer + got, (size_t)(length - got),
+                                  (off_t)(offset + got));
+            TRACE_END(TRACE_READ, readStart, moved);
+            if (moved < 0 && errno == EINTR) {
+                continue;
+            }
+            if (moved <= 0) {
+                break;      // Error, or the source shrank
+            }
+            got += (long)moved;
+        }
+        if (got < length) {
+            failed = true;
+            break;
+        }
+
+        long put = 0;
+        while (put < length) {
+            TRACE_START(writeStart);
+            ssize_t moved = pwrite(m_destHandle, buffer + put, (size_t)(length - put),
+                                   (off_t)(offset + put + m_destShift));
+            TRACE_END(TRACE_WRITE, writeStart, moved);
+            if (moved < 0 && errno == EINTR) {
+                continue;
+            }
+            if (moved <= 0) {
+                break;
+            }
+            put += (long)moved;
+        }
+        if (put < length) {
+            failed = true;
+            break;
+        }
+        offset += length;
+
+        if (m_limiter) {
+            m_limiter->consume(length);
+        }
+
+        ScopedLock lock(m_lock);
+        range.done = offset - range.start;
+        m_written += length;
+        m_progress.signal();
+    }
+
+    if (buffer != NULL) {
+        BufferPool::release(buffer, m_chunkSize);
+    }
+
+    // One failed range stops the others - the copy can't succeed now
+    ScopedLock lock(m_lock);
+    if (failed) {
+        range.failed = true;
+        m_failed = true;
+        m_stop = true;
+    }
+    m_running--;
+    m_progress.signal();
+}
+
+bool StripeEngine::begin(int sourceHandle, int destHandle, fsize_t fileSize) {
+    end();
+
+    // Positional I/O from here on - start where the handles are (resume)
+    m_sourceHandle = sourceHandle;
+    m_destHandle = destHandle;
+    fsize_t start = lseek(sourceHandle, 0, SEEK_CUR);
+    m_destShift = lseek(destHandle, 0, SEEK_CUR) - start;
+    m_written = m_reported = 0;
+    m_failed = m_stop = false;
+
+    // Equal ranges on chunk boundaries; a small file gets fewer of them
+    fsize_t total = (fileSize > start) ? fileSize - start : 0;
+    fsize_t rangeLength = (total + m_stripes - 1) / m_stripes;
+    rangeLength = (rangeLength + m_chunkSize - 1) / m_chunkSize * m_chunkSize;
+    if (rangeLength == 0) {
+        rangeLength = m_chunkSize;
+    }
+    m_rangeCount = 0;
+    for (fsize_t offset = start; offset < fileSize && m_rangeCount < m_stripes; offset += rangeLength) {
+        Range& range = m_ranges[m_rangeCount++];
+        range.owner = this;
+        range.start = offset;
+        range.end = (fileSize - offset < rangeLength) ? fileSize : offset + rangeLength;
+        range.done = 0;
+        range.failed = false;
+    }
+
+    m_running = m_rangeCount;
+    for (int i = 0; i < m_rangeCount; i++) {
+        if (!m_ranges[i].thread.start(rangeEntry, &m_ranges[i])) {
+            {
+                ScopedLock lock(m_lock);
+                m_running -= m_rangeCount - i;
+                m_failed = true;
+            }
+            stop();
+            return false;
+        }
+    }
+    return true;
+}
+
+long StripeEngine::copyChunk(int sourceHandle, int destHandle, long maxBytes) {
+    (void)sourceHandle;
+    (void)destHandle;
+    (void)maxBytes;
+
+    ScopedLock lock(m_lock);
+    while (m_written == m_reported && m_running > 0) {
+        m_progress.wait(m_lock);
+    }
+    if (m_written > m_reported) {
+        long delta = (long)(m_written - m_reported);
+        m_reported = m_written;
+        return delta;
+    }
+    return m_failed ? -1 : 0;
+}
+
+// Stop the threads and wait for them
+void StripeEngine::stop() {
+    {
+        ScopedLock lock(m_lock);
+        m_stop = true;
+    }
+    for (int i = 0; i < m_rangeCount; i++) {
+        m_ranges[i].thread.join();
+    }
+}
+
+void StripeEngine::end() {
+    if (m_sourceHandle < 0) {
+        return;
+    }
+    stop();
+
+    // A finished copy leaves the handles at the end, like the others
+    if (!m_failed && m_rangeCount > 0) {
+        fsize_t end = m_ranges[m_rangeCount - 1].end;
+        lseek(m_sourceHandle, end, SEEK_SET);
+        lseek(m_destHandle, end + m_destShift, SEEK_SET);
+    }
+    m_sourceHandle = m_destHandle = -1;
+}
+
+void StripeEngine::getRange(int index, fsize_t& start, fsize_t& end, fsize_t& done) const {
+    start = m_ranges[index].start;
+    end = m_ranges[index].end;
+    done = m_ranges[index].done;
+}
+
+void StripeEngine::reportFailure() const {
+    int finished = 0;
+    for (int i = 0; i < m_rangeCount; i++) {
+        fsize_t start, end, done;
+        getRange(i, start, end, done);
+        if (done == end - start) {
+            finished++;
+        }
+        cerr << "  Range " << (i + 1) << ": bytes " << start << "-" << end
+             << ", " << done << " copied" << (done == end - start ? " (complete)" : "") << endl;
+    }
+    cerr << "Ranges complete: " << finished << " of " << m_rangeCount << endl;
+}
+
+#endif // FC_THREADS
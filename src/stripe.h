@@ -0,0 +1,81 @@
+#ifndef STRIPE_H
+#define STRIPE_H
+
+#include "engine.h"
+#include "fcthread.h"
+
+#ifdef FC_THREADS
+
+// Striped copy of one file: the file is cut into as many byte ranges as
+// there are stripes and each range is copied by its own thread with
+// pread()/pwrite(). Striped arrays and SANs often reach full speed only
+// with several streams going at once. copyChunk() returns what all the
+// threads have written since the last call, so the progress line and
+// the log see one transfer.
+//
+// Ranges finish out of order, so the engine can't feed a DataSink. If a
+// range fails the others stop, and getRange() tells exactly how much of
+// each one made it.
+class StripeEngine : public CopyEngine {
+private:
+    struct Range {
+        StripeEngine* owner;
+        fsize_t start;      // Source offset
+        fsize_t end;
+        fsize_t done;       // Bytes from start already written
+        bool failed;
+        Thread thread;
+    };
+
+    Range* m_ranges;
+    int m_stripes;          // Requested
+    int m_rangeCount;       // Used - small files get fewer
+    long m_chunkSize;       // Bytes per pread()/pwrite()
+    RateLimiter* m_limiter;
+
+    int m_sourceHandle;
+    int m_destHandle;
+    fsize_t m_destShift;    // Destination offset minus source offset
+
+    // Shared with the threads, guarded by m_lock
+    fsize_t m_written;      // Total over all ranges
+    fsize_t m_reported;     // Part of m_written copyChunk() has returned
+    int m_running;
+    bool m_failed;
+    bool m_stop;
+    Mutex m_lock;
+    Condition m_progress;
+
+    static void* rangeEntry(void* arg);
+    void copyRange(Range& range);
+    void stop();
+
+    // Not copyable
+    StripeEngine(const StripeEngine&);
+    StripeEngine& operator=(const StripeEngine&);
+
+public:
+    StripeEngine(int stripes, long chunkSize);
+    virtual ~StripeEngine();
+
+    virtual const char* getName() const { return "stripe"; }
+    virtual long getChunkSize() const { return m_chunkSize; }
+    virtual bool canResizeChunks() const { return false; }
+    virtual int getQueueDepth() const { return m_stripes; }
+    virtual bool setLimiter(RateLimiter* limiter) { m_limiter = limiter; return true; }
+
+    virtual bool begin(int sourceHandle, int destHandle, fsize_t fileSize);
+    virtual long copyChunk(int sourceHandle, int destHandle, long maxBytes);
+    virtual void end();
+
+    // Lists every range with how many of its bytes were written
+    virtual void reportFailure() const;
+
+    // The ranges of the last transfer, valid until the next begin()
+    int getRangeCount() const { return m_rangeCount; }
+    void getRange(int index, fsize_t& start, fsize_t& end, fsize_t& done) const;
+};
+
+#endif // FC_THREADS
+
+#endif // STRIPE_H
@@ -0,0 +1,119 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "thruput.h"
+
+ThroughputRecorder::ThroughputRecorder(double intervalSeconds)
+    : m_interval(intervalSeconds) {
+    start(0.0, 0);
+}
+
+void ThroughputRecorder::start(double seconds, fsize_t totalBytes) {
+    m_intervalStart = seconds;
+    m_intervalBytes = 0;
+    m_lastTotal = totalBytes;
+    m_rates.reset();
+    m_stalls = 0;
+    m_stallRun = 0;
+    m_longestRun = 0;
+    m_seriesCount = 0;
+    m_seriesSpan = 1;
+    m_pendingBytes = 0;
+    m_pendingIntervals = 0;
+    m_finished = false;
+}
+
+void ThroughputRecorder::record(double seconds, fsize_t totalBytes) {
+    // A chunk that blocked for several intervals leaves them all empty
+    while (seconds >= m_intervalStart + m_interval) {
+        closeInterval();
+        m_intervalStart += m_interval;
+    }
+    m_intervalBytes += totalBytes - m_lastTotal;
+    m_lastTotal = totalBytes;
+}
+
+void ThroughputRecorder::closeInterval() {
+    m_rates.record((unsigned long)((double)m_intervalBytes / m_interval));
+
+    if (m_intervalBytes == 0) {
+        if (m_stallRun == 0) {
+            m_stalls++;
+        }
+        m_stallRun++;
+        if (m_stallRun > m_longestRun) {
+            m_longestRun = m_stallRun;
+        }
+    } else {
+        m_stallRun = 0;
+    }
+
+    m_pendingBytes += m_intervalBytes;
+    m_pendingIntervals++;
+    if (m_pendingIntervals == m_seriesSpan) {
+        addPoint((long)((double)m_pendingBytes / (m_interval * m_seriesSpan)));
+        m_pendingBytes = 0;
+        m_pendingIntervals = 0;
+    }
+    m_intervalBytes = 0;
+}
+
+void ThroughputRecorder::addPoint(long rate) {
+    m_series[m_seriesCount++] = rate;
+
+    // Full - merge neighbouring points so the series still spans the
+    // whole transfer
+    if (m_seriesCount == MAX_SERIES_POINTS) {
+        for (int i = 0; i < MAX_SERIES_POINTS / 2; i++) {
+            m_series[i] = m_series[2 * i] / 2 + m_series[2 * i + 1] / 2;
+        }
+        m_seriesCount = MAX_SERIES_POINTS / 2;
+        m_seriesSpan *= 2;
+    }
+}
+
+void ThroughputRecorder::finish(double seconds, fsize_t totalBytes) {
+    if (m_finished) {
+        return;
+    }
+    record(seconds, totalBytes);
+    m_finished = true;
+
+    // The tail is too short for the histogram but belongs in the series
+    double tailSeconds = m_pendingIntervals * m_interval + (seconds - m_intervalStart);
+    fsize_t tailBytes = m_pendingBytes + m_intervalBytes;
+    if (tailSeconds > 0.0 && (tailBytes > 0 || m_pendingIntervals > 0)) {
+        addPoint((long)((double)tailBytes / tailSeconds));
+    }
+}
+
+void ThroughputRecorder::getInfo(ThroughputInfo& info) const {
+    info.intervals = m_rates.getCount();
+    info.p5 = (long)m_rates.percentile(5.0);
+    info.p50 = (long)m_rates.percentile(50.0);
+    info.p95 = (long)m_rates.percentile(95.0);
+    info.stalls = m_stalls;
+    info.longestStall = (long)(m_longestRun * m_interval * 1000.0);
+    info.seriesStep = (long)(m_seriesSpan * m_interval * 1000.0);
+    info.seriesCount = m_seriesCount;
+    for (int i = 0; i < m_seriesCount; i++) {
+        info.series[i] = m_series[i];
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef THRUPUT_H
+#define THRUPUT_H
+
+#include "histo.h"
+#include "logger.h"
+
+// Per-interval throughput of one transfer. The copy loop reports its
+// running byte count after every chunk; time is cut into fixed
+// intervals and each chunk's bytes count towards the interval in which
+// it completed. An interval with no completed chunk is a stall, which
+// is how a device that keeps going away shows up even when its average
+// looks healthy.
+//
+// Complete intervals go into a histogram for percentiles, and every
+// interval into a time series of at most MAX_SERIES_POINTS points that
+// halves its resolution whenever it fills up.
+class ThroughputRecorder {
+private:
+    double m_interval;          // Seconds per interval
+    double m_intervalStart;
+    fsize_t m_intervalBytes;
+    fsize_t m_lastTotal;
+
+    LogHistogram m_rates;
+    int m_stalls;
+    int m_stallRun;             // Intervals in the current stall
+    int m_longestRun;
+
+    long m_series[MAX_SERIES_POINTS];
+    int m_seriesCount;
+    int m_seriesSpan;           // Intervals folded into each point
+    fsize_t m_pendingBytes;     // Bytes of the point being built
+    int m_pendingIntervals;
+    bool m_finished;
+
+    void closeInterval();
+    void addPoint(long rate);
+
+public:
+    ThroughputRecorder(double intervalSeconds);
+
+    // Start at the given clock reading and byte count (non-zero when resuming)
+    void start(double seconds, fsize_t totalBytes);
+
+    // Called after each chunk with the clock and the running byte count
+    void record(double seconds, fsize_t totalBytes);
+
+    // Account for the partial interval at the end of the transfer
+    void finish(double seconds, fsize_t totalBytes);
+
+    void getInfo(ThroughputInfo& info) const;
+};
+
+#endif // THRUPUT_H
@@ -0,0 +1,142 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "trace.h"
+
+#ifdef FC_TRACE
+
+#include "fcthread.h"
+#include <stdlib.h>
+
+// Events kept - a power of two
+#ifdef FC_DOS
+const unsigned long TRACE_RING_SIZE = 512UL;
+#else
+const unsigned long TRACE_RING_SIZE = 65536UL;
+#endif
+
+struct TraceEvent {
+    unsigned long start;
+    unsigned long duration;
+    long value;
+    unsigned char kind;
+    unsigned char thread;
+};
+
+static const char* const TRACE_NAMES[TRACE_KIND_COUNT] = {
+    "open", "close", "read", "write", "chunk", "sync", "progress", "log"
+};
+
+bool gTraceOn = false;
+
+static TraceEvent* gRing = NULL;
+static unsigned long gOrigin = 0;
+static char gTracePath[MAXPATH];
+
+#ifdef FC_THREADS
+// Slots are claimed with an atomic increment, so threads never wait on
+// each other to record
+static volatile unsigned long gNext = 0;
+static volatile unsigned long gThreadCount = 0;
+static __thread int tThread = -1;
+
+static unsigned long claimSlot() {
+    return __sync_fetch_and_add(&gNext, 1UL);
+}
+
+static unsigned char currentThread() {
+    if (tThread < 0) {
+        tThread = (int)__sync_fetch_and_add(&gThreadCount, 1UL);
+    }
+    return (unsigned char)tThread;
+}
+#else
+static unsigned long gNext = 0;
+
+static unsigned long claimSlot() {
+    return gNext++;
+}
+
+static unsigned char currentThread() {
+    return 0;
+}
+#endif
+
+void traceRecord(TraceKind kind, unsigned long start, long value) {
+    unsigned long end = hrNowMicros();
+    TraceEvent& event = gRing[claimSlot() & (TRACE_RING_SIZE - 1)];
+    event.start = start;
+    event.duration = hrElapsedMicros(start, end);
+    event.value = value;
+    event.kind = (unsigned char)kind;
+    event.thread = currentThread();
+}
+
+// Write the ring as Chrome trace JSON, oldest event first
+static void traceDump() {
+    if (!gTraceOn) {
+        return;
+    }
+    gTraceOn = false;
+
+    FILE* file = fopen(gTracePath, "w");
+    if (file == NULL) {
+        cerr << "Error writing trace file: " << gTracePath << endl;
+        return;
+    }
+
+    unsigned long count = gNext;
+    unsigned long first = 0;
+    if (count > TRACE_RING_SIZE) {
+        first = count - TRACE_RING_SIZE;
+    }
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (unsigned long i = first; i < count; i++) {
+        const TraceEvent& event = gRing[i & (TRACE_RING_SIZE - 1)];
+        fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%lu,\"dur\":%lu,\"args\":{\"value\":%ld}}\n",
+                (i == first) ? "" : ",", TRACE_NAMES[event.kind], (unsigned)event.thread,
+                hrElapsedMicros(gOrigin, event.start), event.duration, event.value);
+    }
+    fprintf(file, "],\"otherData\":{\"events\":%lu,\"dropped\":%lu}}\n",
+            count - first, first);
+    fclose(file);
+
+    delete[] gRing;
+    gRing = NULL;
+}
+
+bool traceStart(const char* path) {
+    if (gRing == NULL) {
+        gRing = new TraceEvent[TRACE_RING_SIZE];
+        if (gRing == NULL) {
+            return false;
+        }
+        memset(gRing, 0, sizeof(TraceEvent) * TRACE_RING_SIZE);
+        atexit(traceDump);
+    }
+    strcpy(gTracePath, path);
+    gOrigin = hrNowMicros();
+    gTraceOn = true;
+    return true;
+}
+
+#endif // FC_TRACE
@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "platform.h"
+
+// Hot-path tracing. Built only with FC_TRACE defined (make -f makefile.lnx
+// TRACE=1, or -DFC_TRACE in CFLAGS on DOS); otherwise the macros below
+// expand to nothing and cost nothing.
+//
+// /trace:<file> turns recording on. Each event is a timestamp, a
+// duration and a value (usually bytes) stored in a ring allocated up
+// front, so recording never allocates, locks or prints. When the ring
+// is full the oldest events are overwritten. At exit the ring is written
+// as a Chrome trace (chrome://tracing, Perfetto):
+//
+//   TRACE_START(t);
+//   long n = read(handle, buffer, size);
+//   TRACE_END(TRACE_READ, t, n);
+
+enum TraceKind {
+    TRACE_OPEN,
+    TRACE_CLOSE,
+    TRACE_READ,
+    TRACE_WRITE,
+    TRACE_CHUNK,        // One engine copyChunk() call
+    TRACE_SYNC,         // Journal checkpoint
+    TRACE_PROGRESS,     // Drawing the progress line
+    TRACE_LOG,          // Writing a log record
+    TRACE_KIND_COUNT
+};
+
+#ifdef FC_TRACE
+
+#include "hrtimer.h"
+
+// True between traceStart() and the dump at exit
+extern bool gTraceOn;
+
+// Allocate the ring and write it to path when the program exits
+bool traceStart(const char* path);
+
+// Store one event that began at start (a hrNowMicros() reading)
+void traceRecord(TraceKind kind, unsigned long start, long value);
+
+inline unsigned long traceClock() {
+    return gTraceOn ? hrNowMicros() : 0;
+}
+
+inline void traceEnd(TraceKind kind, unsigned long start, long value) {
+    if (gTraceOn) {
+        traceRecord(kind, start, value);
+    }
+}
+
+#define TRACE_START(var) unsigned long var = traceClock()
+#define TRACE_END(kind, var, value) traceEnd(kind, var, (long)(value))
+
+#else
+
+#define TRACE_START(var)
+#define TRACE_END(kind, var, value)
+
+#endif // FC_TRACE
+
+#endif // TRACE_H
@@ -0,0 +1,254 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "treecopy.h"
+#include "filecopy.h"
+#include "workpool.h"
+#include "dirscan.h"
+#include "progress.h"
+#include "hrtimer.h"
+#include "rate.h"
+#include "dedup.h"
+#include "journal.h"
+
+// Default: files of 64 MB and up get their own workers
+const long DEFAULT_LARGE_FILE_THRESHOLD = 64L * 1024L * 1024L;
+
+// How often the main thread redraws the progress line while workers run
+const unsigned STATUS_INTERVAL_MS = 200;
+
+TreeCopy::TreeCopy()
+    : m_workers(4), m_largeThreshold(DEFAULT_LARGE_FILE_THRESHOLD),
+      m_overwrite(false), m_debugMode(false), m_copiers(NULL), m_pool(NULL) {}
+
+TreeCopy::~TreeCopy() {
+#ifdef FC_THREADS
+    delete m_pool;
+#endif
+    delete[] m_copiers;
+}
+
+void TreeCopy::jobHandler(CopyJob* job, int worker, void* context) {
+    ((TreeCopy*)context)->runJob(job, worker);
+}
+
+void TreeCopy::runJob(CopyJob* job, int worker) {
+    if (m_debugMode) {
+        cout << "[DEBUG] Worker " << worker << ": " << job->sourcePath << endl;
+    }
+
+    // The scan already knows the size - no need to ask again
+    FileInfo info;
+    info.kind = KIND_FILE;
+    info.size = job->size;
+    bool ok = m_copiers[worker].copyFile(job->sourcePath, job->destPath, &info);
+
+#ifdef FC_THREADS
+    ScopedLock lock(m_statsLock);
+#endif
+    if (ok && m_copiers[worker].wasDuplicate()) {
+        // No data moved, so it stays out of the byte count and the speed
+        m_stats.filesDuplicate++;
+        m_stats.bytesDuplicate += job->size;
+    } else if (ok) {
+        m_stats.filesCopied++;
+        m_stats.bytesCopied += job->size;
+    } else {
+        m_stats.filesFailed++;
+    }
+}
+
+void TreeCopy::submit(const char* sourcePath, const char* destPath, fsize_t size) {
+    m_stats.filesFound++;
+    m_stats.bytesFound += size;
+
+#ifdef FC_THREADS
+    m_pool->submit(new CopyJob(sourcePath, destPath, size));
+#else
+    // No threads on DOS - copy it right away
+    cout << sourcePath << endl;
+    CopyJob job(sourcePath, destPath, size);
+    runJob(&job, 0);
+#endif
+}
+
+// Depth first, so each destination directory exists before any of its
+// files is queued
+bool TreeCopy::scanDirectory(const char* sourceDir, const char* destDir) {
+    FileInfo dirInfo;
+    bool existed = m_destInfo.lookup(destDir, dirInfo);
+    if (!makeDirectory(destDir)) {
+        cerr << "Error creating directory: " << destDir << endl;
+        return false;
+    }
+    m_stats.dirsCreated++;
+
+    // Nothing in a directory we've just made can be in the way, so a
+    // copy into a new tree checks no destinations at all
+    if (!existed) {
+        m_destInfo.storeEmptyDirectory(destDir);
+    }
+
+    DirScanner scanner;
+    if (!scanner.open(sourceDir)) {
+        cerr << "Error reading directory: " << sourceDir << endl;
+        return false;
+    }
+
+    bool ok = true;
+    DirEntry entry;
+    while (scanner.next(entry)) {
+        char sourcePath[MAXPATH];
+        char destPath[MAXPATH];
+        if (!joinPath(sourceDir, entry.name, sourcePath) ||
+            !joinPath(destDir, entry.name, destPath)) {
+            cerr << "Error: Path too long: " << entry.name << " in " << sourceDir << endl;
+            ok = false;
+            continue;
+        }
+
+        if (entry.isDirectory) {
+            if (!scanDirectory(sourcePath, destPath)) {
+                ok = false;
+            }
+            continue;
+        }
+
+        // Never prompt from a tree copy - existing files need /y, unless
+        // they are partial copies with a journal to continue from
+        FileInfo destInfo;
+        if (!m_overwrite && m_destInfo.lookup(destPath, destInfo) &&
+            !(m_copier.getResume() && CopyJournal::exists(destPath))) {
+            m_stats.filesSkipped++;
+            continue;
+        }
+
+        submit(sourcePath, destPath, entry.size);
+    }
+    return ok;
+}
+
+void TreeCopy::showStatus(long bytesPerSec) {
+    fsize_t bytesDone;
+    {
+#ifdef FC_THREADS
+        ScopedLock lock(m_statsLock);
+#endif
+        // Duplicates are done too, they just took no copying
+        bytesDone = m_stats.bytesCopied + m_stats.bytesDuplicate;
+    }
+    m_progress.showProgressBar(bytesDone, m_stats.bytesFound, bytesPerSec);
+}
+
+bool TreeCopy::copyTree(const char* sourceDir, const char* destDir) {
+    m_stats = TreeStats();
+
+    // The scan would find the new copy and copy it again, forever
+    if (isWithin(destDir, sourceDir)) {
+        cerr << "Error: Cannot copy a directory into itself: " << destDir << endl;
+        return false;
+    }
+
+#ifdef FC_THREADS
+    // Dedicated large-file workers take a quarter of the threads
+    int largeWorkers = (m_workers >= 2) ? m_workers / 4 : 0;
+    if (m_workers >= 2 && largeWorkers == 0) {
+        largeWorkers = 1;
+    }
+    int smallWorkers = m_workers - largeWorkers;
+#else
+    int largeWorkers = 0;
+    int smallWorkers = 1;
+#endif
+
+    int copierCount = smallWorkers + largeWorkers;
+    m_copiers = new FileCopy[copierCount];
+    for (int i = 0; i < copierCount; i++) {
+        m_copiers[i] = m_copier;
+        m_copiers[i].setQuiet(true);
+    }
+
+    Stopwatch clock;
+
+#ifdef FC_THREADS
+    m_pool = new WorkPool(smallWorkers, largeWorkers, m_largeThreshold, jobHandler, this);
+    if (!m_pool->start()) {
+        cerr << "Error starting worker threads" << endl;
+        m_pool->close();
+        return false;
+    }
+
+    if (m_debugMode) {
+        cout << "[DEBUG] Workers: " << smallWorkers << " small, "
+             << largeWorkers << " large" << endl;
+    }
+#endif
+
+    bool scanOk = scanDirectory(sourceDir, destDir);
+
+#ifdef FC_THREADS
+    m_pool->close();
+
+    // Workers are busy - keep the progress line moving until they finish
+    RateEstimator rateEstimator(2.0);
+    while (!m_pool->isFinished()) {
+        double seconds = clock.lap();
+        fsize_t bytesCopied;
+        {
+            ScopedLock lock(m_statsLock);
+            bytesCopied = m_stats.bytesCopied;
+        }
+        rateEstimator.addSample(seconds, bytesCopied);
+        showStatus(rateEstimator.getRate());
+        delay(STATUS_INTERVAL_MS);
+    }
+    m_pool->join();
+#endif
+
+    double totalSeconds = clock.lap();
+    long totalDuration = clock.getMillis();
+    long avgBytesPerSec = 0;
+    if (totalSeconds > 0.0) {
+        avgBytesPerSec = (long)((double)m_stats.bytesCopied / totalSeconds);
+    }
+
+    char durationStr[32];
+    formatDuration(totalDuration, durationStr);
+    char speedStr[20];
+    formatSpeed(avgBytesPerSec, speedStr);
+
+    cout << "\nTree copy complete: " << m_stats.filesCopied << " files, "
+         << m_stats.bytesCopied << " bytes in " << durationStr << " seconds" << endl;
+    cout << "Directories: " << m_stats.dirsCreated
+         << "  Skipped: " << m_stats.filesSkipped
+         << "  Failed: " << m_stats.filesFailed << endl;
+    cout << "Average speed: " << speedStr << endl;
+    DedupIndex* dedup = m_copier.getDedup();
+    if (dedup != NULL) {
+        cout << "Duplicates: " << dedup->getDuplicates() << " (" << dedup->getLinked()
+             << " hardlinked), " << dedup->getBytesSaved() << " bytes saved" << endl;
+    }
+    if (m_debugMode) {
+        cout << "[DEBUG] Destination lookups: " << m_destInfo.getLookups()
+             << ", " << m_destInfo.getCalls() << " reached the disk" << endl;
+    }
+
+    return scanOk && m_stats.filesFailed == 0;
+}
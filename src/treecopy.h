@@ -0,0 +1,85 @@
+#ifndef TREECOPY_H
+#define TREECOPY_H
+
+#include "filecopy.h"
+#include "fcthread.h"
+#include "progress.h"
+#include "fileinfo.h"
+
+class WorkPool;
+struct CopyJob;
+
+// Totals for a tree copy
+struct TreeStats {
+    long filesFound;
+    long filesCopied;
+    long filesSkipped;   // Destination existed and overwrite was off
+    long filesFailed;
+    long filesDuplicate; // Linked or listed by /dedup, not written
+    long dirsCreated;
+    fsize_t bytesFound;
+    fsize_t bytesCopied;
+    fsize_t bytesDuplicate;
+
+    TreeStats()
+        : filesFound(0), filesCopied(0), filesSkipped(0), filesFailed(0),
+          filesDuplicate(0), dirsCreated(0), bytesFound(0), bytesCopied(0),
+          bytesDuplicate(0) {}
+};
+
+// Recursive directory copy. The main thread walks the source tree and
+// creates the destination directories; files are handed to a WorkPool
+// (POSIX build) or copied one after another as they are found (DOS).
+class TreeCopy {
+private:
+    int m_workers;
+    fsize_t m_largeThreshold;
+    bool m_overwrite;
+    bool m_debugMode;
+    FileCopy m_copier;      // Settings every worker copier starts from
+
+    TreeStats m_stats;
+    FileCopy* m_copiers;    // One per worker
+    WorkPool* m_pool;
+    Progress m_progress;    // Status line while the workers run
+    FileInfoCache m_destInfo;   // Which destinations exist already
+#ifdef FC_THREADS
+    Mutex m_statsLock;
+#endif
+
+    bool scanDirectory(const char* sourceDir, const char* destDir);
+    void submit(const char* sourcePath, const char* destPath, fsize_t size);
+    void runJob(CopyJob* job, int worker);
+    void showStatus(long bytesPerSec);
+
+    static void jobHandler(CopyJob* job, int worker, void* context);
+
+    // Not copyable
+    TreeCopy(const TreeCopy&);
+    TreeCopy& operator=(const TreeCopy&);
+
+public:
+    TreeCopy();
+    ~TreeCopy();
+
+    // Total worker threads (ignored on DOS)
+    void setWorkers(int workers) { m_workers = workers; }
+
+    // Files at least this big go to the dedicated large-file workers
+    void setLargeFileThreshold(fsize_t bytes) { m_largeThreshold = bytes; }
+
+    void setOverwrite(bool overwrite) { m_overwrite = overwrite; }
+    void setDebugMode(bool mode) { m_debugMode = mode; }
+
+    // Settings every worker's copier starts from - set the engine, /v
+    // and so on here. Workers always copy quietly.
+    FileCopy& getCopier() { return m_copier; }
+
+    // Copy everything under sourceDir into destDir. Returns true if no
+    // file failed.
+    bool copyTree(const char* sourceDir, const char* destDir);
+
+    const TreeStats& getStats() const { return m_stats; }
+};
+
+#endif // TREECOPY_H
@@ -0,0 +1,98 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "tuner.h"
+#include "hrtimer.h"
+
+// Each size is timed for at least this long and this many chunks.
+// The BIOS clock ticks every 55 ms, so the window must span several ticks.
+const unsigned long WINDOW_MICROS = 250000UL;
+const int WINDOW_CHUNKS = 4;
+
+// A bigger or smaller chunk has to beat the best by 5% to be worth it
+const int IMPROVEMENT_PERCENT = 105;
+
+ChunkTuner::ChunkTuner(long minChunk, long maxChunk, long startChunk)
+    : m_minChunk(minChunk), m_maxChunk(maxChunk), m_start(startChunk), m_current(startChunk),
+      m_best(startChunk), m_bestRate(0), m_direction(1),
+      m_triedShrink(false), m_settled(false),
+      m_windowStart(0), m_windowBytes(0), m_windowChunks(0) {
+    if (m_current < m_minChunk) m_current = m_minChunk;
+    if (m_current > m_maxChunk) m_current = m_maxChunk;
+    m_start = m_best = m_current;
+    m_settled = (m_minChunk >= m_maxChunk);
+    startWindow();
+}
+
+void ChunkTuner::startWindow() {
+    m_windowStart = hrNowMicros();
+    m_windowBytes = 0;
+    m_windowChunks = 0;
+}
+
+void ChunkTuner::record(long bytes) {
+    if (m_settled) {
+        return;
+    }
+
+    m_windowBytes += bytes;
+    m_windowChunks++;
+
+    unsigned long elapsed = hrElapsedMicros(m_windowStart, hrNowMicros());
+    if (elapsed < WINDOW_MICROS || m_windowChunks < WINDOW_CHUNKS) {
+        return;
+    }
+
+    // Double math - bytes * 1000000 overflows a 32-bit long
+    long rate = (long)((double)m_windowBytes * 1000000.0 / (double)elapsed);
+    finishWindow(rate);
+    startWindow();
+}
+
+// Decide where to go next after measuring m_current
+void ChunkTuner::finishWindow(long rate) {
+    bool improved = (m_bestRate == 0) ||
+                    ((double)rate * 100.0 > (double)m_bestRate * IMPROVEMENT_PERCENT);
+
+    if (improved) {
+        m_best = m_current;
+        m_bestRate = rate;
+
+        // Keep going the same way while it pays off
+        long next = (m_direction > 0) ? m_current * 2 : m_current / 2;
+        if (next >= m_minChunk && next <= m_maxChunk) {
+            m_current = next;
+            return;
+        }
+    }
+
+    // Growing never beat the starting size - try smaller chunks once
+    if (m_direction > 0 && !m_triedShrink) {
+        m_triedShrink = true;
+        m_direction = -1;
+        if (m_best == m_start && m_best / 2 >= m_minChunk) {
+            m_current = m_best / 2;
+            return;
+        }
+    }
+
+    m_current = m_best;
+    m_settled = true;
+}
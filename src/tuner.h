@@ -0,0 +1,44 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+// Adaptive chunk sizing. The copy loop asks for the chunk size before each
+// call into the engine and reports the bytes moved afterwards. The tuner
+// times each size over a short window, hill-climbs by doubling or halving
+// between minChunk and maxChunk, and settles on the fastest size.
+class ChunkTuner {
+private:
+    long m_minChunk;
+    long m_maxChunk;
+    long m_start;          // First size measured
+    long m_current;        // Size being measured
+    long m_best;           // Fastest size so far
+    long m_bestRate;       // Its throughput in bytes per second
+    int m_direction;       // +1 while growing, -1 while shrinking
+    bool m_triedShrink;
+    bool m_settled;
+
+    // Current measurement window
+    unsigned long m_windowStart;
+    long m_windowBytes;
+    int m_windowChunks;
+
+    void startWindow();
+    void finishWindow(long rate);
+
+public:
+    ChunkTuner(long minChunk, long maxChunk, long startChunk);
+
+    // Size to request for the next chunk
+    long getChunkSize() const { return m_current; }
+
+    // Report a completed chunk
+    void record(long bytes);
+
+    bool isSettled() const { return m_settled; }
+
+    // Best size found (the current size if nothing has been measured yet)
+    long getBestChunkSize() const { return m_bestRate > 0 ? m_best : m_current; }
+    long getBestRate() const { return m_bestRate; }
+};
+
+#endif // TUNER_H
@@ -0,0 +1,173 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "verify.h"
+#include "hrtimer.h"
+
+#ifdef FC_POSIX
+#include <fcntl.h>
+#endif
+
+// Read buffer for digestFile() and digestPrefix()
+#ifdef FC_DOS
+const long VERIFY_BUFFER_SIZE = 8192L;
+#else
+const long VERIFY_BUFFER_SIZE = 1024L * 1024L;
+#endif
+
+static const char* const digestNames[DIGEST_COUNT] = {
+    "crc32",
+    "crc32c",
+#ifdef FC_POSIX
+    "xxh64",
+#endif
+};
+
+bool digestFromName(const char* name, DigestType& type) {
+    for (int i = 0; i < DIGEST_COUNT; i++) {
+        if (stricmp(name, digestNames[i]) == 0) {
+            type = (DigestType)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* digestName(DigestType type) {
+    return digestNames[type];
+}
+
+Digest::Digest(DigestType type) : m_type(type) {
+    reset();
+}
+
+void Digest::reset() {
+    m_crc = CRC32_INIT;
+#ifdef FC_POSIX
+    xxh64Reset(m_xxh);
+#endif
+    m_bytes = 0;
+    m_seconds = 0.0;
+}
+
+void Digest::update(const void* data, long length) {
+    unsigned long start = hrNowMicros();
+    switch (m_type) {
+    case DIGEST_CRC32:
+        m_crc = crc32Update(m_crc, data, length);
+        break;
+    case DIGEST_CRC32C:
+        m_crc = crc32cUpdate(m_crc, data, length);
+        break;
+#ifdef FC_POSIX
+    case DIGEST_XXH64:
+        xxh64Update(m_xxh, data, length);
+        break;
+#endif
+    default:
+        break;
+    }
+    m_seconds += (double)hrElapsedMicros(start, hrNowMicros()) / 1000000.0;
+    m_bytes += length;
+}
+
+void Digest::format(char* result) const {
+#ifdef FC_POSIX
+    if (m_type == DIGEST_XXH64) {
+        sprintf(result, "%016llX", (unsigned long long)xxh64Final(m_xxh));
+        return;
+    }
+#endif
+    sprintf(result, "%08lX", crc32Final(m_crc));
+}
+
+bool Digest::matches(const Digest& other) const {
+    char mine[DIGEST_STRING_SIZE];
+    char theirs[DIGEST_STRING_SIZE];
+    format(mine);
+    other.format(theirs);
+    return m_type == other.m_type && strcmp(mine, theirs) == 0;
+}
+
+long Digest::getHashRate() const {
+    if (m_seconds <= 0.0) {
+        return 0;
+    }
+    return (long)((double)m_bytes / m_seconds);
+}
+
+// Feed up to length bytes (all of the file if length < 0) to the digest
+static bool digestHandle(int handle, fsize_t length, Digest& digest) {
+    char* buffer = new char[(unsigned)VERIFY_BUFFER_SIZE];
+    if (buffer == NULL) {
+        return false;
+    }
+
+    bool ok = true;
+    while (length != 0) {
+        long want = VERIFY_BUFFER_SIZE;
+        if (length > 0 && length < want) {
+            want = (long)length;
+        }
+        int got = read(handle, buffer, (unsigned)want);
+        if (got < 0) {
+            ok = false;
+            break;
+        }
+        if (got == 0) {
+            // Short file - only an error if a length was asked for
+            ok = (length < 0);
+            break;
+        }
+        digest.update(buffer, got);
+        if (length > 0) {
+            length -= got;
+        }
+    }
+
+    delete[] buffer;
+    return ok;
+}
+
+bool digestFile(const char* path, Digest& digest, bool dropCache) {
+    int handle = open(path, O_RDONLY | O_BINARY);
+    if (handle < 0) {
+        return false;
+    }
+#ifdef FC_POSIX
+    if (dropCache) {
+        posix_fadvise(handle, 0, 0, POSIX_FADV_DONTNEED);
+    }
+#else
+    (void)dropCache;
+#endif
+    bool ok = digestHandle(handle, -1L, digest);
+    close(handle);
+    return ok;
+}
+
+bool digestPrefix(int handle, fsize_t length, Digest& digest) {
+    fsize_t position = lseek(handle, 0L, SEEK_CUR);
+    if (position < 0 || lseek(handle, 0L, SEEK_SET) != 0) {
+        return false;
+    }
+    bool ok = (length == 0) || digestHandle(handle, length, digest);
+    return lseek(handle, position, SEEK_SET) == position && ok;
+}
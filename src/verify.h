@@ -0,0 +1,75 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include "platform.h"
+#include "engine.h"
+#include "checksum.h"
+
+// Checksum algorithms for /v
+enum DigestType {
+    DIGEST_CRC32,
+    DIGEST_CRC32C,
+#ifdef FC_POSIX
+    DIGEST_XXH64,
+#endif
+    DIGEST_COUNT
+};
+
+// Default for /v: CRC-32C runs in hardware on most x86-64 machines;
+// DOS sticks with plain CRC-32, the one PKZIP uses
+#ifdef FC_POSIX
+const DigestType DEFAULT_DIGEST = DIGEST_CRC32C;
+#else
+const DigestType DEFAULT_DIGEST = DIGEST_CRC32;
+#endif
+
+// Look up an algorithm by name ("crc32", "crc32c", "xxh64")
+bool digestFromName(const char* name, DigestType& type);
+const char* digestName(DigestType type);
+
+// Running checksum of a data stream. As a DataSink it hashes every block
+// an engine writes, while the block is still in the copy buffer, and
+// keeps track of the time spent hashing so its throughput can be logged.
+class Digest : public DataSink {
+private:
+    DigestType m_type;
+    unsigned long m_crc;
+#ifdef FC_POSIX
+    Xxh64State m_xxh;
+#endif
+    fsize_t m_bytes;
+    double m_seconds;   // Time spent inside update()
+
+public:
+    Digest(DigestType type);
+
+    void reset();
+    void update(const void* data, long length);
+    virtual void onData(const char* data, long length) { update(data, length); }
+
+    // Hex string of the result (8 or 16 digits plus terminator)
+    void format(char* result) const;
+    bool matches(const Digest& other) const;
+
+    DigestType getType() const { return m_type; }
+    const char* getName() const { return digestName(m_type); }
+    fsize_t getBytes() const { return m_bytes; }
+
+    // Hashing throughput in bytes per second, 0 if too fast to time
+    long getHashRate() const;
+};
+
+// Longest string Digest::format() produces
+const int DIGEST_STRING_SIZE = 17;
+
+// Checksum a whole file. With dropCache, flushed pages are evicted
+// first so the data really comes back from the device (Linux only -
+// DOS has no portable way to bypass a disk cache). Returns false on a
+// read error.
+bool digestFile(const char* path, Digest& digest, bool dropCache);
+
+// Checksum the first length bytes of an open file, then put the file
+// offset back where it was. Used to catch up when a copy resumes.
+bool digestPrefix(int handle, fsize_t length, Digest& digest);
+
+#endif // VERIFY_H
@@ -0,0 +1,241 @@
+/*
+ * FileCopy Utility
+ * Copyright (C) 2025 Dani Sarfati (danifunker)
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "platform.h"
+#include "workpool.h"
+
+// Copy a string onto the heap
+static char* copyString(const char* text) {
+    char* result = new char[strlen(text) + 1];
+    strcpy(result, text);
+    return result;
+}
+
+CopyJob::CopyJob(const char* source, const char* dest, fsize_t fileSize)
+    : sourcePath(copyString(source)), destPath(copyString(dest)), size(fileSize) {}
+
+CopyJob::~CopyJob() {
+    delete[] sourcePath;
+    delete[] destPath;
+}
+
+#ifdef FC_THREADS
+
+const long INITIAL_DEQUE_CAPACITY = 64L;
+
+WorkDeque::WorkDeque()
+    : m_items(new CopyJob*[INITIAL_DEQUE_CAPACITY]), m_capacity(INITIAL_DEQUE_CAPACITY),
+      m_top(0), m_bottom(0) {}
+
+WorkDeque::~WorkDeque() {
+    // Jobs nobody ran (only after an early exit)
+    while (m_top < m_bottom) {
+        delete m_items[m_top % m_capacity];
+        m_top++;
+    }
+    delete[] m_items;
+}
+
+// Double the ring - caller holds the lock
+void WorkDeque::grow() {
+    CopyJob** items = new CopyJob*[m_capacity * 2];
+    for (long i = m_top; i < m_bottom; i++) {
+        items[i % (m_capacity * 2)] = m_items[i % m_capacity];
+    }
+    delete[] m_items;
+    m_items = items;
+    m_capacity *= 2;
+}
+
+void WorkDeque::pushBottom(CopyJob* job) {
+    ScopedLock lock(m_lock);
+    if (m_bottom - m_top == m_capacity) {
+        grow();
+    }
+    m_items[m_bottom % m_capacity] = job;
+    m_bottom++;
+}
+
+CopyJob* WorkDeque::popBottom() {
+    ScopedLock lock(m_lock);
+    if (m_bottom == m_top) {
+        return NULL;
+    }
+    m_bottom--;
+    return m_items[m_bottom % m_capacity];
+}
+
+CopyJob* WorkDeque::stealTop() {
+    ScopedLock lock(m_lock);
+    if (m_bottom == m_top) {
+        return NULL;
+    }
+    CopyJob* job = m_items[m_top % m_capacity];
+    m_top++;
+    return job;
+}
+
+WorkPool::WorkPool(int smallWorkers, int largeWorkers, fsize_t largeThreshold,
+                   JobHandler handler, void* context)
+    : m_smallWorkers(smallWorkers), m_largeWorkers(largeWorkers),
+      m_largeThreshold(largeThreshold), m_handler(handler), m_context(context),
+      m_nextSmall(0), m_nextLarge(0),
+      m_queuedSmall(0), m_queuedLarge(0), m_running(0), m_closed(false) {
+    int total = m_smallWorkers + m_largeWorkers;
+    m_deques = new WorkDeque[total];
+    m_threads = new Thread[total];
+    m_args = new WorkerArg[total];
+}
+
+WorkPool::~WorkPool() {
+    close();
+    join();
+    delete[] m_threads;
+    delete[] m_deques;
+    delete[] m_args;
+}
+
+bool WorkPool::start() {
+    int total = m_smallWorkers + m_largeWorkers;
+    for (int i = 0; i < total; i++) {
+        m_args[i].pool = this;
+        m_args[i].index = i;
+        {
+            ScopedLock lock(m_idleLock);
+            m_running++;
+        }
+        if (!m_threads[i].start(workerEntry, &m_args[i])) {
+            ScopedLock lock(m_idleLock);
+            m_running--;
+            return false;
+        }
+    }
+    return true;
+}
+
+void WorkPool::submit(CopyJob* job) {
+    bool isLarge = (m_largeWorkers > 0 && job->size >= m_largeThreshold);
+
+    if (isLarge) {
+        m_deques[m_smallWorkers + m_nextLarge].pushBottom(job);
+        m_nextLarge = (m_nextLarge + 1) % m_largeWorkers;
+    } else {
+        m_deques[m_nextSmall].pushBottom(job);
+        m_nextSmall = (m_nextSmall + 1) % m_smallWorkers;
+    }
+
+    ScopedLock lock(m_idleLock);
+    if (isLarge) {
+        m_queuedLarge++;
+    } else {
+        m_queuedSmall++;
+    }
+    // Not every worker may take every job, so wake them all
+    m_workAvailable.broadcast();
+}
+
+void WorkPool::close() {
+    ScopedLock lock(m_idleLock);
+    m_closed = true;
+    m_workAvailable.broadcast();
+}
+
+bool WorkPool::isFinished() {
+    ScopedLock lock(m_idleLock);
+    return m_running == 0;
+}
+
+void WorkPool::join() {
+    int total = m_smallWorkers + m_largeWorkers;
+    for (int i = 0; i < total; i++) {
+        m_threads[i].join();
+    }
+}
+
+void* WorkPool::workerEntry(void* arg) {
+    WorkerArg* workerArg = (WorkerArg*)arg;
+    workerArg->pool->workerLoop(workerArg->index);
+    return NULL;
+}
+
+// Own deque first, then steal from the other workers of the same kind.
+// Large-file workers fall back to stealing small files.
+CopyJob* WorkPool::findJob(int index, bool& isLarge) {
+    CopyJob* job = m_deques[index].popBottom();
+    int i;
+
+    if (isLargeWorker(index)) {
+        isLarge = true;
+        for (i = 1; job == NULL && i < m_largeWorkers; i++) {
+            int victim = m_smallWorkers + (index - m_smallWorkers + i) % m_largeWorkers;
+            job = m_deques[victim].stealTop();
+        }
+        if (job != NULL) {
+            return job;
+        }
+        isLarge = false;
+        for (i = 0; job == NULL && i < m_smallWorkers; i++) {
+            job = m_deques[i].stealTop();
+        }
+        return job;
+    }
+
+    isLarge = false;
+    for (i = 1; job == NULL && i < m_smallWorkers; i++) {
+        job = m_deques[(index + i) % m_smallWorkers].stealTop();
+    }
+    return job;
+}
+
+void WorkPool::workerLoop(int index) {
+    for (;;) {
+        bool isLarge = false;
+        CopyJob* job = findJob(index, isLarge);
+
+        if (job != NULL) {
+            {
+                ScopedLock lock(m_idleLock);
+                if (isLarge) {
+                    m_queuedLarge--;
+                } else {
+                    m_queuedSmall--;
+                }
+            }
+            m_handler(job, index, m_context);
+            delete job;
+            continue;
+        }
+
+        // Nothing to do - sleep until a job this worker may take shows up
+        ScopedLock lock(m_idleLock);
+        for (;;) {
+            long eligible = m_queuedSmall + (isLargeWorker(index) ? m_queuedLarge : 0);
+            if (eligible > 0) {
+                break;
+            }
+            if (m_closed) {
+                m_running--;
+                return;
+            }
+            m_workAvailable.wait(m_idleLock);
+        }
+    }
+}
+
+#endif // FC_THREADS
@@ -0,0 +1,114 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include "fcthread.h"
+
+// One file to copy. Paths are heap copies owned by the job.
+struct CopyJob {
+    char* sourcePath;
+    char* destPath;
+    fsize_t size;
+
+    CopyJob(const char* source, const char* dest, fsize_t fileSize);
+    ~CopyJob();
+
+private:
+    // Not copyable
+    CopyJob(const CopyJob&);
+    CopyJob& operator=(const CopyJob&);
+};
+
+#ifdef FC_THREADS
+
+// Double-ended job queue. The owning worker pushes and pops at the
+// bottom (newest first); idle workers steal from the top (oldest first).
+class WorkDeque {
+private:
+    CopyJob** m_items;
+    long m_capacity;
+    long m_top;
+    long m_bottom;
+    Mutex m_lock;
+
+    void grow();
+
+    // Not copyable
+    WorkDeque(const WorkDeque&);
+    WorkDeque& operator=(const WorkDeque&);
+
+public:
+    WorkDeque();
+    ~WorkDeque();
+
+    void pushBottom(CopyJob* job);
+    CopyJob* popBottom();
+    CopyJob* stealTop();
+};
+
+// Pool of copy workers pulling from work-stealing deques. Files at or
+// above the large-file threshold go to dedicated workers so a multi-GB
+// image never holds up thousands of small files. Large-file workers help
+// with small files when they run out of their own work; small-file
+// workers never pick up large files.
+class WorkPool {
+public:
+    typedef void (*JobHandler)(CopyJob* job, int worker, void* context);
+
+private:
+    int m_smallWorkers;
+    int m_largeWorkers;
+    fsize_t m_largeThreshold;
+    JobHandler m_handler;
+    void* m_context;
+
+    WorkDeque* m_deques;      // One per worker
+    Thread* m_threads;
+    int m_nextSmall;          // Round-robin submission cursors
+    int m_nextLarge;
+
+    // Guarded by m_idleLock
+    Mutex m_idleLock;
+    Condition m_workAvailable;
+    long m_queuedSmall;
+    long m_queuedLarge;
+    int m_running;
+    bool m_closed;
+
+    struct WorkerArg {
+        WorkPool* pool;
+        int index;
+    };
+    WorkerArg* m_args;
+
+    static void* workerEntry(void* arg);
+    void workerLoop(int index);
+    CopyJob* findJob(int index, bool& isLarge);
+    bool isLargeWorker(int index) const { return index >= m_smallWorkers; }
+
+    // Not copyable
+    WorkPool(const WorkPool&);
+    WorkPool& operator=(const WorkPool&);
+
+public:
+    WorkPool(int smallWorkers, int largeWorkers, fsize_t largeThreshold,
+             JobHandler handler, void* context);
+    ~WorkPool();
+
+    bool start();
+
+    // Hand a job to the pool, which deletes it once handled
+    void submit(CopyJob* job);
+
+    // No more jobs will be submitted
+    void close();
+
+    // True once the pool is closed and every worker has run out of jobs
+    bool isFinished();
+
+    // Wait for all workers to exit
+    void join();
+};
+
+#endif // FC_THREADS
+
+#endif // WORKPOOL_H